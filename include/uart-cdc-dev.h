@@ -37,6 +37,8 @@
 
 #include "cmsis_device.h"
 #include "usbd_cdc_if.h"
+#include "uart-defs.h"
+#include "uart-ring.h"
 
 #if defined (__cplusplus)
 
@@ -84,6 +86,15 @@ namespace os
         int8_t
         cb_receive_event (uint8_t* pbuf, uint32_t* len);
 
+        ssize_t
+        peek (rx_span& first, rx_span& second);
+
+        int
+        consume (std::size_t nbyte);
+
+        static uart_cdc_dev*
+        find (USBD_HandleTypeDef* husbd);
+
 // --------------------------------------------------------------------
 
       protected:
@@ -140,8 +151,7 @@ namespace os
         uint8_t* rx_buff_;
         size_t tx_buff_size_;
         size_t rx_buff_size_;
-        size_t volatile rx_in_;
-        size_t volatile rx_out_;
+        spsc_ring<> rx_ring_;
         bool tx_buff_dyn_;
         bool rx_buff_dyn_;
 
@@ -153,6 +163,10 @@ namespace os
 
         bool volatile o_nonblock_ = false;
 
+        UART_STATS (uart_stats stats_ {});
+        UART_LATENCY (uart_latency latency_ {});
+        UART_LATENCY (latency_probe rx_probe_);
+
         uint8_t volatile cc_vmin_ = 1; // at least one character should be received
         uint8_t volatile cc_vtime_ = 0; // timeout indefinitely
         uint8_t volatile cc_vtime_milli_ = 0; // extension to VTIME: timeout in ms
@@ -162,8 +176,23 @@ namespace os
         os::rtos::semaphore_binary rx_sem_
           { "rx", 0 };
 
+        // the device of each USB peripheral (DEVICE_FS, DEVICE_HS), for the
+        // call-backs
+        static uart_cdc_dev* volatile ports_[2];
+
       };
 
+      /**
+       * @brief  Find the device the call-backs of a USB peripheral are meant
+       *    for, in constant time.
+       * @return  The device, or nullptr if none.
+       */
+      inline uart_cdc_dev*
+      uart_cdc_dev::find (USBD_HandleTypeDef* husbd)
+      {
+        return husbd->id < 2 ? ports_[husbd->id] : nullptr;
+      }
+
     } /* namespace stm32f7 */
   } /* namespace driver */
 } /* namespace os */
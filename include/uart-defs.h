@@ -0,0 +1,367 @@
+/*
+ * uart-defs.h
+ *
+ * Copyright (c) 2026 Lix N. Paulian (lix@paulian.net)
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom
+ * the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Created on: 16 Oct 2026 (LNP)
+ */
+
+#ifndef INCLUDE_UART_DEFS_H_
+#define INCLUDE_UART_DEFS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "cmsis_device.h"
+
+// Set this switch to false to compile out the per-port statistics counters
+// (the UART_IOCTL_xxx_STATS requests then fail with ENOTTY).
+#ifndef UART_USE_STATS
+#define UART_USE_STATS true
+#endif
+
+#if UART_USE_STATS == true
+#define UART_STATS(x) x
+#else
+#define UART_STATS(x)
+#endif
+
+// Set this switch to true to measure the receive and transmit latencies
+// (see UART_IOCTL_GET_LATENCY).
+#ifndef UART_USE_LATENCY
+#define UART_USE_LATENCY false
+#endif
+
+#if UART_USE_LATENCY == true
+#define UART_LATENCY(x) x
+#else
+#define UART_LATENCY(x)
+#endif
+
+// Set this switch to true to let the drivers define the HAL UART call-backs
+// (HAL_UART_TxCpltCallback() etc.) and the CDC interface call-backs
+// (cdc_init() etc.), which find the port in constant time (see
+// uart_impl::find() and uart_cdc_dev::find()); the application must not
+// define them then.
+#ifndef UART_USE_DISPATCH
+#define UART_USE_DISPATCH false
+#endif
+
+#if defined (__cplusplus)
+
+namespace os
+{
+  namespace driver
+  {
+    namespace stm32f7
+    {
+      // Definitions shared by the UART and CDC drivers.
+
+      /**
+       * @brief  A contiguous piece of a receive buffer, lent to the caller by
+       *    peek() until released by consume(). The data is left as received:
+       *    "mask" must be applied to each byte to strip a possible parity bit
+       *    (it is 0xFF if there is nothing to strip).
+       */
+      struct rx_span
+      {
+        const uint8_t* data;
+        size_t len;
+        uint8_t mask;
+      };
+
+      /**
+       * @brief  What ended a frame received in packet mode.
+       */
+      enum uart_frame_end : uint16_t
+      {
+        UART_FRAME_IDLE,        // the line went idle
+        UART_FRAME_GAP,         // the line was idle for the receiver timeout
+        UART_FRAME_FULL,        // the end of the receive buffer was reached
+        UART_FRAME_ERROR,       // a line error stopped the reception
+      };
+
+      /**
+       * @brief  What the UART driver does when the receive buffer is full
+       *    (see UART_IOCTL_SET_RX_OVERFLOW).
+       */
+      enum uart_rx_overflow : int
+      {
+        // the receiver goes on, overwriting the data not read yet; the
+        // reader then gets the newest data only
+        UART_RX_DROP_OLDEST,
+        // the receiver stops until the reader makes room, the USART drops
+        // what comes meanwhile (overrun)
+        UART_RX_DROP_NEWEST,
+        // the same, but the USART deasserts RTS to stop the sender, so
+        // nothing is lost (needs the RTS flow control)
+        UART_RX_STOP,
+      };
+
+      /**
+       * @brief  Descriptor of a frame received in packet mode (UART only);
+       *    the frame's data is contiguous in the receive buffer.
+       */
+      struct uart_frame
+      {
+        uint32_t offset;        // position in the receive buffer
+        uint32_t len;
+        uint32_t timestamp;     // cycle counter at the end of the frame
+        uint16_t errors;        // HAL_UART_ERROR_* seen during the frame
+        uint16_t end;           // uart_frame_end
+      };
+
+      /**
+       * @brief  Driver specific ioctl() requests.
+       */
+      enum uart_ioctl : int
+      {
+        // get a snapshot of the port's counters; arg: uart_stats*
+        UART_IOCTL_GET_STATS = 0x5501,
+        // reset the port's counters; no arg
+        UART_IOCTL_RESET_STATS = 0x5502,
+        // get a snapshot of the port's latency histograms; arg: uart_latency*
+        UART_IOCTL_GET_LATENCY = 0x5503,
+        // reset the port's latency histograms; no arg
+        UART_IOCTL_RESET_LATENCY = 0x5504,
+        // set the inter-character gap ending a read, in character times,
+        // instead of VTIME; 0 to return to VTIME; arg: int (UART only)
+        UART_IOCTL_SET_RX_GAP = 0x5505,
+        // read() returns one frame per call (see read_frame ()) if arg is
+        // not 0, or a byte stream if 0; arg: int (UART only)
+        UART_IOCTL_SET_PACKET_MODE = 0x5506,
+        // chain the transmit DMA transfers from the DMA interrupt, without
+        // waiting for the line to go idle, if arg is not 0; arg: int (UART
+        // only, DMA transmit)
+        UART_IOCTL_SET_TX_STREAMING = 0x5507,
+        // what to do when the receive buffer is full; arg: int
+        // (uart_rx_overflow) (UART only, not with a circular receive DMA but
+        // for UART_RX_DROP_OLDEST)
+        UART_IOCTL_SET_RX_OVERFLOW = 0x5508,
+        // get the number of receive buffer overflows that lost data since
+        // the previous request (0: nothing was lost); arg: uint32_t* (UART
+        // only)
+        UART_IOCTL_GET_RX_OVERFLOW = 0x5509,
+        // switch to line settings compiled beforehand (see
+        // uart_make_profile ()), between two characters; arg: const
+        // uart_profile* (UART only, not between 9 bit data and the rest)
+        UART_IOCTL_SET_PROFILE = 0x550A,
+      };
+
+      /**
+       * @brief  Per-port counters, updated by the drivers when UART_USE_STATS
+       *    is true. Some of them make no sense for a device (e.g. the CDC
+       *    has no line errors) and stay 0.
+       */
+      struct uart_stats
+      {
+        uint64_t rx_bytes;      // bytes received
+        uint64_t tx_bytes;      // bytes sent
+        uint32_t rx_events;     // receive call-backs, of which:
+        uint32_t rx_idle;       // - on line idle
+        uint32_t rx_half;       // - on half buffer
+        uint32_t rx_full;       // - on full buffer
+        uint32_t overrun_errors;
+        uint32_t framing_errors;
+        uint32_t parity_errors;
+        uint32_t noise_errors;
+        uint32_t rx_high_water; // maximum bytes held in the receive buffer
+        uint32_t rx_dropped;    // bytes lost because the buffer was full
+                                // (when the driver can count them)
+        uint32_t rx_overflows;  // times data was lost, the buffer was full
+        uint32_t rx_stalls;     // times the receiver stopped, the buffer full
+        uint32_t rx_wakeups;    // reader wake-ups by the receive call-back
+        uint32_t rx_frames;     // frames queued in packet mode
+        uint32_t rx_frames_dropped; // frames lost, the queue was full
+        uint64_t tx_block_cycles; // time write() spent blocked, in CPU cycles
+      };
+
+      /**
+       * @brief  Histogram of durations in CPU cycles, with log2 buckets:
+       *    bucket[i] counts the durations d with 2^i <= d < 2^(i+1) (a
+       *    duration of 0 is counted in bucket[0]).
+       */
+      struct uart_histogram
+      {
+        uint32_t count;
+        uint32_t max;
+        uint64_t sum;
+        uint32_t bucket[32];
+      };
+
+      /**
+       * @brief  Latency histograms of a port, updated by the drivers when
+       *    UART_USE_LATENCY is true.
+       */
+      struct uart_latency
+      {
+        // from the receive call-back posting the reader, to read() (or
+        // peek()) returning the data
+        uart_histogram rx_read;
+        // from the transmit complete call-back, to the start of the next
+        // transfer (not available on the CDC)
+        uart_histogram tx_restart;
+        // from the TC flag ending a transmission, to tcdrain() returning
+        // (not available on the CDC)
+        uart_histogram tx_drain;
+      };
+
+      inline void
+      histogram_record (uart_histogram& histogram, uint32_t cycles)
+      {
+        histogram.count++;
+        histogram.sum += cycles;
+        if (cycles > histogram.max)
+          {
+            histogram.max = cycles;
+          }
+        histogram.bucket[cycles ? 31 - __builtin_clz (cycles) : 0]++;
+      }
+
+      /**
+       * @brief  Start the DWT cycle counter, used to time the drivers.
+       */
+      inline void
+      cycle_counter_enable (void)
+      {
+        CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+        DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+      }
+
+      inline uint32_t
+      cycle_counter (void)
+      {
+        return DWT->CYCCNT;
+      }
+
+      /**
+       * @brief  Time stamp of an event, waiting for the matching end event:
+       *    start() keeps the first stamp until stop() records the elapsed
+       *    time, so a latency is measured from the oldest pending event.
+       */
+      class latency_probe
+      {
+      public:
+
+        void
+        start (void)
+        {
+          if (!armed_)
+            {
+              stamp_ = cycle_counter ();
+              armed_ = true;
+            }
+        }
+
+        void
+        stop (uart_histogram& histogram)
+        {
+          if (armed_)
+            {
+              histogram_record (histogram, cycle_counter () - stamp_);
+              armed_ = false;
+            }
+        }
+
+      private:
+
+        uint32_t volatile stamp_ = 0;
+        bool volatile armed_ = false;
+      };
+
+      /**
+       * @brief  Copy n bytes, clearing the bits not set in mask (e.g. to
+       *    strip the parity bit); a plain memcpy() if the mask is 0xFF.
+       *    The bytes are processed four at a time, as 32-bit words: the AND
+       *    doesn't carry between bytes, so no SIMD instructions are needed.
+       *    The word accesses are written as memcpy(), which the compiler
+       *    turns into single (unaligned) loads/stores on the Cortex-M7.
+       */
+      inline void
+      mask_copy (uint8_t* dst, const uint8_t* src, size_t n, uint8_t mask)
+      {
+        if (mask == 0xFF)
+          {
+            memcpy (dst, src, n);
+            return;
+          }
+
+        uint32_t mask32 = mask * 0x01010101U;
+        uint32_t w0, w1;
+
+        for (; n >= 8; n -= 8, src += 8, dst += 8)
+          {
+            memcpy (&w0, src, 4);
+            memcpy (&w1, src + 4, 4);
+            w0 &= mask32;
+            w1 &= mask32;
+            memcpy (dst, &w0, 4);
+            memcpy (dst + 4, &w1, 4);
+          }
+        if (n >= 4)
+          {
+            memcpy (&w0, src, 4);
+            w0 &= mask32;
+            memcpy (dst, &w0, 4);
+            n -= 4;
+            src += 4;
+            dst += 4;
+          }
+        while (n--)
+          {
+            *dst++ = *src++ & mask;
+          }
+      }
+
+      /**
+       * @brief  Find the first of n bytes equal to c once masked with mask;
+       *    a plain memchr() if the mask is 0xFF.
+       * @return  Pointer to the byte found, or nullptr.
+       */
+      inline const uint8_t*
+      mask_find (const uint8_t* src, size_t n, uint8_t c, uint8_t mask)
+      {
+        if (mask == 0xFF)
+          {
+            return (const uint8_t*) memchr (src, c, n);
+          }
+
+        for (const uint8_t* end = src + n; src < end; src++)
+          {
+            if ((*src & mask) == c)
+              {
+                return src;
+              }
+          }
+        return nullptr;
+      }
+
+    } /* namespace stm32f7 */
+  } /* namespace driver */
+} /* namespace os */
+
+#endif /* __cplusplus */
+
+#endif /* INCLUDE_UART_DEFS_H_ */
@@ -35,6 +35,36 @@
 #include <cmsis-plus/posix/termios.h>
 #include <fcntl.h>
 
+#include "uart-defs.h"
+#include "uart-ring.h"
+#include "uart-pool.h"
+
+// Number of frame descriptors queued by a port in packet mode.
+#ifndef UART_FRAME_QUEUE_SIZE
+#define UART_FRAME_QUEUE_SIZE 8
+#endif
+
+// Number of line errors a port queues, with their position, for read().
+#ifndef UART_RX_ERROR_QUEUE_SIZE
+#define UART_RX_ERROR_QUEUE_SIZE 8
+#endif
+
+// Slot of a USART in the table of ports (see uart_impl::find ()): on the
+// STM32F7, bits 10 to 14 of the base address tell the eight U(S)ARTs apart.
+#ifndef UART_DISPATCH_SLOT
+#define UART_DISPATCH_SLOT(instance) ((((uintptr_t) (instance)) >> 10) & 0x1F)
+#endif
+
+#ifndef UART_DISPATCH_SLOTS
+#define UART_DISPATCH_SLOTS 32
+#endif
+
+// Largest baud rate error accepted by tcsetattr() (see uart_make_profile ()),
+// in parts per thousand of the rate asked for.
+#ifndef UART_BAUD_TOLERANCE
+#define UART_BAUD_TOLERANCE 20
+#endif
+
 #if defined (__cplusplus)
 
 namespace os
@@ -46,6 +76,110 @@ namespace os
       class uart_impl;
       using uart = posix::tty_implementable<uart_impl>;
 
+      /**
+       * @brief  Line settings as the USART registers hold them, switched to
+       *    with a few register writes (see UART_IOCTL_SET_PROFILE). Made by
+       *    uart_make_profile(), at compile time if the kernel clock of the
+       *    USART is known then, or once at startup by
+       *    uart_impl::make_profile().
+       */
+      struct uart_profile
+      {
+        uint32_t cr1;           // M0, M1, PCE, PS, OVER8
+        uint32_t cr2;           // STOP
+        uint32_t cr3;           // RTSE, CTSE
+        uint32_t brr;           // 0 if the settings are not possible
+        uint32_t baud;          // the baud rate asked for
+      };
+
+      /**
+       * @brief  BRR of a baud rate, for the nearest divider: USARTDIV with
+       *    16 times oversampling; with 8 times, USARTDIV is twice the
+       *    divider and its three low bits are shifted right by one (its bit
+       *    0 is lost, so it is kept even).
+       * @return  The BRR value, or 0 if USARTDIV is not within 16 to 65535.
+       */
+      constexpr uint32_t
+      uart_brr (uint32_t clock, uint32_t baud, bool over8)
+      {
+        uint64_t div = baud == 0 ? 0 :
+            (over8 ? 2 : 1) * (((uint64_t) clock + baud / 2) / baud);
+
+        return (div < 16 || div > 0xFFFF) ? 0 :
+               over8 ? (uint32_t) ((div & 0xFFF0) | ((div & 0xF) >> 1)) :
+               (uint32_t) div;
+      }
+
+      /**
+       * @brief  Baud rate a BRR value gives, rounded to the nearest.
+       * @return  The baud rate, or 0 if BRR is not valid.
+       */
+      constexpr uint32_t
+      uart_baud (uint32_t clock, uint32_t brr, bool over8)
+      {
+        uint32_t div = over8 ? ((brr & 0xFFF0) | ((brr & 0x7) << 1)) : brr;
+
+        return div < 16 ? 0 :
+            (uint32_t) (((over8 ? 2ULL : 1ULL) * clock + div / 2) / div);
+      }
+
+      /**
+       * @brief  Error of the baud rate a BRR value gives, in parts per
+       *    million of the rate asked for.
+       * @return  The error, or 0xFFFFFFFF if BRR is 0 (not possible).
+       */
+      constexpr uint32_t
+      uart_baud_error (uint32_t clock, uint32_t baud, uint32_t brr, bool over8)
+      {
+        uint32_t actual = uart_baud (clock, brr, over8);
+
+        return brr == 0 ? 0xFFFFFFFF :
+            (uint32_t) ((actual > baud ? actual - baud : baud - actual)
+                * 1000000ULL / baud);
+      }
+
+      /**
+       * @brief  Compile the termios settings of a USART clocked at "clock"
+       *    into its register images: the baud rate and, from "cflag", the
+       *    character size, parity, stop bits and flow control, mapped like
+       *    tcsetattr() does. Sampling by 8 reaches the same rates as by
+       *    16, with dividers down to 8 instead of 16, but the receiver
+       *    tolerates less deviation (3.41% instead of 3.75%, RM0410): the
+       *    USART oversamples by 16, or by 8 only for the rates too high
+       *    for it.
+       * @return  The profile; its brr is 0 if the settings are not possible
+       *    or the baud rate error exceeds UART_BAUD_TOLERANCE.
+       */
+      constexpr uart_profile
+      uart_make_profile (uint32_t clock, uint32_t baud, tcflag_t cflag)
+      {
+        // ST UARTs: the parity is one of the data bits, CS7 and CS8 only
+        uint32_t parity =
+            (cflag & PARENB) ?
+                ((cflag & PARODD) ? UART_PARITY_ODD : UART_PARITY_EVEN) :
+                UART_PARITY_NONE;
+        uint32_t length =
+            parity == UART_PARITY_NONE ?
+                ((cflag & CSIZE) == CS8 ?
+                    UART_WORDLENGTH_8B : UART_WORDLENGTH_7B) :
+                ((cflag & CSIZE) == CS8 ?
+                    UART_WORDLENGTH_9B : UART_WORDLENGTH_8B);
+        bool over8 = uart_brr (clock, baud, false) == 0;
+        uint32_t brr = uart_brr (clock, baud, over8);
+
+        return
+          { length | parity | (over8 ? UART_OVERSAMPLING_8 : 0),
+              (cflag & CSTOPB) ? UART_STOPBITS_2 : UART_STOPBITS_1,
+              (cflag & CRTSCTS) == CRTSCTS ? UART_HWCONTROL_RTS_CTS :
+              (cflag & CRTSCTS) == CRTS_IFLOW ? UART_HWCONTROL_RTS :
+              (cflag & CRTSCTS) == CCTS_OFLOW ? UART_HWCONTROL_CTS :
+              UART_HWCONTROL_NONE,
+              ((cflag & CSIZE) < CS7
+                  || uart_baud_error (clock, baud, brr, over8)
+                      > UART_BAUD_TOLERANCE * 1000U) ? 0 : brr,
+              baud };
+      }
+
       class uart_impl : public posix::tty_impl
       {
       public:
@@ -76,6 +210,11 @@ namespace os
         static constexpr uint32_t RS485_DE_DEASSERT_TIME_MASK = (0x1F
             << RS485_DE_DEASSERT_TIME_POS);
 
+        // call-back invoked when the driver is done with a buffer passed to
+        // submit(), normally from an interrupt context
+        using tx_done_t = void (*) (const void* buf, std::size_t nbyte,
+                                    void* arg);
+
         uart_impl (UART_HandleTypeDef* huart, uint8_t* tx_buff,
                    uint8_t* rx_buff, size_t tx_buff_size, size_t rx_buff_size);
 
@@ -104,6 +243,25 @@ namespace os
         virtual void
         termination (bool new_state);
 
+        ssize_t
+        submit (const void* buf, std::size_t nbyte, tx_done_t cb, void* arg);
+
+        ssize_t
+        submit (const void* buf, std::size_t nbyte,
+                rtos::semaphore_binary& sem);
+
+        ssize_t
+        peek (rx_span& first, rx_span& second);
+
+        int
+        consume (std::size_t nbyte);
+
+        ssize_t
+        read_frame (void* buf, std::size_t nbyte, uart_frame* frame);
+
+        uart_profile
+        make_profile (uint32_t baud, tcflag_t cflag);
+
         void
         cb_tx_event (void);
 
@@ -113,6 +271,12 @@ namespace os
         void
         cb_rx_event_error (void);
 
+        void
+        irq_handler (void);
+
+        static uart_impl*
+        find (UART_HandleTypeDef* huart);
+
         // --------------------------------------------------------------------
 
       protected:
@@ -129,6 +293,10 @@ namespace os
         virtual void
         close_hook (void);
 
+        template<bool rx_dma, bool tx_dma>
+          void
+          irq_service (void);
+
         // --------------------------------------------------------------------
 
       private:
@@ -166,6 +334,9 @@ namespace os
         virtual int
         do_tcdrain (void) override;
 
+        void
+        set_rs485_de (bool state);
+
         void
         invalidate_dcache (uint8_t* ptr, size_t len);
 
@@ -175,6 +346,120 @@ namespace os
         size_t
         get_current_count (void);
 
+        template<bool rx_dma>
+          size_t
+          get_current_count (void);
+
+        ssize_t
+        queue_tx (const uint8_t* buf, std::size_t nbyte, bool block);
+
+        HAL_StatusTypeDef
+        start_tx (void);
+
+        template<bool tx_dma>
+          HAL_StatusTypeDef
+          start_tx (void);
+
+        HAL_StatusTypeDef
+        stream_tx (uint8_t* ptr, size_t len);
+
+        static void
+        dma_tx_cplt (DMA_HandleTypeDef* hdma);
+
+        size_t
+        rx_produce (bool half);
+
+        template<bool rx_dma>
+          size_t
+          rx_produce (bool half);
+
+        HAL_StatusTypeDef
+        start_rx (size_t from);
+
+        template<bool rx_dma>
+          HAL_StatusTypeDef
+          start_rx (size_t from);
+
+        template<bool tx_dma>
+          void
+          cb_tx_event (void);
+
+        template<bool rx_dma>
+          void
+          cb_rx_event (bool half);
+
+        HAL_StatusTypeDef
+        restart_rx (void);
+
+        void
+        rx_resume (void);
+
+        void
+        rx_resync (void);
+
+        void
+        set_rx_gap (void);
+
+        void
+        switch_config (const uart_profile& profile);
+
+        int
+        set_profile (const uart_profile* profile);
+
+        static bool
+        data_9b (const UART_InitTypeDef& init);
+
+        void
+        set_xfer_width (void);
+
+        static void
+        profile_init (const uart_profile& profile, UART_InitTypeDef& init);
+
+        uint32_t
+        kernel_clock (void);
+
+        void
+        set_canonical (void);
+
+        ssize_t
+        read_line (uint8_t* buf, std::size_t nbyte);
+
+        // a line error, at the character received with it or, for an
+        // overrun alone, before the first character received after it
+        struct rx_error
+        {
+          uint32_t offset;      // position in the receive buffer
+          uint32_t errors;      // HAL_UART_ERROR_*
+        };
+
+        ssize_t
+        rx_pop (uint8_t* buf, std::size_t nbyte, std::size_t len, bool report,
+                std::size_t& used);
+
+        size_t
+        rx_next_error (rx_error& error);
+
+        uint32_t
+        rx_drop_error (const rx_error& error);
+
+        size_t
+        rx_line_length (void);
+
+        bool
+        rx_frame_end (uint16_t end);
+
+        bool
+        is_zero_copy_capable (const void* buf, std::size_t nbyte);
+
+        static void
+        post_sem (const void* buf, std::size_t nbyte, void* arg);
+
+        void
+        attach (void);
+
+        void
+        detach (void);
+
         static constexpr uint8_t VERSION_MAJOR = 2;
         static constexpr uint8_t VERSION_MINOR = 2;
         static constexpr uint8_t VERSION_PATCH = 2;
@@ -184,34 +469,104 @@ namespace os
         uint8_t* rx_buff_;
         size_t tx_buff_size_;
         size_t rx_buff_size_;
-        size_t volatile tx_in_;
-        size_t volatile tx_out_;
-        size_t volatile rx_in_;
-        size_t volatile rx_out_;
-        bool tx_buff_dyn_;
-        bool rx_buff_dyn_;
+        spsc_ring<> tx_ring_;
+        spsc_ring<> rx_ring_;
+        size_t volatile tx_xfer_size_; // size of the segment being sent
+
+        // zero-copy buffer, queued after zc_ahead_ bytes of the FIFO
+        const uint8_t* volatile zc_buff_ = nullptr;
+        size_t zc_size_ = 0;
+        size_t zc_ahead_ = 0;
+        tx_done_t zc_cb_ = nullptr;
+        void* zc_arg_ = nullptr;
+        bool volatile zc_active_ = false;
+        bool volatile tx_streaming_ = false; // chain from the DMA interrupt
+        bool volatile tx_break_ = false; // a break is sent, hold the data
+        bool tx_buff_dyn_ = false;
+        bool rx_buff_dyn_ = false;
+        dma_pool* tx_pool_ = nullptr; // owners of the dynamic buffers
+        dma_pool* rx_pool_ = nullptr; // (nullptr: the heap)
+        bool tx_cached_; // buffers needing cache maintenance (not in DTCM,
+        bool rx_cached_; // nor in a non-cacheable pool)
+        bool rx_circular_ = false; // the receive DMA never stops
+        size_t rx_armed_end_ = 0; // where the current reception stops
+        // the HAL and the DMA move 16 bit words with 9 data bits and no
+        // parity: their counters are then in words, the buffers in bytes
+        uint8_t xfer_shift_ = 0; // log2 of the bytes per word
+
+        // receive buffer overflow (see UART_IOCTL_SET_RX_OVERFLOW)
+        int rx_overflow_ = UART_RX_DROP_OLDEST;
+        bool volatile rx_overrun_ = false; // the receiver passed the reader
+        bool volatile rx_paused_ = false; // not receiving, the buffer is full
+        uint32_t volatile rx_overflows_ = 0; // since UART_IOCTL_GET_RX_OVERFLOW
 
         rtos::clock_systick::duration_t rx_timeout_;
 
         bool volatile is_connected_ = false;
         bool volatile is_opened_ = false;
-        bool volatile is_error_ = false;
 
         bool volatile o_nonblock_ = false;
 
+        UART_STATS (uart_stats stats_ {});
+        UART_LATENCY (uart_latency latency_ {});
+        UART_LATENCY (latency_probe rx_probe_);
+        UART_LATENCY (latency_probe tx_probe_);
+        UART_LATENCY (latency_probe drain_probe_);
+
         uint8_t volatile cc_vmin_ = 1; // at least one character should be received
         uint8_t volatile cc_vtime_ = 0; // timeout indefinitely
         uint8_t volatile cc_vtime_milli_ = 0; // extension to VTIME: timeout in ms
 
+        // inter-character gap detected by the USART receiver timeout
+        uint32_t rx_gap_chars_ = 0; // gap in character times, 0: use VTIME
+        bool volatile rto_enabled_ = false;
+        bool volatile rx_gap_ = false; // the line is idle for the gap
+
+        // line errors, reported by read() at their position, as selected
+        // by IGNPAR, PARMRK and INPCK
+        tcflag_t iflag_ = INPCK;
+        size_t rx_ff_split_ = SIZE_MAX; // a \377 passed once, with PARMRK
+        spsc_ring<UART_RX_ERROR_QUEUE_SIZE * sizeof(rx_error) + 1> rx_errors_;
+
+        // canonical mode, lines ended by a character matched by the USART
+        bool volatile canonical_ = false;
+        uint8_t cc_veol_ = 0;   // VEOL, 0: lines end with '\n'
+        size_t rx_scanned_ = 0; // chars from the FIFO tail holding no EOL
+        bool rx_eol_late_ = false; // EOL matched, not moved by the DMA yet
+
+        // packet mode, frames delimited by the receive events
+        bool volatile packet_mode_ = false;
+        size_t frame_start_ = 0; // position of the current frame
+        size_t frame_len_ = 0;
+        uint16_t frame_errors_ = 0;
+        spsc_ring<UART_FRAME_QUEUE_SIZE * sizeof(uart_frame) + 1> frames_;
+
         rtos::semaphore_binary tx_sem_
           { "tx", 1 };
         rtos::semaphore_binary rx_sem_
           { "rx", 0 };
 
+        // tcdrain(), woken at the TC flag ending the transmission
+        rtos::semaphore_binary drain_sem_
+          { "drain", 0 };
+        bool volatile tx_draining_ = false;
+
+        // the port last opened on each USART, for the call-backs
+        static uart_impl* volatile ports_[UART_DISPATCH_SLOTS];
+
       protected:
 
         uint32_t rs485_params_;
 
+        // settings of a derived class knowing its port at compile time (see
+        // uart_static_impl): do_rs485_de() is not called if it does nothing,
+        // the buffers are not cache maintained if they are never cached, and
+        // open() fails if the handle has (1) or has not (0) DMA streams
+        // while the derived class expects the opposite (-1: don't care)
+        bool rs485_de_hook_ = true;
+        bool cache_maintenance_ = true;
+        int8_t dma_expected_ = -1;
+
       };
 
       /**
@@ -228,14 +583,97 @@ namespace os
         version_patch = VERSION_PATCH;
       }
 
+      /**
+       * @brief  Tell if the transfers move 16 bit words with the settings
+       *    given: 9 data bits, without parity.
+       */
+      inline bool
+      uart_impl::data_9b (const UART_InitTypeDef& init)
+      {
+        return init.WordLength == UART_WORDLENGTH_9B
+            && init.Parity == UART_PARITY_NONE;
+      }
+
+      /**
+       * @brief  Set the line settings of a HAL handle as in a profile.
+       */
+      inline void
+      uart_impl::profile_init (const uart_profile& profile,
+                               UART_InitTypeDef& init)
+      {
+        init.WordLength = profile.cr1 & USART_CR1_M;
+        init.Parity = profile.cr1 & (USART_CR1_PCE | USART_CR1_PS);
+        init.OverSampling = profile.cr1 & USART_CR1_OVER8;
+        init.StopBits = profile.cr2;
+        init.HwFlowCtl = profile.cr3;
+        init.BaudRate = profile.baud;
+      }
+
+      /**
+       * @brief  Queue a buffer for transmission, with completion notified by
+       *    posting a semaphore.
+       */
+      inline ssize_t
+      uart_impl::submit (const void* buf, std::size_t nbyte,
+                         rtos::semaphore_binary& sem)
+      {
+        return submit (buf, nbyte, post_sem, &sem);
+      }
+
+      inline void
+      uart_impl::post_sem (const void*, std::size_t, void* arg)
+      {
+        static_cast<rtos::semaphore_binary*> (arg)->post ();
+      }
+
+      /**
+       * @brief  Find the port the call-backs of a UART handle are meant for,
+       *    in constant time: the last one opened (or constructed, if the
+       *    handle was set up before) on the handle's USART.
+       * @return  The port, or nullptr if none.
+       */
+      inline uart_impl*
+      uart_impl::find (UART_HandleTypeDef* huart)
+      {
+        uart_impl* port = ports_[UART_DISPATCH_SLOT(huart->Instance)];
+
+        return port != nullptr && port->huart_ == huart ? port : nullptr;
+      }
+
+      inline void
+      uart_impl::attach (void)
+      {
+        ports_[UART_DISPATCH_SLOT(huart_->Instance)] = this;
+      }
+
+      inline void
+      uart_impl::detach (void)
+      {
+        if (ports_[UART_DISPATCH_SLOT(huart_->Instance)] == this)
+          {
+            ports_[UART_DISPATCH_SLOT(huart_->Instance)] = nullptr;
+          }
+      }
+
+      inline void
+      uart_impl::set_rs485_de (bool state)
+      {
+        if (rs485_de_hook_)
+          {
+            do_rs485_de (state);
+          }
+      }
+
       inline void
       uart_impl::invalidate_dcache (uint8_t* ptr, size_t len)
       {
         if (SCB->CCR & (uint32_t) SCB_CCR_DC_Msk)
           {
             // D-cache is enabled
-            uint32_t* aligned_buff = (uint32_t*) (((uint32_t) ptr) & 0xFFFFFFE0);
-            uint32_t aligned_count = (uint32_t) (len & 0xFFFFFFE0) + 32;
+            uint32_t* aligned_buff = (uint32_t*) (((uintptr_t) ptr)
+                & ~(uintptr_t) 0x1F);
+            uint32_t aligned_count = (uint32_t) ((((uintptr_t) ptr + len + 31)
+                & ~(uintptr_t) 0x1F) - (uintptr_t) aligned_buff);
             SCB_CleanInvalidateDCache_by_Addr (aligned_buff, aligned_count);
           }
       }
@@ -246,21 +684,237 @@ namespace os
         if (SCB->CCR & (uint32_t) SCB_CCR_DC_Msk)
           {
             // D-cache is enabled
-            uint32_t* aligned_buff = (uint32_t*) (((uint32_t) (ptr))
-                & 0xFFFFFFE0);
-            uint32_t aligned_count = (uint32_t) (len & 0xFFFFFFE0) + 32;
+            uint32_t* aligned_buff = (uint32_t*) (((uintptr_t) (ptr))
+                & ~(uintptr_t) 0x1F);
+            uint32_t aligned_count = (uint32_t) ((((uintptr_t) ptr + len + 31)
+                & ~(uintptr_t) 0x1F) - (uintptr_t) aligned_buff);
             SCB_CleanDCache_by_Addr (aligned_buff, aligned_count);
           }
       }
 
+      // The transfer mode is a template parameter of the functions run for
+      // each event (see irq_service ()); these ones find it in the handle.
+
       inline size_t
       uart_impl::get_current_count (void)
       {
         return
-            huart_->hdmarx == nullptr ?
-                huart_->RxXferCount : huart_->hdmarx->Instance->NDTR;
+            huart_->hdmarx != nullptr ?
+                get_current_count<true> () : get_current_count<false> ();
+      }
+
+      template<bool rx_dma>
+        inline size_t
+        uart_impl::get_current_count (void)
+        {
+          return rx_dma ? huart_->hdmarx->Instance->NDTR : huart_->RxXferCount;
+        }
+
+      inline HAL_StatusTypeDef
+      uart_impl::start_tx (void)
+      {
+        return
+            huart_->hdmatx != nullptr ? start_tx<true> () : start_tx<false> ();
+      }
+
+      inline size_t
+      uart_impl::rx_produce (bool half)
+      {
+        return
+            huart_->hdmarx != nullptr ?
+                rx_produce<true> (half) : rx_produce<false> (half);
+      }
+
+      inline HAL_StatusTypeDef
+      uart_impl::start_rx (size_t from)
+      {
+        return
+            huart_->hdmarx != nullptr ?
+                start_rx<true> (from) : start_rx<false> (from);
       }
 
+      inline void
+      uart_impl::cb_tx_event (void)
+      {
+        if (huart_->hdmatx != nullptr)
+          {
+            cb_tx_event<true> ();
+          }
+        else
+          {
+            cb_tx_event<false> ();
+          }
+      }
+
+      inline void
+      uart_impl::cb_rx_event (bool half)
+      {
+        if (huart_->hdmarx != nullptr)
+          {
+            cb_rx_event<true> (half);
+          }
+        else
+          {
+            cb_rx_event<false> (half);
+          }
+      }
+
+      /**
+       * @brief  Body of the interrupt handler, for a port receiving through
+       *    DMA (rx_dma true) or not. If the port receives through
+       *    interrupts, the registers are handled here without the HAL: the
+       *    received character goes straight to the receive buffer (as a 16
+       *    bit word with 9 data bits and no parity, and with the transfer
+       *    counters the HAL would use, so the two handlers can be swapped),
+       *    line errors are reported without stopping the
+       *    reception and the reader is woken only at the end of a buffer
+       *    half and on the receive events (idle, receiver timeout, character
+       *    match); the transmit interrupts are handled inline too. With a
+       *    receive DMA, it runs HAL_UART_IRQHandler() with the receive events
+       *    the HAL doesn't know about, as recommended in the README, after
+       *    queuing the line errors itself, without stopping the DMA. The
+       *    event functions called from here get the transfer modes (tx_dma
+       *    tells if the port transmits through DMA) as template arguments
+       *    too, so they don't test the handle either. A class knowing its
+       *    port at compile time calls the right variant directly (see
+       *    uart_static_impl).
+       */
+      template<bool rx_dma, bool tx_dma>
+        inline void
+        uart_impl::irq_service (void)
+        {
+          USART_TypeDef* usart = huart_->Instance;
+
+          if (rx_dma)
+            {
+              // the HAL aborts a DMA reception for any line error, and a
+              // circular one can't be restarted without losing the buffer:
+              // the errors are queued here, the DMA goes on
+              uint32_t errors = READ_REG(usart->ISR)
+                  & (USART_ISR_PE | USART_ISR_FE | USART_ISR_NE
+                      | USART_ISR_ORE);
+              if (errors && huart_->RxState == HAL_UART_STATE_BUSY_RX)
+                {
+                  WRITE_REG(usart->ICR, errors);
+                  huart_->ErrorCode =
+                      ((errors & USART_ISR_PE) ? HAL_UART_ERROR_PE : 0)
+                      | ((errors & USART_ISR_FE) ? HAL_UART_ERROR_FE : 0)
+                      | ((errors & USART_ISR_NE) ? HAL_UART_ERROR_NE : 0)
+                      | ((errors & USART_ISR_ORE) ? HAL_UART_ERROR_ORE : 0);
+                  cb_rx_event_error ();
+                  huart_->ErrorCode = HAL_UART_ERROR_NONE;
+                }
+              if (__HAL_UART_GET_FLAG(huart_, UART_FLAG_RTOF))
+                {
+                  cb_rx_event<rx_dma> (false);
+                }
+              HAL_UART_IRQHandler (huart_);
+              if (__HAL_UART_GET_FLAG(huart_, UART_FLAG_IDLE))
+                {
+                  __HAL_UART_CLEAR_IDLEFLAG(huart_);
+                  cb_rx_event<rx_dma> (false);
+                }
+              else if (__HAL_UART_GET_FLAG(huart_, UART_FLAG_CMF)
+                  && __HAL_UART_GET_IT_SOURCE(huart_, UART_IT_CM))
+                {
+                  cb_rx_event<rx_dma> (false);
+                }
+              return;
+            }
+
+          uint32_t isr = READ_REG(usart->ISR);
+          uint32_t cr1 = READ_REG(usart->CR1);
+
+          // while the receiver is paused (the buffer is full), RXNEIE is
+          // off and the character waits in RDR (see start_rx ())
+          if ((isr & USART_ISR_RXNE) && (cr1 & USART_CR1_RXNEIE))
+            {
+              uint16_t c = (uint16_t) (READ_REG(usart->RDR) & huart_->Mask);
+
+              if (huart_->RxState == HAL_UART_STATE_BUSY_RX)
+                {
+                  if (data_9b (huart_->Init))
+                    {
+                      // 16 bit words, as UART_RxISR_16BIT() stores them
+                      *(uint16_t*) huart_->pRxBuffPtr = c;
+                      huart_->pRxBuffPtr += 2;
+                    }
+                  else
+                    {
+                      *huart_->pRxBuffPtr++ = (uint8_t) c;
+                    }
+                  if (--huart_->RxXferCount == 0)
+                    {
+                      // end of the buffer half: wake the reader and re-arm
+                      huart_->RxState = HAL_UART_STATE_READY;
+                      cb_rx_event<rx_dma> (false);
+                    }
+                }
+            }
+
+          uint32_t errors = isr
+              & (USART_ISR_PE | USART_ISR_FE | USART_ISR_NE | USART_ISR_ORE);
+          if (errors && (cr1 & USART_CR1_RXNEIE))
+            {
+              // the ICR bits match the ISR ones, the HAL codes don't
+              WRITE_REG(usart->ICR, errors);
+              huart_->ErrorCode =
+                  ((errors & USART_ISR_PE) ? HAL_UART_ERROR_PE : 0)
+                  | ((errors & USART_ISR_FE) ? HAL_UART_ERROR_FE : 0)
+                  | ((errors & USART_ISR_NE) ? HAL_UART_ERROR_NE : 0)
+                  | ((errors & USART_ISR_ORE) ? HAL_UART_ERROR_ORE : 0);
+              cb_rx_event_error ();
+              huart_->ErrorCode = HAL_UART_ERROR_NONE;
+              if (huart_->RxState == HAL_UART_STATE_READY)
+                {
+                  // the reception goes on, where the error handling left it
+                  start_rx<rx_dma> (rx_ring_.head ());
+                }
+            }
+
+          if ((isr & USART_ISR_IDLE) && (cr1 & USART_CR1_IDLEIE))
+            {
+              __HAL_UART_CLEAR_IDLEFLAG(huart_);
+              cb_rx_event<rx_dma> (false);
+            }
+          else if (((isr & USART_ISR_RTOF) && (cr1 & USART_CR1_RTOIE))
+              || ((isr & USART_ISR_CMF) && (cr1 & USART_CR1_CMIE)))
+            {
+              cb_rx_event<rx_dma> (false);        // it clears the flags
+            }
+
+          if ((isr & USART_ISR_TXE) && (cr1 & USART_CR1_TXEIE))
+            {
+              if (huart_->TxXferCount == 0)
+                {
+                  // all in the USART, wait for the last stop bit
+                  CLEAR_BIT(usart->CR1, USART_CR1_TXEIE);
+                  SET_BIT(usart->CR1, USART_CR1_TCIE);
+                }
+              else
+                {
+                  if (data_9b (huart_->Init))
+                    {
+                      // 16 bit words, as UART_TxISR_16BIT() sends them
+                      WRITE_REG(usart->TDR,
+                                *(const uint16_t*) huart_->pTxBuffPtr & 0x1FF);
+                      huart_->pTxBuffPtr += 2;
+                    }
+                  else
+                    {
+                      WRITE_REG(usart->TDR, *huart_->pTxBuffPtr++);
+                    }
+                  huart_->TxXferCount--;
+                }
+            }
+          else if ((isr & USART_ISR_TC) && (cr1 & USART_CR1_TCIE))
+            {
+              CLEAR_BIT(usart->CR1, USART_CR1_TCIE);
+              huart_->gState = HAL_UART_STATE_READY;
+              cb_tx_event<tx_dma> ();
+            }
+        }
+
     } /* namespace stm32f7 */
   } /* namespace driver */
 } /* namespace os */
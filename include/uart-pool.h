@@ -0,0 +1,227 @@
+/*
+ * uart-pool.h
+ *
+ * Copyright (c) 2026 Lix N. Paulian (lix@paulian.net)
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom
+ * the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Created on: 16 Oct 2026 (LNP)
+ */
+
+#ifndef INCLUDE_UART_POOL_H_
+#define INCLUDE_UART_POOL_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "cmsis_device.h"
+
+// Size in bytes of the built-in DMA buffer pool; if 0, there is no built-in
+// pool and, unless the application registers one with
+// dma_pool::set_default(), the dynamic buffers are taken from the heap.
+#ifndef UART_DMA_POOL_SIZE
+#define UART_DMA_POOL_SIZE 0
+#endif
+
+// Allocation unit of the pools, a multiple of the cache line size.
+#ifndef UART_DMA_POOL_BLOCK_SIZE
+#define UART_DMA_POOL_BLOCK_SIZE 64
+#endif
+
+// Maximum number of blocks a pool can manage.
+#ifndef UART_DMA_POOL_MAX_BLOCKS
+#define UART_DMA_POOL_MAX_BLOCKS 512
+#endif
+
+// Set to true if the built-in pool is placed (see UART_DMA_POOL_SECTION)
+// in a region the MPU configures as non-cacheable.
+#ifndef UART_DMA_POOL_UNCACHED
+#define UART_DMA_POOL_UNCACHED false
+#endif
+
+// UART_DMA_POOL_SECTION may be defined as the name of a linker section for
+// the built-in pool (e.g. ".dtcm_bss"); by default it goes to .bss.
+
+#if defined (__cplusplus)
+
+namespace os
+{
+  namespace driver
+  {
+    namespace stm32f7
+    {
+      /**
+       * @brief  Fixed-block pool for DMA buffers.
+       *
+       * The region is split in blocks of UART_DMA_POOL_BLOCK_SIZE bytes,
+       * aligned on a cache line; a buffer takes a run of consecutive blocks,
+       * so it never shares a cache line with other data. A port closed and
+       * re-opened gets the same blocks back, without touching the heap.
+       * Allocations are meant for open()/close(), not for interrupts.
+       */
+      class dma_pool
+      {
+      public:
+
+        static constexpr std::size_t cache_line = 32;
+        static constexpr std::size_t block_size = UART_DMA_POOL_BLOCK_SIZE;
+        static constexpr std::size_t max_blocks = UART_DMA_POOL_MAX_BLOCKS;
+
+        static_assert (block_size % cache_line == 0,
+            "the block size must be a multiple of the cache line");
+
+        /**
+         * @brief  Create a pool over a memory region.
+         * @param  region: start of the region (aligned internally).
+         * @param  size: size of the region in bytes.
+         * @param  uncached: true if the region is not cached (e.g.
+         *    configured non-cacheable by the MPU); a region in DTCM is
+         *    detected automatically.
+         */
+        dma_pool (void* region, std::size_t size, bool uncached = false);
+
+        dma_pool (const dma_pool&) = delete;
+
+        dma_pool&
+        operator= (const dma_pool&) = delete;
+
+        void*
+        allocate (std::size_t size);
+
+        void
+        deallocate (void* ptr, std::size_t size);
+
+        bool
+        owns (const void* ptr) const;
+
+        bool
+        is_uncached (void) const;
+
+        std::size_t
+        blocks (void) const;
+
+        std::size_t
+        free_blocks (void) const;
+
+        static dma_pool*
+        get_default (void);
+
+        static void
+        set_default (dma_pool* pool);
+
+        static bool
+        is_dtcm (const void* ptr, std::size_t len);
+
+      private:
+
+        bool
+        test (std::size_t block) const;
+
+        void
+        mark (std::size_t first, std::size_t count, bool used);
+
+        uint8_t* base_;
+        std::size_t nblocks_;
+        bool uncached_;
+        uint32_t map_[(max_blocks + 31) / 32];
+
+        static dma_pool* default_;
+      };
+
+      /**
+       * @brief  Allocate a DMA buffer, aligned on and rounded up to a cache
+       *    line: from the default pool if one is set, otherwise from the heap.
+       * @param  size: size of the buffer in bytes.
+       * @param  owner: where to store the pool the buffer comes from
+       *    (nullptr for the heap), to be given back to dma_buffer_free().
+       * @return  The buffer, or nullptr if no memory is left.
+       */
+      uint8_t*
+      dma_buffer_alloc (std::size_t size, dma_pool** owner);
+
+      /**
+       * @brief  Release a buffer obtained from dma_buffer_alloc(), to the
+       *    pool it came from, even if the default pool changed meanwhile.
+       */
+      void
+      dma_buffer_free (uint8_t* buff, std::size_t size, dma_pool* owner);
+
+      /**
+       * @brief  Check if a buffer needs cache maintenance around DMA
+       *    transfers, i.e. it is neither in DTCM nor in a non-cacheable pool.
+       */
+      bool
+      dma_buffer_is_cached (const void* buff, std::size_t size);
+
+      // ----------------------------------------------------------------------
+
+      inline bool
+      dma_pool::owns (const void* ptr) const
+      {
+        return (const uint8_t*) ptr >= base_
+            && (const uint8_t*) ptr < base_ + nblocks_ * block_size;
+      }
+
+      inline bool
+      dma_pool::is_uncached (void) const
+      {
+        return uncached_ || is_dtcm (base_, nblocks_ * block_size);
+      }
+
+      inline std::size_t
+      dma_pool::blocks (void) const
+      {
+        return nblocks_;
+      }
+
+      inline dma_pool*
+      dma_pool::get_default (void)
+      {
+        return default_;
+      }
+
+      inline void
+      dma_pool::set_default (dma_pool* pool)
+      {
+        default_ = pool;
+      }
+
+      inline bool
+      dma_pool::is_dtcm (const void* ptr, std::size_t len)
+      {
+        return (uintptr_t) ptr >= DTCMRAM_BASE
+            && (uintptr_t) ptr + len <= SRAM1_BASE;
+      }
+
+      inline bool
+      dma_pool::test (std::size_t block) const
+      {
+        return map_[block / 32] & (1UL << (block % 32));
+      }
+
+    } /* namespace stm32f7 */
+  } /* namespace driver */
+} /* namespace os */
+
+#endif /* __cplusplus */
+
+#endif /* INCLUDE_UART_POOL_H_ */
@@ -0,0 +1,419 @@
+/*
+ * uart-ring.h
+ *
+ * Copyright (c) 2026 Lix N. Paulian (lix@paulian.net)
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom
+ * the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Created on: 16 Oct 2026 (LNP)
+ */
+
+#ifndef INCLUDE_UART_RING_H_
+#define INCLUDE_UART_RING_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+
+#include "uart-defs.h"
+
+#if defined (__cplusplus)
+
+namespace os
+{
+  namespace driver
+  {
+    namespace stm32f7
+    {
+      template<std::size_t N>
+        struct spsc_ring_storage
+        {
+          uint8_t data[N];
+        };
+
+      template<>
+        struct spsc_ring_storage<0>
+        {
+        };
+
+      /**
+       * @brief  Lock-free single producer/single consumer byte ring.
+       *
+       * One side (e.g. an ISR) only calls the producer functions, the other
+       * side (e.g. a thread) only the consumer functions; no locking is
+       * needed, the indexes are published with release/acquire ordering.
+       * One byte is always left unused, to tell a full ring from an empty
+       * one; the capacity is thus size() - 1.
+       *
+       * If N is not 0, the ring has its own storage of N bytes, otherwise
+       * it works on an external buffer passed to init(). Wrapping is done
+       * by masking when the size is a power of two, by comparing otherwise.
+       */
+      template<std::size_t N = 0>
+        class spsc_ring
+        {
+          static_assert (N != 1, "a ring needs at least two bytes");
+
+        public:
+
+          spsc_ring ();
+
+          spsc_ring (const spsc_ring&) = delete;
+
+          spsc_ring&
+          operator= (const spsc_ring&) = delete;
+
+          void
+          init (uint8_t* buff, std::size_t size);
+
+          uint8_t*
+          buffer (void) const;
+
+          std::size_t
+          size (void) const;
+
+          std::size_t
+          capacity (void) const;
+
+          bool
+          empty (void) const;
+
+          std::size_t
+          available (void) const;
+
+          std::size_t
+          room (void) const;
+
+          std::size_t
+          head (void) const;
+
+          std::size_t
+          tail (void) const;
+
+          // producer side
+
+          std::size_t
+          push (const uint8_t* data, std::size_t len);
+
+          uint8_t*
+          write_span (std::size_t& len) const;
+
+          void
+          produce (std::size_t n);
+
+          // consumer side
+
+          std::size_t
+          pop (uint8_t* data, std::size_t len, uint8_t mask = 0xFF);
+
+          const uint8_t*
+          read_span (std::size_t& len) const;
+
+          std::size_t
+          peek (const uint8_t*& first, std::size_t& first_len,
+                const uint8_t*& second, std::size_t& second_len) const;
+
+          void
+          consume (std::size_t n);
+
+          // neither side may be active
+          void
+          reset (void);
+
+        private:
+
+          static constexpr bool
+          is_pow2 (std::size_t n)
+          {
+            return n != 0 && (n & (n - 1)) == 0;
+          }
+
+          std::size_t
+          wrap (std::size_t i) const;
+
+          std::size_t
+          distance (std::size_t from, std::size_t to) const;
+
+          spsc_ring_storage<N> storage_;
+          uint8_t* buff_;
+          std::size_t size_;
+          std::size_t mask_;    // size_ - 1 if size_ is a power of two, or 0
+          std::atomic<std::size_t> head_;
+          std::atomic<std::size_t> tail_;
+        };
+
+      // ----------------------------------------------------------------------
+
+      template<std::size_t N>
+        spsc_ring<N>::spsc_ring () :
+            buff_
+              { nullptr }, //
+            size_
+              { N }, //
+            mask_
+              { is_pow2 (N) ? N - 1 : 0 }, //
+            head_
+              { 0 }, //
+            tail_
+              { 0 }
+        {
+          init (nullptr, N);
+        }
+
+      /**
+       * @brief  Attach the ring to a buffer (only for N == 0; for N != 0 the
+       *    arguments are ignored) and empty it.
+       */
+      template<std::size_t N>
+        inline void
+        spsc_ring<N>::init (uint8_t* buff, std::size_t size)
+        {
+          if (N != 0)
+            {
+              buff_ = reinterpret_cast<uint8_t*> (&storage_);
+            }
+          else
+            {
+              buff_ = buff;
+              size_ = size;
+              mask_ = is_pow2 (size) ? size - 1 : 0;
+            }
+          reset ();
+        }
+
+      template<std::size_t N>
+        inline uint8_t*
+        spsc_ring<N>::buffer (void) const
+        {
+          return buff_;
+        }
+
+      template<std::size_t N>
+        inline std::size_t
+        spsc_ring<N>::size (void) const
+        {
+          return N != 0 ? N : size_;
+        }
+
+      template<std::size_t N>
+        inline std::size_t
+        spsc_ring<N>::capacity (void) const
+        {
+          return size () ? size () - 1 : 0;
+        }
+
+      template<std::size_t N>
+        inline std::size_t
+        spsc_ring<N>::wrap (std::size_t i) const
+        {
+          if (N != 0)
+            {
+              // resolved at compile time
+              return is_pow2 (N) ? (i & (N - 1)) : (i >= N ? i - N : i);
+            }
+          return mask_ != 0 ? (i & mask_) : (i >= size_ ? i - size_ : i);
+        }
+
+      template<std::size_t N>
+        inline std::size_t
+        spsc_ring<N>::distance (std::size_t from, std::size_t to) const
+        {
+          return to >= from ? to - from : size () - from + to;
+        }
+
+      template<std::size_t N>
+        inline bool
+        spsc_ring<N>::empty (void) const
+        {
+          return head_.load (std::memory_order_acquire)
+              == tail_.load (std::memory_order_acquire);
+        }
+
+      /**
+       * @brief  Number of bytes the consumer can get.
+       */
+      template<std::size_t N>
+        inline std::size_t
+        spsc_ring<N>::available (void) const
+        {
+          return distance (tail_.load (std::memory_order_relaxed),
+                           head_.load (std::memory_order_acquire));
+        }
+
+      /**
+       * @brief  Number of bytes the producer can add.
+       */
+      template<std::size_t N>
+        inline std::size_t
+        spsc_ring<N>::room (void) const
+        {
+          return capacity ()
+              - distance (tail_.load (std::memory_order_acquire),
+                          head_.load (std::memory_order_relaxed));
+        }
+
+      /**
+       * @brief  Index of the next byte the producer writes.
+       */
+      template<std::size_t N>
+        inline std::size_t
+        spsc_ring<N>::head (void) const
+        {
+          return head_.load (std::memory_order_acquire);
+        }
+
+      /**
+       * @brief  Index of the next byte the consumer reads.
+       */
+      template<std::size_t N>
+        inline std::size_t
+        spsc_ring<N>::tail (void) const
+        {
+          return tail_.load (std::memory_order_acquire);
+        }
+
+      /**
+       * @brief  Copy data to the ring, as much as fits.
+       * @return  Number of bytes copied.
+       */
+      template<std::size_t N>
+        std::size_t
+        spsc_ring<N>::push (const uint8_t* data, std::size_t len)
+        {
+          std::size_t h = head_.load (std::memory_order_relaxed);
+          std::size_t n = std::min (len, room ());
+          std::size_t first = std::min (n, size () - h);
+
+          memcpy (buff_ + h, data, first);
+          memcpy (buff_, data + first, n - first);
+          head_.store (wrap (h + n), std::memory_order_release);
+          return n;
+        }
+
+      /**
+       * @brief  Get the contiguous free space at the head of the ring, to be
+       *    filled in place and committed with produce().
+       */
+      template<std::size_t N>
+        inline uint8_t*
+        spsc_ring<N>::write_span (std::size_t& len) const
+        {
+          std::size_t h = head_.load (std::memory_order_relaxed);
+
+          len = std::min (room (), size () - h);
+          return buff_ + h;
+        }
+
+      /**
+       * @brief  Commit n bytes written in place (e.g. by a DMA).
+       */
+      template<std::size_t N>
+        inline void
+        spsc_ring<N>::produce (std::size_t n)
+        {
+          head_.store (wrap (head_.load (std::memory_order_relaxed) + n),
+                       std::memory_order_release);
+        }
+
+      /**
+       * @brief  Copy data out of the ring, as much as available.
+       * @param  mask: bits to keep from each byte (see mask_copy()).
+       * @return  Number of bytes copied.
+       */
+      template<std::size_t N>
+        std::size_t
+        spsc_ring<N>::pop (uint8_t* data, std::size_t len, uint8_t mask)
+        {
+          std::size_t t = tail_.load (std::memory_order_relaxed);
+          std::size_t n = std::min (len, available ());
+          std::size_t first = std::min (n, size () - t);
+
+          mask_copy (data, buff_ + t, first, mask);
+          mask_copy (data + first, buff_, n - first, mask);
+          tail_.store (wrap (t + n), std::memory_order_release);
+          return n;
+        }
+
+      /**
+       * @brief  Get the contiguous data at the tail of the ring, to be used
+       *    in place and released with consume().
+       */
+      template<std::size_t N>
+        inline const uint8_t*
+        spsc_ring<N>::read_span (std::size_t& len) const
+        {
+          std::size_t t = tail_.load (std::memory_order_relaxed);
+
+          len = std::min (available (), size () - t);
+          return buff_ + t;
+        }
+
+      /**
+       * @brief  Get all the available data, as two contiguous spans (before
+       *    and after the end of the buffer), to be used in place and
+       *    released with consume().
+       * @return  Total number of bytes in the two spans.
+       */
+      template<std::size_t N>
+        std::size_t
+        spsc_ring<N>::peek (const uint8_t*& first, std::size_t& first_len,
+                            const uint8_t*& second,
+                            std::size_t& second_len) const
+        {
+          std::size_t t = tail_.load (std::memory_order_relaxed);
+          std::size_t n = available ();
+
+          first = buff_ + t;
+          first_len = std::min (n, size () - t);
+          second = buff_;
+          second_len = n - first_len;
+          return n;
+        }
+
+      /**
+       * @brief  Release n bytes used in place.
+       */
+      template<std::size_t N>
+        inline void
+        spsc_ring<N>::consume (std::size_t n)
+        {
+          tail_.store (wrap (tail_.load (std::memory_order_relaxed) + n),
+                       std::memory_order_release);
+        }
+
+      template<std::size_t N>
+        inline void
+        spsc_ring<N>::reset (void)
+        {
+          head_.store (0, std::memory_order_relaxed);
+          tail_.store (0, std::memory_order_release);
+        }
+
+    } /* namespace stm32f7 */
+  } /* namespace driver */
+} /* namespace os */
+
+#endif /* __cplusplus */
+
+#endif /* INCLUDE_UART_RING_H_ */
@@ -0,0 +1,250 @@
+/*
+ * uart-static.h
+ *
+ * Copyright (c) 2026 Lix N. Paulian (lix@paulian.net)
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom
+ * the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Created on: 16 Oct 2026 (LNP)
+ */
+
+#ifndef INCLUDE_UART_STATIC_H_
+#define INCLUDE_UART_STATIC_H_
+
+#include "uart-drv.h"
+
+#if defined (__cplusplus)
+
+namespace os
+{
+  namespace driver
+  {
+    namespace stm32f7
+    {
+      /**
+       * @brief  How a port receives and transmits: through USART interrupts
+       *    or DMA (the handle must match, otherwise open() fails with
+       *    EINVAL).
+       */
+      enum class uart_xfer
+      {
+        interrupt, dma
+      };
+
+      /**
+       * @brief  Cache policy of the buffers: maintain them around the DMA
+       *    transfers if they are cached, or never (the port object is placed
+       *    in DTCM or in a region the MPU configures as non-cacheable).
+       */
+      enum class uart_cache
+      {
+        maintain, none
+      };
+
+      /**
+       * @brief  RS-485 policies: the USART is not in RS-485 mode...
+       */
+      struct rs485_off
+      {
+        static constexpr uint32_t params = 0;
+        static constexpr bool soft_de = false;
+      };
+
+      /**
+       * @brief  ...the USART drives DE, with the given rs485_flags (see
+       *    uart_impl)...
+       */
+      template<uint32_t flags>
+        struct rs485_hw
+        {
+          static constexpr uint32_t params = flags | uart_impl::RS485_MASK;
+          static constexpr bool soft_de = false;
+        };
+
+      /**
+       * @brief  ...or the derived class drives DE by software, in its
+       *    rs485_de() function.
+       */
+      struct rs485_soft
+      {
+        static constexpr uint32_t params = 0;
+        static constexpr bool soft_de = true;
+      };
+
+      /**
+       * @brief  Buffers of a uart_static_impl, each on its own cache lines.
+       */
+      template<std::size_t tx_size, std::size_t rx_size>
+        struct uart_static_storage
+        {
+          static constexpr std::size_t
+          lines (std::size_t size)
+          {
+            return (size + dma_pool::cache_line - 1)
+                & ~(dma_pool::cache_line - 1);
+          }
+
+          alignas(dma_pool::cache_line) uint8_t tx_storage_[lines (tx_size)];
+          alignas(dma_pool::cache_line) uint8_t rx_storage_[lines (rx_size)];
+        };
+
+      /**
+       * @brief  UART driver specialized at compile time for one port.
+       *
+       * A partial step towards a driver specialized at compile time: the
+       * template parameters fix the storage and the interrupt path only.
+       * The buffers are members, sized and aligned at compile time, so
+       * nothing is allocated at open(). The transfer mode, of both
+       * directions, is a template argument of the interrupt handler and of
+       * the receive and transmit event functions it calls, which don't test
+       * the handle.
+       *
+       * The rest is the common uart_impl, compiled once for all ports:
+       * read(), write() and the HAL call-backs still test the handle for DMA
+       * streams, the cache and RS-485 policies only set its run-time flags
+       * (the DE hook is not called unless the policy is rs485_soft) and the
+       * hooks of the derived class, rs485_de(), on_open() and on_close(),
+       * are reached through the virtual functions of uart_impl, which this
+       * class overrides to forward to them (the class names itself as
+       * Derived and hides those it needs). So it goes in a
+       * posix::tty_implementable like uart_impl:
+       *
+       *    class gps_impl : public uart_static_impl<gps_impl, 256, 512,
+       *        uart_xfer::interrupt, rs485_soft>
+       *    { ... void rs485_de (bool state); ... };
+       *
+       *    posix::tty_implementable<gps_impl> gps { "gps", &huart2 };
+       *
+       * and the vector calls gps.impl ().irq_handler ().
+       */
+      template<typename Derived, std::size_t tx_size, std::size_t rx_size,
+          uart_xfer xfer = uart_xfer::dma, typename Rs485 = rs485_off,
+          uart_cache cache = uart_cache::maintain>
+        class uart_static_impl : private uart_static_storage<tx_size, rx_size>,
+                                 public uart_impl
+        {
+          static_assert (tx_size > 0 && tx_size <= 0xFFFF,
+              "the transmit buffer size must be 1 to 65535 bytes");
+          static_assert (rx_size >= 2 && rx_size <= 0xFFFF && rx_size % 2 == 0,
+              "the receive buffer size must be even, 2 to 65535 bytes");
+
+        public:
+
+          uart_static_impl (UART_HandleTypeDef* huart) :
+              uart_impl
+                { huart, this->tx_storage_, this->rx_storage_, tx_size,
+                    rx_size, Rs485::params }
+          {
+            rs485_de_hook_ = Rs485::soft_de;
+            cache_maintenance_ = cache == uart_cache::maintain;
+            dma_expected_ = xfer == uart_xfer::dma;
+          }
+
+          uart_static_impl (const uart_static_impl&) = delete;
+
+          uart_static_impl&
+          operator= (const uart_static_impl&) = delete;
+
+          virtual
+          ~uart_static_impl () noexcept = default;
+
+          void
+          irq_handler (void)
+          {
+            irq_service<xfer == uart_xfer::dma, xfer == uart_xfer::dma> ();
+          }
+
+          // default hooks, hidden by Derived's ones
+
+          void
+          rs485_de (bool)
+          {
+            ;
+          }
+
+          void
+          on_open (void)
+          {
+            ;
+          }
+
+          void
+          on_close (void)
+          {
+            ;
+          }
+
+        protected:
+
+          virtual void
+          do_rs485_de (bool state) override final
+          {
+            static_cast<Derived*> (this)->rs485_de (state);
+          }
+
+          virtual void
+          open_hook (void) override final
+          {
+            static_cast<Derived*> (this)->on_open ();
+          }
+
+          virtual void
+          close_hook (void) override final
+          {
+            static_cast<Derived*> (this)->on_close ();
+          }
+        };
+
+      /**
+       * @brief  A uart_static_impl without hooks of its own, e.g.
+       *    uart_static<256, 512, uart_xfer::interrupt> uart3 { "uart3",
+       *    &huart3 };
+       */
+      template<std::size_t tx_size, std::size_t rx_size,
+          uart_xfer xfer = uart_xfer::dma, typename Rs485 = rs485_off,
+          uart_cache cache = uart_cache::maintain>
+        class uart_static_port final : public uart_static_impl<
+            uart_static_port<tx_size, rx_size, xfer, Rs485, cache>, tx_size,
+            rx_size, xfer, Rs485, cache>
+        {
+          static_assert (!Rs485::soft_de,
+              "a software driven DE needs a class with an rs485_de ()");
+
+        public:
+
+          using uart_static_impl<uart_static_port, tx_size, rx_size, xfer,
+              Rs485, cache>::uart_static_impl;
+        };
+
+      template<std::size_t tx_size, std::size_t rx_size,
+          uart_xfer xfer = uart_xfer::dma, typename Rs485 = rs485_off,
+          uart_cache cache = uart_cache::maintain>
+        using uart_static = posix::tty_implementable<
+        uart_static_port<tx_size, rx_size, xfer, Rs485, cache>>;
+
+    } /* namespace stm32f7 */
+  } /* namespace driver */
+} /* namespace os */
+
+#endif /* __cplusplus */
+
+#endif /* INCLUDE_UART_STATIC_H_ */
@@ -0,0 +1,224 @@
+/*
+ * tty.h
+ *
+ * Copyright (c) 2026 Lix N. Paulian (lix@paulian.net)
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom
+ * the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Created on: 16 Oct 2026 (LNP)
+ *
+ * Host simulation of the µOS++ POSIX I/O tty classes: the implementation
+ * interface (tty_impl), the user facing tty and the tty_implementable
+ * template, plus a minimal /dev registry behind posix::open().
+ */
+
+#ifndef SIM_CMSIS_PLUS_POSIX_IO_TTY_H_
+#define SIM_CMSIS_PLUS_POSIX_IO_TTY_H_
+
+#include <stddef.h>
+#include <sys/types.h>
+#include <cstdarg>
+#include <utility>
+
+#include <cmsis-plus/posix/termios.h>
+
+#if defined (__cplusplus)
+
+namespace os
+{
+  namespace posix
+  {
+    class io;
+
+    /**
+     * @brief Open a device registered as "/dev/<name>".
+     * @return Pointer to the device, or nullptr (errno set) on failure.
+     */
+    io*
+    open (const char* path, int oflag, ...);
+
+    class tty_impl
+    {
+    public:
+
+      tty_impl () = default;
+
+      virtual
+      ~tty_impl () noexcept = default;
+
+      virtual int
+      do_vopen (const char* path, int oflag, std::va_list args) = 0;
+
+      virtual int
+      do_close (void) = 0;
+
+      virtual ssize_t
+      do_read (void* buf, std::size_t nbyte) = 0;
+
+      virtual ssize_t
+      do_write (const void* buf, std::size_t nbyte) = 0;
+
+      virtual bool
+      do_is_opened (void) = 0;
+
+      virtual bool
+      do_is_connected (void) = 0;
+
+      virtual int
+      do_vioctl (int request, std::va_list args) = 0;
+
+      virtual int
+      do_tcgetattr (struct termios* ptio) = 0;
+
+      virtual int
+      do_tcsetattr (int options, const struct termios* ptio) = 0;
+
+      virtual int
+      do_tcflush (int queue_selector) = 0;
+
+      virtual int
+      do_tcsendbreak (int duration) = 0;
+
+      virtual int
+      do_tcdrain (void) = 0;
+    };
+
+    class io
+    {
+    public:
+
+      virtual
+      ~io () noexcept = default;
+
+      virtual int
+      close (void) = 0;
+
+      virtual ssize_t
+      read (void* buf, std::size_t nbyte) = 0;
+
+      virtual ssize_t
+      write (const void* buf, std::size_t nbyte) = 0;
+    };
+
+    class tty : public io
+    {
+    public:
+
+      tty (tty_impl& impl, const char* name);
+
+      virtual
+      ~tty () noexcept;
+
+      tty (const tty&) = delete;
+
+      tty&
+      operator= (const tty&) = delete;
+
+      int
+      vopen (const char* path, int oflag, std::va_list args);
+
+      virtual int
+      close (void) override;
+
+      virtual ssize_t
+      read (void* buf, std::size_t nbyte) override;
+
+      virtual ssize_t
+      write (const void* buf, std::size_t nbyte) override;
+
+      int
+      ioctl (int request, ...);
+
+      int
+      vioctl (int request, std::va_list args);
+
+      bool
+      is_opened (void);
+
+      bool
+      is_connected (void);
+
+      int
+      tcgetattr (struct termios* ptio);
+
+      int
+      tcsetattr (int options, const struct termios* ptio);
+
+      int
+      tcflush (int queue_selector);
+
+      int
+      tcsendbreak (int duration);
+
+      int
+      tcdrain (void);
+
+      const char*
+      name (void) const;
+
+      static tty*
+      find (const char* name);
+
+    protected:
+
+      tty_impl& impl_;
+      const char* name_;
+      tty* next_;
+    };
+
+    template<typename T>
+      class tty_implementable : public tty
+      {
+      public:
+
+        using value_type = T;
+
+        template<typename ... Args>
+          tty_implementable (const char* name, Args&&... args) :
+              tty
+                { impl_instance_, name }, //
+              impl_instance_
+                { std::forward<Args>(args)... }
+          {
+            ;
+          }
+
+        virtual
+        ~tty_implementable () noexcept = default;
+
+        value_type&
+        impl (void) const
+        {
+          return const_cast<value_type&> (impl_instance_);
+        }
+
+      protected:
+
+        value_type impl_instance_;
+      };
+
+  } /* namespace posix */
+} /* namespace os */
+
+#endif /* __cplusplus */
+
+#endif /* SIM_CMSIS_PLUS_POSIX_IO_TTY_H_ */
@@ -0,0 +1,168 @@
+/*
+ * os.h
+ *
+ * Copyright (c) 2026 Lix N. Paulian (lix@paulian.net)
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom
+ * the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Created on: 16 Oct 2026 (LNP)
+ *
+ * Host simulation of the subset of the µOS++ RTOS API used by the drivers:
+ * the system clock, binary semaphores and interrupt critical sections.
+ *
+ * Simulated interrupt handlers run on a separate host thread and hold the
+ * "interrupt lock" while they execute; a critical section takes the same
+ * lock, so a thread inside one can not be preempted by an ISR, exactly as
+ * on the target.
+ */
+
+#ifndef SIM_CMSIS_PLUS_RTOS_OS_H_
+#define SIM_CMSIS_PLUS_RTOS_OS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <errno.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/types.h>
+
+#include <algorithm>
+#include <cstdarg>
+#include <mutex>
+#include <condition_variable>
+
+#include "cmsis_device.h"
+
+#if defined (__cplusplus)
+
+namespace os
+{
+  namespace rtos
+  {
+    using result_t = uint32_t;
+
+    namespace result
+    {
+      constexpr result_t ok = 0;
+    } /* namespace result */
+
+    class clock
+    {
+    public:
+
+      using duration_t = uint32_t;
+      using timestamp_t = uint64_t;
+
+      timestamp_t
+      now (void);
+
+      result_t
+      sleep_for (duration_t duration);
+
+      /**
+       * @brief Monotonic time with a sub-tick resolution (host only).
+       */
+      static uint64_t
+      now_ns (void);
+    };
+
+    class clock_systick : public clock
+    {
+    public:
+
+      static constexpr uint32_t frequency_hz = 1000;
+    };
+
+    extern clock_systick sysclock;
+
+    class semaphore_binary
+    {
+    public:
+
+      using count_t = int16_t;
+
+      semaphore_binary (const char* name, count_t initial_value);
+
+      semaphore_binary (const semaphore_binary&) = delete;
+
+      semaphore_binary&
+      operator= (const semaphore_binary&) = delete;
+
+      result_t
+      post (void);
+
+      result_t
+      wait (void);
+
+      result_t
+      try_wait (void);
+
+      result_t
+      timed_wait (clock::duration_t timeout);
+
+      count_t
+      value (void) const;
+
+      result_t
+      reset (void);
+
+      const char*
+      name (void) const;
+
+    private:
+
+      const char* name_;
+      count_t initial_value_;
+      count_t count_;
+      mutable std::mutex mx_;
+      std::condition_variable cv_;
+    };
+
+    namespace interrupts
+    {
+      /**
+       * @brief Return true if called from a (simulated) interrupt handler.
+       */
+      bool
+      in_handler_mode (void);
+
+      class critical_section
+      {
+      public:
+
+        critical_section ();
+
+        ~critical_section ();
+
+        critical_section (const critical_section&) = delete;
+
+        critical_section&
+        operator= (const critical_section&) = delete;
+      };
+
+    } /* namespace interrupts */
+  } /* namespace rtos */
+} /* namespace os */
+
+#endif /* __cplusplus */
+
+#endif /* SIM_CMSIS_PLUS_RTOS_OS_H_ */
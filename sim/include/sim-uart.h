@@ -0,0 +1,196 @@
+/*
+ * sim-uart.h
+ *
+ * Copyright (c) 2026 Lix N. Paulian (lix@paulian.net)
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom
+ * the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Created on: 16 Oct 2026 (LNP)
+ *
+ * Control interface of the host simulation: the "other end of the wire"
+ * for the simulated USARTs and USB CDC devices, plus counters that the
+ * target can not provide (cache maintenance, overruns on the wire, etc).
+ *
+ * The peripherals are serviced by a single host thread that plays the role
+ * of the interrupt context. Each USART advances one character time per
+ * "slot", derived from its BRR/CR1/CR2 registers, so transfers run at the
+ * programmed baud rate in real time. Cache maintenance also takes time,
+ * modelled per cache line, so it shows in DWT->CYCCNT measurements.
+ */
+
+#ifndef SIM_SIM_UART_H_
+#define SIM_SIM_UART_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "stm32f7xx_hal.h"
+#include "usbd_cdc.h"
+
+// error flags that can be attached to injected characters
+#define SIM_CHAR_PE USART_ISR_PE
+#define SIM_CHAR_FE USART_ISR_FE
+#define SIM_CHAR_NE USART_ISR_NE
+#define SIM_CHAR_ORE USART_ISR_ORE      // characters lost before this one
+
+struct sim_uart_stats
+{
+  uint64_t tx_chars;     // characters shifted out
+  uint64_t rx_chars;     // characters shifted in
+  uint64_t rx_overruns;  // characters lost because RDR was full (ORE)
+  uint64_t irqs;         // UART interrupt vector invocations
+  uint64_t lag_slots;    // character slots skipped because the host lagged
+  uint64_t tx_stall_slots; // character slots TxD idled during a transfer
+};
+
+struct sim_cache_stats
+{
+  uint64_t clean_calls;
+  uint64_t clean_bytes;
+  uint64_t invalidate_calls;
+  uint64_t invalidate_bytes;
+};
+
+/**
+ * @brief Start the peripheral thread; called implicitly by the first
+ *      HAL_UART_Init()/USB_DEVICE_Init().
+ */
+void
+sim_start (void);
+
+/**
+ * @brief Stop the peripheral thread (optional, done at exit).
+ */
+void
+sim_stop (void);
+
+/**
+ * @brief Set the APB clocks feeding the USARTs (default 54/108 MHz).
+ */
+void
+sim_rcc_set_pclk (uint32_t pclk1, uint32_t pclk2);
+
+/**
+ * @brief Select the clock of a USART's baud rate generator, as
+ *      RCC_DCKCFGR2.USARTxSEL (default its APB clock).
+ */
+void
+sim_rcc_set_uart_source (USART_TypeDef* usart, UART_ClockSourceTypeDef source);
+
+/**
+ * @brief Install the interrupt vector of a USART, i.e. the application's
+ *      USARTx_IRQHandler(). By default HAL_UART_IRQHandler() followed by
+ *      the idle line handling recommended in the README is used.
+ */
+void
+sim_uart_set_irq_handler (USART_TypeDef* usart, void
+(*handler) (void));
+
+/**
+ * @brief Connect TxD to RxD of the same USART.
+ */
+void
+sim_uart_loopback (USART_TypeDef* usart, bool enable);
+
+/**
+ * @brief Cross-connect two USARTs (TxD of each to RxD of the other).
+ */
+void
+sim_uart_connect (USART_TypeDef* a, USART_TypeDef* b);
+
+/**
+ * @brief Queue characters on the RxD line; they arrive at the receiver's
+ *      baud rate, back to back.
+ * @param flags: error flags (SIM_CHAR_xx) attached to every character.
+ */
+void
+sim_uart_inject (USART_TypeDef* usart, const uint8_t* data, size_t len,
+                 uint32_t flags);
+
+/**
+ * @brief Queue one idle character time on the RxD line (frame gap).
+ */
+void
+sim_uart_inject_idle (USART_TypeDef* usart, size_t char_times);
+
+/**
+ * @brief Delay the transfer interrupts (half/complete) of the DMA streams
+ *      by a number of character times of the USART they serve, to model
+ *      the interrupt latency; meanwhile, a stream in normal mode is
+ *      stopped, a circular one goes on. 0 (the default) runs them at once.
+ */
+void
+sim_dma_set_irq_latency (uint32_t char_times);
+
+/**
+ * @brief Return the number of characters still queued on the RxD line.
+ */
+size_t
+sim_uart_pending (USART_TypeDef* usart);
+
+/**
+ * @brief Install a hook called (in interrupt context) for every character
+ *      leaving TxD; breaks are reported with the 0x100 bit set.
+ */
+void
+sim_uart_set_tx_hook (USART_TypeDef* usart, void
+(*hook) (uint16_t c, void* arg),
+                      void* arg);
+
+/**
+ * @brief Return the effective baud rate programmed in BRR (0 if disabled).
+ */
+uint32_t
+sim_uart_get_baud (USART_TypeDef* usart);
+
+void
+sim_uart_get_stats (USART_TypeDef* usart, sim_uart_stats* stats);
+
+void
+sim_cache_get_stats (sim_cache_stats* stats);
+
+void
+sim_cache_reset_stats (void);
+
+/**
+ * @brief Set the negotiated speed of a USB device (before opening it).
+ */
+void
+sim_usb_set_speed (uint8_t usb_id, USBD_SpeedTypeDef speed);
+
+/**
+ * @brief Send a bulk OUT transfer from the host; split into packets, with
+ *      a zero length packet if needed.
+ */
+void
+sim_usb_host_send (uint8_t usb_id, const uint8_t* data, size_t len);
+
+/**
+ * @brief Install a hook called (in interrupt context) for every IN packet
+ *      received by the host.
+ */
+void
+sim_usb_set_tx_hook (uint8_t usb_id, void
+(*hook) (const uint8_t* data, size_t len, void* arg),
+                     void* arg);
+
+#endif /* SIM_SIM_UART_H_ */
@@ -0,0 +1,618 @@
+/*
+ * stm32f7xx_hal.h
+ *
+ * Copyright (c) 2026 Lix N. Paulian (lix@paulian.net)
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom
+ * the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Created on: 16 Oct 2026 (LNP)
+ *
+ * Host simulation of the subset of the STM32F7xx CMSIS device header and
+ * UART/DMA HAL used by the drivers. Register names, bit positions and HAL
+ * semantics follow the ST originals, so the driver sources compile and run
+ * unmodified on the host.
+ */
+
+#ifndef SIM_STM32F7XX_HAL_H_
+#define SIM_STM32F7XX_HAL_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+// ----------------------------------------------------------------------------
+// Registers
+
+// Peripheral registers are plain volatile words, as on the target: the
+// simulated peripheral updates them from its own thread, just like the real
+// one does in parallel with the core.
+typedef volatile uint32_t sim_reg_t;
+
+struct sim_usart;
+
+/**
+ * @brief Write-only/read-with-side-effects register (RQR, ICR, RDR, TDR):
+ *      accesses are forwarded to the peripheral model.
+ */
+class sim_usart_reg
+{
+public:
+  sim_usart_reg (sim_usart* owner, uint8_t offset) :
+      owner_
+        { owner }, //
+      offset_
+        { offset }
+  {
+    ;
+  }
+
+  sim_usart_reg&
+  operator= (uint32_t value);
+
+  operator uint32_t () const;
+
+private:
+  sim_usart* owner_;
+  uint8_t offset_;
+};
+
+typedef struct sim_usart
+{
+  sim_usart (void);
+
+  sim_reg_t CR1;
+  sim_reg_t CR2;
+  sim_reg_t CR3;
+  sim_reg_t BRR;
+  sim_reg_t GTPR;
+  sim_reg_t RTOR;
+  sim_usart_reg RQR;
+  sim_reg_t ISR;
+  sim_usart_reg ICR;
+  sim_usart_reg RDR;
+  sim_usart_reg TDR;
+} USART_TypeDef;
+
+typedef struct
+{
+  sim_reg_t CR;
+  sim_reg_t NDTR;
+  volatile uintptr_t PAR;
+  volatile uintptr_t M0AR;
+  volatile uintptr_t M1AR;
+  sim_reg_t FCR;
+} DMA_Stream_TypeDef;
+
+typedef struct
+{
+  sim_reg_t CCR;
+} SCB_Type;
+
+/**
+ * @brief Cycle counter, derived from the host monotonic clock scaled to
+ *      SystemCoreClock.
+ */
+class sim_cyccnt
+{
+public:
+  sim_cyccnt&
+  operator= (uint32_t value);
+
+  operator uint32_t () const;
+};
+
+typedef struct
+{
+  sim_reg_t CTRL;
+  sim_cyccnt CYCCNT;
+} DWT_Type;
+
+typedef struct
+{
+  sim_reg_t DEMCR;
+} CoreDebug_Type;
+
+extern USART_TypeDef sim_usart_instances[8];
+extern DMA_Stream_TypeDef sim_dma_streams[16];
+extern SCB_Type sim_scb;
+extern DWT_Type sim_dwt;
+extern CoreDebug_Type sim_core_debug;
+
+#define USART1 (&sim_usart_instances[0])
+#define USART2 (&sim_usart_instances[1])
+#define USART3 (&sim_usart_instances[2])
+#define UART4 (&sim_usart_instances[3])
+#define UART5 (&sim_usart_instances[4])
+#define USART6 (&sim_usart_instances[5])
+#define UART7 (&sim_usart_instances[6])
+#define UART8 (&sim_usart_instances[7])
+
+// the simulated USARTs are not at their real addresses, index the driver's
+// table of ports by their position
+#define UART_DISPATCH_SLOT(instance) \
+  ((uintptr_t) ((instance) - sim_usart_instances))
+
+#define DMA1_Stream0 (&sim_dma_streams[0])
+#define DMA1_Stream1 (&sim_dma_streams[1])
+#define DMA1_Stream2 (&sim_dma_streams[2])
+#define DMA1_Stream3 (&sim_dma_streams[3])
+#define DMA1_Stream4 (&sim_dma_streams[4])
+#define DMA1_Stream5 (&sim_dma_streams[5])
+#define DMA1_Stream6 (&sim_dma_streams[6])
+#define DMA1_Stream7 (&sim_dma_streams[7])
+#define DMA2_Stream0 (&sim_dma_streams[8])
+#define DMA2_Stream1 (&sim_dma_streams[9])
+#define DMA2_Stream2 (&sim_dma_streams[10])
+#define DMA2_Stream3 (&sim_dma_streams[11])
+#define DMA2_Stream4 (&sim_dma_streams[12])
+#define DMA2_Stream5 (&sim_dma_streams[13])
+#define DMA2_Stream6 (&sim_dma_streams[14])
+#define DMA2_Stream7 (&sim_dma_streams[15])
+
+#define SCB (&sim_scb)
+#define DWT (&sim_dwt)
+#define CoreDebug (&sim_core_debug)
+
+// On the host everything is "cached"; no DTCM (an empty range where the
+// target has it).
+#define DTCMRAM_BASE 0x20000000UL
+#define SRAM1_BASE 0x20000000UL
+#define FLASHITCM_BASE 0x00200000UL
+#define FLASHAXI_BASE 0x08000000UL
+#define FLASH_END 0x081FFFFFUL
+
+#define SCB_CCR_DC_Pos 16U
+#define SCB_CCR_DC_Msk (1UL << SCB_CCR_DC_Pos)
+#define DWT_CTRL_CYCCNTENA_Msk (1UL << 0)
+#define CoreDebug_DEMCR_TRCENA_Msk (1UL << 24)
+
+#define USART_CR1_UE (1U << 0)
+#define USART_CR1_RE (1U << 2)
+#define USART_CR1_TE (1U << 3)
+#define USART_CR1_IDLEIE (1U << 4)
+#define USART_CR1_RXNEIE (1U << 5)
+#define USART_CR1_TCIE (1U << 6)
+#define USART_CR1_TXEIE (1U << 7)
+#define USART_CR1_PEIE (1U << 8)
+#define USART_CR1_PS (1U << 9)
+#define USART_CR1_PCE (1U << 10)
+#define USART_CR1_M0 (1U << 12)
+#define USART_CR1_CMIE (1U << 14)
+#define USART_CR1_OVER8 (1U << 15)
+#define USART_CR1_DEDT_Pos 16U
+#define USART_CR1_DEAT_Pos 21U
+#define USART_CR1_RTOIE (1U << 26)
+#define USART_CR1_M1 (1U << 28)
+#define USART_CR1_M (USART_CR1_M0 | USART_CR1_M1)
+
+#define USART_CR2_ADDM7 (1U << 4)
+#define USART_CR2_STOP_Pos 12U
+#define USART_CR2_STOP (3U << USART_CR2_STOP_Pos)
+#define USART_CR2_TXINV (1U << 17)
+#define USART_CR2_RTOEN (1U << 23)
+#define USART_CR2_ADD_Pos 24U
+#define USART_CR2_ADD (0xFFU << USART_CR2_ADD_Pos)
+
+#define USART_CR3_EIE (1U << 0)
+#define USART_CR3_DMAR (1U << 6)
+#define USART_CR3_DMAT (1U << 7)
+#define USART_CR3_RTSE (1U << 8)
+#define USART_CR3_CTSE (1U << 9)
+#define USART_CR3_DEM (1U << 14)
+#define USART_CR3_DEP (1U << 15)
+
+#define USART_RTOR_RTO (0xFFFFFFU)
+
+#define USART_RQR_SBKRQ (1U << 1)
+#define USART_RQR_RXFRQ (1U << 3)
+
+#define USART_ISR_PE (1U << 0)
+#define USART_ISR_FE (1U << 1)
+#define USART_ISR_NE (1U << 2)
+#define USART_ISR_ORE (1U << 3)
+#define USART_ISR_IDLE (1U << 4)
+#define USART_ISR_RXNE (1U << 5)
+#define USART_ISR_TC (1U << 6)
+#define USART_ISR_TXE (1U << 7)
+#define USART_ISR_RTOF (1U << 11)
+#define USART_ISR_BUSY (1U << 16)
+#define USART_ISR_CMF (1U << 17)
+#define USART_ISR_SBKF (1U << 18)
+
+#define USART_ICR_PECF USART_ISR_PE
+#define USART_ICR_FECF USART_ISR_FE
+#define USART_ICR_NCF USART_ISR_NE
+#define USART_ICR_ORECF USART_ISR_ORE
+#define USART_ICR_IDLECF USART_ISR_IDLE
+#define USART_ICR_TCCF USART_ISR_TC
+#define USART_ICR_RTOCF USART_ISR_RTOF
+#define USART_ICR_CMCF USART_ISR_CMF
+
+#define DMA_SxCR_EN (1U << 0)
+#define DMA_SxCR_CIRC (1U << 8)
+#define DMA_SxCR_PSIZE_0 (1U << 11)
+#define DMA_SxCR_MSIZE_0 (1U << 13)
+#define DMA_SxCR_DBM (1U << 18)
+#define DMA_SxCR_CT (1U << 19)
+
+#define READ_REG(REG) ((REG))
+#define WRITE_REG(REG, VAL) ((REG) = (VAL))
+#define SET_BIT(REG, BIT) ((REG) |= (BIT))
+#define CLEAR_BIT(REG, BIT) ((REG) &= ~(BIT))
+#define READ_BIT(REG, BIT) ((REG) & (BIT))
+#define MODIFY_REG(REG, CLEARMASK, SETMASK) \
+  WRITE_REG((REG), (((READ_REG(REG)) & (~(CLEARMASK))) | (SETMASK)))
+
+extern uint32_t SystemCoreClock;
+
+// ----------------------------------------------------------------------------
+// HAL
+
+extern "C"
+{
+  typedef enum
+  {
+    HAL_OK = 0x00U, HAL_ERROR = 0x01U, HAL_BUSY = 0x02U, HAL_TIMEOUT = 0x03U
+  } HAL_StatusTypeDef;
+
+  typedef enum
+  {
+    HAL_UNLOCKED = 0x00U, HAL_LOCKED = 0x01U
+  } HAL_LockTypeDef;
+
+  typedef enum
+  {
+    HAL_DMA_STATE_RESET = 0x00U,
+    HAL_DMA_STATE_READY = 0x01U,
+    HAL_DMA_STATE_BUSY = 0x02U
+  } HAL_DMA_StateTypeDef;
+
+  typedef struct
+  {
+    uint32_t Channel;
+    uint32_t Direction;
+    uint32_t PeriphInc;
+    uint32_t MemInc;
+    uint32_t PeriphDataAlignment;
+    uint32_t MemDataAlignment;
+    uint32_t Mode;
+    uint32_t Priority;
+  } DMA_InitTypeDef;
+
+#define DMA_NORMAL 0x00000000U
+#define DMA_CIRCULAR DMA_SxCR_CIRC
+#define DMA_PDATAALIGN_BYTE 0x00000000U
+#define DMA_PDATAALIGN_HALFWORD DMA_SxCR_PSIZE_0
+#define DMA_MDATAALIGN_BYTE 0x00000000U
+#define DMA_MDATAALIGN_HALFWORD DMA_SxCR_MSIZE_0
+
+  typedef struct __DMA_HandleTypeDef
+  {
+    DMA_Stream_TypeDef* Instance;
+    DMA_InitTypeDef Init;
+    HAL_LockTypeDef Lock;
+    volatile HAL_DMA_StateTypeDef State;
+    void* Parent;
+    void
+    (*XferCpltCallback) (struct __DMA_HandleTypeDef* hdma);
+    void
+    (*XferHalfCpltCallback) (struct __DMA_HandleTypeDef* hdma);
+    void
+    (*XferM1CpltCallback) (struct __DMA_HandleTypeDef* hdma);
+    void
+    (*XferM1HalfCpltCallback) (struct __DMA_HandleTypeDef* hdma);
+    void
+    (*XferErrorCallback) (struct __DMA_HandleTypeDef* hdma);
+    void
+    (*XferAbortCallback) (struct __DMA_HandleTypeDef* hdma);
+    volatile uint32_t ErrorCode;
+  } DMA_HandleTypeDef;
+
+  typedef struct
+  {
+    uint32_t BaudRate;
+    uint32_t WordLength;
+    uint32_t StopBits;
+    uint32_t Parity;
+    uint32_t Mode;
+    uint32_t HwFlowCtl;
+    uint32_t OverSampling;
+    uint32_t OneBitSampling;
+  } UART_InitTypeDef;
+
+  typedef struct
+  {
+    uint32_t AdvFeatureInit;
+  } UART_AdvFeatureInitTypeDef;
+
+  typedef uint32_t HAL_UART_StateTypeDef;
+
+#define HAL_UART_STATE_RESET 0x00000000U
+#define HAL_UART_STATE_READY 0x00000020U
+#define HAL_UART_STATE_BUSY 0x00000024U
+#define HAL_UART_STATE_BUSY_TX 0x00000021U
+#define HAL_UART_STATE_BUSY_RX 0x00000022U
+#define HAL_UART_STATE_BUSY_TX_RX 0x00000023U
+#define HAL_UART_STATE_ERROR 0x000000E0U
+
+#define HAL_UART_ERROR_NONE 0x00000000U
+#define HAL_UART_ERROR_PE 0x00000001U
+#define HAL_UART_ERROR_NE 0x00000002U
+#define HAL_UART_ERROR_FE 0x00000004U
+#define HAL_UART_ERROR_ORE 0x00000008U
+#define HAL_UART_ERROR_DMA 0x00000010U
+#define HAL_UART_ERROR_RTO 0x00000020U
+
+  typedef struct __UART_HandleTypeDef
+  {
+    USART_TypeDef* Instance;
+    UART_InitTypeDef Init;
+    UART_AdvFeatureInitTypeDef AdvancedInit;
+    uint8_t* pTxBuffPtr;
+    uint16_t TxXferSize;
+    volatile uint16_t TxXferCount;
+    uint8_t* pRxBuffPtr;
+    uint16_t RxXferSize;
+    volatile uint16_t RxXferCount;
+    uint16_t Mask;
+    DMA_HandleTypeDef* hdmatx;
+    DMA_HandleTypeDef* hdmarx;
+    HAL_LockTypeDef Lock;
+    volatile HAL_UART_StateTypeDef gState;
+    volatile HAL_UART_StateTypeDef RxState;
+    volatile uint32_t ErrorCode;
+  } UART_HandleTypeDef;
+
+#define UART_WORDLENGTH_7B USART_CR1_M1
+#define UART_WORDLENGTH_8B 0x00000000U
+#define UART_WORDLENGTH_9B USART_CR1_M0
+
+#define UART_STOPBITS_0_5 (1U << USART_CR2_STOP_Pos)
+#define UART_STOPBITS_1 0x00000000U
+#define UART_STOPBITS_1_5 (3U << USART_CR2_STOP_Pos)
+#define UART_STOPBITS_2 (2U << USART_CR2_STOP_Pos)
+
+#define UART_PARITY_NONE 0x00000000U
+#define UART_PARITY_EVEN USART_CR1_PCE
+#define UART_PARITY_ODD (USART_CR1_PCE | USART_CR1_PS)
+
+#define UART_HWCONTROL_NONE 0x00000000U
+#define UART_HWCONTROL_RTS USART_CR3_RTSE
+#define UART_HWCONTROL_CTS USART_CR3_CTSE
+#define UART_HWCONTROL_RTS_CTS (USART_CR3_RTSE | USART_CR3_CTSE)
+
+#define UART_MODE_RX USART_CR1_RE
+#define UART_MODE_TX USART_CR1_TE
+#define UART_MODE_TX_RX (USART_CR1_TE | USART_CR1_RE)
+
+#define UART_OVERSAMPLING_16 0x00000000U
+#define UART_OVERSAMPLING_8 USART_CR1_OVER8
+
+#define UART_ONE_BIT_SAMPLE_DISABLE 0x00000000U
+#define UART_ADVFEATURE_NO_INIT 0x00000000U
+
+#define UART_DE_POLARITY_HIGH 0x00000000U
+#define UART_DE_POLARITY_LOW USART_CR3_DEP
+
+#define UART_SENDBREAK_REQUEST USART_RQR_SBKRQ
+#define UART_RXDATA_FLUSH_REQUEST USART_RQR_RXFRQ
+
+#define UART_FLAG_SBKF USART_ISR_SBKF
+#define UART_FLAG_CMF USART_ISR_CMF
+#define UART_FLAG_BUSY USART_ISR_BUSY
+#define UART_FLAG_RTOF USART_ISR_RTOF
+#define UART_FLAG_TXE USART_ISR_TXE
+#define UART_FLAG_TC USART_ISR_TC
+#define UART_FLAG_RXNE USART_ISR_RXNE
+#define UART_FLAG_IDLE USART_ISR_IDLE
+#define UART_FLAG_ORE USART_ISR_ORE
+#define UART_FLAG_NE USART_ISR_NE
+#define UART_FLAG_FE USART_ISR_FE
+#define UART_FLAG_PE USART_ISR_PE
+
+#define UART_CLEAR_PEF USART_ICR_PECF
+#define UART_CLEAR_FEF USART_ICR_FECF
+#define UART_CLEAR_NEF USART_ICR_NCF
+#define UART_CLEAR_OREF USART_ICR_ORECF
+#define UART_CLEAR_IDLEF USART_ICR_IDLECF
+#define UART_CLEAR_TCF USART_ICR_TCCF
+#define UART_CLEAR_RTOF USART_ICR_RTOCF
+#define UART_CLEAR_CMF USART_ICR_CMCF
+
+  // interrupt encoding as in the ST HAL: bits 7:5 register (1 = CR1,
+  // 2 = CR2, 3 = CR3), bits 4:0 bit position
+#define UART_IT_MASK 0x001FU
+#define UART_IT_PE 0x0028U
+#define UART_IT_TXE 0x0727U
+#define UART_IT_TC 0x0626U
+#define UART_IT_RXNE 0x0525U
+#define UART_IT_IDLE 0x0424U
+#define UART_IT_CM 0x112EU
+#define UART_IT_RTO 0x0B3AU
+#define UART_IT_ERR 0x0060U
+
+  // clock of the baud rate generator, selected by RCC_DCKCFGR2.USARTxSEL
+  typedef enum
+  {
+    UART_CLOCKSOURCE_PCLK1 = 0x00U,
+    UART_CLOCKSOURCE_PCLK2 = 0x01U,
+    UART_CLOCKSOURCE_HSI = 0x02U,
+    UART_CLOCKSOURCE_SYSCLK = 0x04U,
+    UART_CLOCKSOURCE_LSE = 0x08U,
+    UART_CLOCKSOURCE_UNDEFINED = 0x10U
+  } UART_ClockSourceTypeDef;
+
+#define HSI_VALUE 16000000U
+#define LSE_VALUE 32768U
+
+  UART_ClockSourceTypeDef
+  sim_uart_clock_source (USART_TypeDef* usart);
+
+#define UART_GETCLOCKSOURCE(__HANDLE__, __CLOCKSOURCE__) \
+  ((__CLOCKSOURCE__) = sim_uart_clock_source ((__HANDLE__)->Instance))
+
+#define __HAL_UART_ENABLE(__HANDLE__) \
+  ((__HANDLE__)->Instance->CR1 |= USART_CR1_UE)
+#define __HAL_UART_DISABLE(__HANDLE__) \
+  ((__HANDLE__)->Instance->CR1 &= ~USART_CR1_UE)
+
+#define __HAL_UART_ENABLE_IT(__HANDLE__, __INTERRUPT__) \
+  (((((uint8_t)(__INTERRUPT__)) >> 5U) == 1U) ? \
+    ((__HANDLE__)->Instance->CR1 |= (1U << ((__INTERRUPT__) & UART_IT_MASK))) : \
+   ((((uint8_t)(__INTERRUPT__)) >> 5U) == 2U) ? \
+    ((__HANDLE__)->Instance->CR2 |= (1U << ((__INTERRUPT__) & UART_IT_MASK))) : \
+    ((__HANDLE__)->Instance->CR3 |= (1U << ((__INTERRUPT__) & UART_IT_MASK))))
+
+#define __HAL_UART_DISABLE_IT(__HANDLE__, __INTERRUPT__) \
+  (((((uint8_t)(__INTERRUPT__)) >> 5U) == 1U) ? \
+    ((__HANDLE__)->Instance->CR1 &= ~(1U << ((__INTERRUPT__) & UART_IT_MASK))) : \
+   ((((uint8_t)(__INTERRUPT__)) >> 5U) == 2U) ? \
+    ((__HANDLE__)->Instance->CR2 &= ~(1U << ((__INTERRUPT__) & UART_IT_MASK))) : \
+    ((__HANDLE__)->Instance->CR3 &= ~(1U << ((__INTERRUPT__) & UART_IT_MASK))))
+
+#define __HAL_UART_GET_IT_SOURCE(__HANDLE__, __INTERRUPT__) \
+  ((((((uint8_t)(__INTERRUPT__)) >> 5U) == 1U) ? (__HANDLE__)->Instance->CR1 : \
+    ((((uint8_t)(__INTERRUPT__)) >> 5U) == 2U) ? (__HANDLE__)->Instance->CR2 : \
+    (__HANDLE__)->Instance->CR3) & (1U << ((__INTERRUPT__) & UART_IT_MASK)))
+
+#define __HAL_UART_GET_FLAG(__HANDLE__, __FLAG__) \
+  (((__HANDLE__)->Instance->ISR & (__FLAG__)) == (__FLAG__))
+#define __HAL_UART_CLEAR_FLAG(__HANDLE__, __FLAG__) \
+  ((__HANDLE__)->Instance->ICR = (__FLAG__))
+#define __HAL_UART_CLEAR_IDLEFLAG(__HANDLE__) \
+  __HAL_UART_CLEAR_FLAG((__HANDLE__), UART_CLEAR_IDLEF)
+#define __HAL_UART_SEND_REQ(__HANDLE__, __REQ__) \
+  ((__HANDLE__)->Instance->RQR = (__REQ__))
+
+#define __HAL_LINKDMA(__HANDLE__, __PPP_DMA_FIELD__, __DMA_HANDLE__) \
+  do { \
+    (__HANDLE__)->__PPP_DMA_FIELD__ = &(__DMA_HANDLE__); \
+    (__DMA_HANDLE__).Parent = (__HANDLE__); \
+  } while (0)
+
+#define UART_MASK_COMPUTATION(__HANDLE__) \
+  do { \
+    if ((__HANDLE__)->Init.WordLength == UART_WORDLENGTH_9B) \
+      { \
+        (__HANDLE__)->Mask = \
+          ((__HANDLE__)->Init.Parity == UART_PARITY_NONE) ? 0x01FFU : 0x00FFU; \
+      } \
+    else if ((__HANDLE__)->Init.WordLength == UART_WORDLENGTH_8B) \
+      { \
+        (__HANDLE__)->Mask = \
+          ((__HANDLE__)->Init.Parity == UART_PARITY_NONE) ? 0x00FFU : 0x007FU; \
+      } \
+    else \
+      { \
+        (__HANDLE__)->Mask = \
+          ((__HANDLE__)->Init.Parity == UART_PARITY_NONE) ? 0x007FU : 0x003FU; \
+      } \
+  } while (0)
+
+  HAL_StatusTypeDef
+  HAL_DMA_Init (DMA_HandleTypeDef* hdma);
+
+  HAL_StatusTypeDef
+  HAL_DMA_Start_IT (DMA_HandleTypeDef* hdma, uint32_t SrcAddress,
+                    uint32_t DstAddress, uint32_t DataLength);
+
+  HAL_StatusTypeDef
+  HAL_UART_Init (UART_HandleTypeDef* huart);
+
+  HAL_StatusTypeDef
+  HAL_RS485Ex_Init (UART_HandleTypeDef* huart, uint32_t Polarity,
+                    uint32_t AssertionTime, uint32_t DeassertionTime);
+
+  HAL_StatusTypeDef
+  HAL_UART_DeInit (UART_HandleTypeDef* huart);
+
+  HAL_StatusTypeDef
+  UART_SetConfig (UART_HandleTypeDef* huart);
+
+  HAL_StatusTypeDef
+  HAL_UART_Transmit_IT (UART_HandleTypeDef* huart, uint8_t* pData,
+                        uint16_t Size);
+
+  HAL_StatusTypeDef
+  HAL_UART_Receive_IT (UART_HandleTypeDef* huart, uint8_t* pData,
+                       uint16_t Size);
+
+  HAL_StatusTypeDef
+  HAL_UART_Transmit_DMA (UART_HandleTypeDef* huart, uint8_t* pData,
+                         uint16_t Size);
+
+  HAL_StatusTypeDef
+  HAL_UART_Receive_DMA (UART_HandleTypeDef* huart, uint8_t* pData,
+                        uint16_t Size);
+
+  HAL_StatusTypeDef
+  HAL_UART_DMAStop (UART_HandleTypeDef* huart);
+
+  HAL_StatusTypeDef
+  HAL_UART_Abort (UART_HandleTypeDef* huart);
+
+  HAL_StatusTypeDef
+  HAL_UART_AbortTransmit (UART_HandleTypeDef* huart);
+
+  HAL_StatusTypeDef
+  HAL_UART_AbortReceive (UART_HandleTypeDef* huart);
+
+  void
+  HAL_UART_IRQHandler (UART_HandleTypeDef* huart);
+
+  void
+  HAL_UART_TxCpltCallback (UART_HandleTypeDef* huart);
+
+  void
+  HAL_UART_TxHalfCpltCallback (UART_HandleTypeDef* huart);
+
+  void
+  HAL_UART_RxCpltCallback (UART_HandleTypeDef* huart);
+
+  void
+  HAL_UART_RxHalfCpltCallback (UART_HandleTypeDef* huart);
+
+  void
+  HAL_UART_ErrorCallback (UART_HandleTypeDef* huart);
+
+  uint32_t
+  HAL_RCC_GetPCLK1Freq (void);
+
+  uint32_t
+  HAL_RCC_GetPCLK2Freq (void);
+
+  uint32_t
+  HAL_RCC_GetSysClockFreq (void);
+
+  uint32_t
+  HAL_GetTick (void);
+
+  void
+  SCB_CleanDCache_by_Addr (uint32_t* addr, int32_t dsize);
+
+  void
+  SCB_InvalidateDCache_by_Addr (uint32_t* addr, int32_t dsize);
+
+  void
+  SCB_CleanInvalidateDCache_by_Addr (uint32_t* addr, int32_t dsize);
+}
+
+#endif /* SIM_STM32F7XX_HAL_H_ */
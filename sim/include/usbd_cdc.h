@@ -0,0 +1,90 @@
+/*
+ * usbd_cdc.h
+ *
+ * Copyright (c) 2026 Lix N. Paulian (lix@paulian.net)
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom
+ * the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Created on: 16 Oct 2026 (LNP)
+ *
+ * Host simulation of the subset of the ST USB device library (core and CDC
+ * class) used by the CDC driver.
+ */
+
+#ifndef SIM_USBD_CDC_H_
+#define SIM_USBD_CDC_H_
+
+#include <stdint.h>
+
+#define DEVICE_FS 0
+#define DEVICE_HS 1
+
+#define USB_HS_MAX_PACKET_SIZE 512U
+#define USB_FS_MAX_PACKET_SIZE 64U
+
+extern "C"
+{
+  typedef enum
+  {
+    USBD_OK = 0U, USBD_BUSY, USBD_FAIL
+  } USBD_StatusTypeDef;
+
+  typedef enum
+  {
+    USBD_SPEED_HIGH = 0U, USBD_SPEED_FULL = 1U, USBD_SPEED_LOW = 2U
+  } USBD_SpeedTypeDef;
+
+  typedef struct
+  {
+    uint8_t* RxBuffer;
+    uint8_t* TxBuffer;
+    uint32_t RxLength;
+    uint32_t TxLength;
+    volatile uint32_t TxState;
+    volatile uint32_t RxState;
+  } USBD_CDC_HandleTypeDef;
+
+  typedef struct _USBD_HandleTypeDef
+  {
+    uint8_t id;
+    USBD_SpeedTypeDef dev_speed;
+    void* pClassData;
+  } USBD_HandleTypeDef;
+
+  uint8_t
+  USBD_CDC_SetTxBuffer (USBD_HandleTypeDef* pdev, uint8_t* pbuff,
+                        uint32_t length);
+
+  uint8_t
+  USBD_CDC_SetRxBuffer (USBD_HandleTypeDef* pdev, uint8_t* pbuff);
+
+  uint8_t
+  USBD_CDC_ReceivePacket (USBD_HandleTypeDef* pdev);
+
+  uint8_t
+  USBD_CDC_TransmitPacket (USBD_HandleTypeDef* pdev);
+
+  USBD_StatusTypeDef
+  USBD_DeInit (USBD_HandleTypeDef* pdev);
+}
+
+#endif /* SIM_USBD_CDC_H_ */
@@ -0,0 +1,1667 @@
+/*
+ * sim-hal-uart.cpp
+ *
+ * Copyright (c) 2026 Lix N. Paulian (lix@paulian.net)
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom
+ * the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Created on: 16 Oct 2026 (LNP)
+ *
+ * Host model of the STM32F7 USART and DMA streams, the subset of the UART
+ * HAL on top of them and the peripheral thread that plays the role of the
+ * interrupt context.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <thread>
+
+#include <cmsis-plus/rtos/os.h>
+
+#include "sim-uart.h"
+#include "sim-internal.h"
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+
+// ----------------------------------------------------------------------------
+// Registers
+
+USART_TypeDef sim_usart_instances[8];
+DMA_Stream_TypeDef sim_dma_streams[16];
+SCB_Type sim_scb;
+DWT_Type sim_dwt;
+CoreDebug_Type sim_core_debug;
+
+uint32_t SystemCoreClock = 216000000;
+
+namespace
+{
+  enum
+  {
+    reg_rqr, reg_icr, reg_rdr, reg_tdr
+  };
+
+  // a character on the wire: data in bits 0-8, break in bit 9 and the
+  // error flags (SIM_CHAR_xx) in bits 16 and up; idle gaps have bit 15 set.
+  constexpr uint32_t char_break = 1U << 9;
+  constexpr uint32_t char_idle = 1U << 15;
+  constexpr uint32_t char_flags = SIM_CHAR_PE | SIM_CHAR_FE | SIM_CHAR_NE
+      | SIM_CHAR_ORE;
+  constexpr uint32_t char_flags_pos = 16;
+
+  struct dma_state
+  {
+    uintptr_t base;
+    uint32_t size;
+
+    // transfer interrupts waiting for the modelled latency
+    uint32_t irq_countdown;
+    bool ht_pending;
+    bool tc_pending;
+  };
+
+  struct port
+  {
+    UART_HandleTypeDef* huart;
+    void
+    (*irq) (void);
+    void
+    (*tx_hook) (uint16_t c, void* arg);
+    void* tx_hook_arg;
+    bool loopback;
+    port* peer;
+    std::deque<uint32_t> wire;
+
+    // transmitter
+    uint16_t tdr;
+    bool tdr_full;
+    uint32_t shifter;
+    bool shifter_busy;
+    bool break_pending;
+
+    // receiver
+    uint16_t rdr;
+    bool rx_since_idle;
+    bool rto_armed;
+    uint32_t rto_bits;
+
+    uint64_t next_slot_ns;
+    sim_uart_stats stats;
+  };
+
+  port ports[8];
+  dma_state dma_states[16];
+
+  uint32_t dma_irq_latency = 0; // in character times
+
+  uint32_t pclk1 = 54000000;
+  uint32_t pclk2 = 108000000;
+
+  // the reset selection: the APB clock of each USART
+  UART_ClockSourceTypeDef clock_sources[8] =
+    { UART_CLOCKSOURCE_PCLK2, UART_CLOCKSOURCE_PCLK1, UART_CLOCKSOURCE_PCLK1,
+        UART_CLOCKSOURCE_PCLK1, UART_CLOCKSOURCE_PCLK1, UART_CLOCKSOURCE_PCLK2,
+        UART_CLOCKSOURCE_PCLK1, UART_CLOCKSOURCE_PCLK1 };
+
+  sim_cache_stats cache_stats;
+
+  std::thread engine;
+  std::atomic<bool> running
+    { false };
+
+  inline int
+  index_of (USART_TypeDef* usart)
+  {
+    return usart - sim_usart_instances;
+  }
+
+  inline port&
+  port_of (USART_TypeDef* usart)
+  {
+    return ports[index_of (usart)];
+  }
+
+  inline dma_state&
+  dma_of (DMA_Stream_TypeDef* stream)
+  {
+    return dma_states[stream - sim_dma_streams];
+  }
+
+  uint32_t
+  pclk_of (USART_TypeDef* usart)
+  {
+    switch (clock_sources[index_of (usart)])
+      {
+      case UART_CLOCKSOURCE_PCLK1:
+        return pclk1;
+      case UART_CLOCKSOURCE_PCLK2:
+        return pclk2;
+      case UART_CLOCKSOURCE_HSI:
+        return HSI_VALUE;
+      case UART_CLOCKSOURCE_SYSCLK:
+        return SystemCoreClock;
+      case UART_CLOCKSOURCE_LSE:
+        return LSE_VALUE;
+      default:
+        return 0;
+      }
+  }
+
+  uint32_t
+  baud_of (USART_TypeDef* usart)
+  {
+    uint32_t brr = usart->BRR;
+    uint32_t pclk = pclk_of (usart);
+
+    if (brr == 0)
+      {
+        return 0;
+      }
+    if (usart->CR1 & USART_CR1_OVER8)
+      {
+        uint32_t usartdiv = (brr & 0xFFF0U) | ((brr & 0x7U) << 1);
+        return usartdiv ? (2ULL * pclk) / usartdiv : 0;
+      }
+    return pclk / brr;
+  }
+
+  uint32_t
+  bits_per_char (USART_TypeDef* usart)
+  {
+    uint32_t cr1 = usart->CR1;
+    uint32_t data = (cr1 & USART_CR1_M1) ? 7 : (cr1 & USART_CR1_M0) ? 9 : 8;
+    uint32_t stop = ((usart->CR2 & USART_CR2_STOP) == UART_STOPBITS_2
+        || (usart->CR2 & USART_CR2_STOP) == UART_STOPBITS_1_5) ? 2 : 1;
+
+    return 1 + data + stop;
+  }
+
+  uint32_t
+  data_mask (USART_TypeDef* usart)
+  {
+    uint32_t cr1 = usart->CR1;
+    return (cr1 & USART_CR1_M1) ? 0x7F : (cr1 & USART_CR1_M0) ? 0x1FF : 0xFF;
+  }
+
+  bool
+  dma_active (DMA_HandleTypeDef* hdma)
+  {
+    return hdma != nullptr && hdma->Instance != nullptr
+        && (hdma->Instance->CR & DMA_SxCR_EN) && hdma->Instance->NDTR > 0;
+  }
+
+  void
+  dma_start (DMA_HandleTypeDef* hdma, uint8_t* buff, uint16_t size)
+  {
+    DMA_Stream_TypeDef* stream = hdma->Instance;
+    dma_state& ds = dma_of (stream);
+
+    ds.base = (uintptr_t) buff;
+    ds.size = size;
+    stream->M0AR = (uintptr_t) buff;
+    stream->NDTR = size;
+    stream->CR = DMA_SxCR_EN | (hdma->Init.Mode & DMA_SxCR_CIRC)
+        | hdma->Init.PeriphDataAlignment | hdma->Init.MemDataAlignment;
+    hdma->State = HAL_DMA_STATE_BUSY;
+  }
+
+  void
+  dma_abort (DMA_HandleTypeDef* hdma)
+  {
+    if (hdma != nullptr && hdma->Instance != nullptr)
+      {
+        dma_state& ds = dma_of (hdma->Instance);
+
+        hdma->Instance->CR &= ~DMA_SxCR_EN;
+        hdma->State = HAL_DMA_STATE_READY;
+        ds.ht_pending = false;
+        ds.tc_pending = false;
+      }
+  }
+
+  void
+  dma_irq_fire (DMA_HandleTypeDef* hdma, dma_state& ds)
+  {
+    // like HAL_DMA_IRQHandler(), half transfer first
+    if (ds.ht_pending)
+      {
+        ds.ht_pending = false;
+        if (hdma->XferHalfCpltCallback != nullptr)
+          {
+            hdma->XferHalfCpltCallback (hdma);
+          }
+      }
+    if (ds.tc_pending)
+      {
+        ds.tc_pending = false;
+        if (hdma->XferCpltCallback != nullptr)
+          {
+            hdma->XferCpltCallback (hdma);
+          }
+      }
+  }
+
+  /**
+   * @brief Raise a transfer interrupt of a DMA stream, at once or after
+   *      the modelled latency (see dma_irq_service()).
+   */
+  void
+  dma_irq (DMA_HandleTypeDef* hdma, bool complete)
+  {
+    dma_state& ds = dma_of (hdma->Instance);
+
+    if (!ds.ht_pending && !ds.tc_pending)
+      {
+        ds.irq_countdown = dma_irq_latency;
+      }
+    (complete ? ds.tc_pending : ds.ht_pending) = true;
+    if (dma_irq_latency == 0)
+      {
+        dma_irq_fire (hdma, ds);
+      }
+  }
+
+  /**
+   * @brief Count down a character time for the pending transfer
+   *      interrupts of a DMA stream and run them when due.
+   */
+  void
+  dma_irq_service (DMA_HandleTypeDef* hdma)
+  {
+    if (hdma == nullptr || hdma->Instance == nullptr)
+      {
+        return;
+      }
+
+    dma_state& ds = dma_of (hdma->Instance);
+    if ((ds.ht_pending || ds.tc_pending) && --ds.irq_countdown == 0)
+      {
+        dma_irq_fire (hdma, ds);
+      }
+  }
+
+  /**
+   * @brief Return the memory address the next item of a DMA stream goes
+   *      to/comes from: bytes, or 16 bit words (MSIZE). The caller moves
+   *      the data, then advances the stream (see dma_done()).
+   */
+  uint8_t*
+  dma_next (DMA_HandleTypeDef* hdma)
+  {
+    DMA_Stream_TypeDef* stream = hdma->Instance;
+    dma_state& ds = dma_of (stream);
+    uint32_t ndtr = stream->NDTR;
+    uint32_t shift = (stream->CR & DMA_SxCR_MSIZE_0) ? 1 : 0;
+
+    return (uint8_t*) ds.base + ((ds.size - ndtr) << shift);
+  }
+
+  void
+  dma_store (DMA_HandleTypeDef* hdma, uint16_t data)
+  {
+    uint8_t* item = dma_next (hdma);
+
+    if (hdma->Instance->CR & DMA_SxCR_MSIZE_0)
+      {
+        *(uint16_t*) item = data;
+      }
+    else
+      {
+        *item = (uint8_t) data;
+      }
+  }
+
+  uint16_t
+  dma_load (DMA_HandleTypeDef* hdma)
+  {
+    uint8_t* item = dma_next (hdma);
+
+    return (hdma->Instance->CR & DMA_SxCR_MSIZE_0) ?
+        *(uint16_t*) item : *item;
+  }
+
+  void
+  dma_done (DMA_HandleTypeDef* hdma)
+  {
+    DMA_Stream_TypeDef* stream = hdma->Instance;
+    dma_state& ds = dma_of (stream);
+    uint32_t ndtr = stream->NDTR - 1;
+
+    if (ndtr == 0)
+      {
+        if (stream->CR & DMA_SxCR_CIRC)
+          {
+            ndtr = ds.size;
+          }
+        else
+          {
+            stream->CR &= ~DMA_SxCR_EN;
+            hdma->State = HAL_DMA_STATE_READY;
+          }
+        stream->NDTR = ndtr;
+        dma_irq (hdma, true);
+      }
+    else
+      {
+        stream->NDTR = ndtr;
+        if (ndtr == ds.size / 2)
+          {
+            dma_irq (hdma, false);
+          }
+      }
+  }
+
+  void
+  deliver (port& p, uint32_t c)
+  {
+    p.stats.tx_chars++;
+    if (p.tx_hook != nullptr)
+      {
+        p.tx_hook ((c & char_break) ? 0x100 : (c & 0x1FF), p.tx_hook_arg);
+      }
+    if (p.loopback)
+      {
+        p.wire.push_back (c);
+      }
+    if (p.peer != nullptr)
+      {
+        p.peer->wire.push_back (c);
+      }
+  }
+
+  void
+  transmit_slot (USART_TypeDef* usart, port& p)
+  {
+    UART_HandleTypeDef* huart = p.huart;
+
+    if (p.shifter_busy)
+      {
+        deliver (p, p.shifter);
+        p.shifter_busy = false;
+      }
+
+    if (p.break_pending)
+      {
+        p.shifter = char_break;
+        p.shifter_busy = true;
+        p.break_pending = false;
+        usart->ISR &= ~USART_ISR_SBKF;
+      }
+    else if (p.tdr_full)
+      {
+        p.shifter = p.tdr;
+        p.shifter_busy = true;
+        p.tdr_full = false;
+        usart->ISR |= USART_ISR_TXE;
+      }
+    else if ((usart->CR3 & USART_CR3_DMAT) && huart != nullptr
+        && dma_active (huart->hdmatx))
+      {
+        p.shifter = dma_load (huart->hdmatx);
+        p.shifter_busy = true;
+        usart->ISR &= ~USART_ISR_TC;
+        dma_done (huart->hdmatx);
+      }
+    else if (!(usart->ISR & USART_ISR_TC))
+      {
+        // nothing left to send: transmission complete
+        usart->ISR |= USART_ISR_TC | USART_ISR_TXE;
+      }
+
+    if (!p.shifter_busy && (usart->CR2 & USART_CR2_TXINV))
+      {
+        // the idle level is inverted: TxD is held low, a break per slot
+        deliver (p, char_break);
+      }
+  }
+
+  void
+  receive_char (USART_TypeDef* usart, port& p, uint32_t c)
+  {
+    UART_HandleTypeDef* huart = p.huart;
+    uint16_t data = (c & char_break) ? 0 : (c & data_mask (usart));
+
+    p.stats.rx_chars++;
+    usart->ISR |= ((c >> char_flags_pos) & char_flags)
+        | ((c & char_break) ? USART_ISR_FE : 0);
+
+    if (((usart->CR2 & USART_CR2_ADD) >> USART_CR2_ADD_Pos) == (data & 0xFF))
+      {
+        usart->ISR |= USART_ISR_CMF;
+      }
+
+    if ((usart->CR3 & USART_CR3_DMAR) && huart != nullptr
+        && dma_active (huart->hdmarx))
+      {
+        dma_store (huart->hdmarx, data);
+        dma_done (huart->hdmarx);
+      }
+    else if (usart->ISR & USART_ISR_RXNE)
+      {
+        usart->ISR |= USART_ISR_ORE;
+        p.stats.rx_overruns++;
+      }
+    else
+      {
+        p.rdr = data;
+        usart->ISR |= USART_ISR_RXNE;
+      }
+
+    p.rx_since_idle = true;
+    p.rto_armed = true;
+    p.rto_bits = 0;
+  }
+
+  void
+  receive_slot (USART_TypeDef* usart, port& p)
+  {
+    UART_HandleTypeDef* huart = p.huart;
+
+    if ((usart->ISR & USART_ISR_RXNE) && (usart->CR3 & USART_CR3_DMAR)
+        && huart != nullptr && dma_active (huart->hdmarx))
+      {
+        // a DMA armed while RDR was full takes the character at once
+        dma_store (huart->hdmarx, p.rdr);
+        usart->ISR &= ~USART_ISR_RXNE;
+        dma_done (huart->hdmarx);
+      }
+
+    // with RTS flow control, RTS is deasserted while RDR is full: the
+    // sender holds the next character, the line is idle meanwhile
+    bool held = (usart->CR3 & USART_CR3_RTSE)
+        && (usart->ISR & USART_ISR_RXNE);
+
+    if (!held && !p.wire.empty () && !(p.wire.front () & char_idle))
+      {
+        uint32_t c = p.wire.front ();
+        p.wire.pop_front ();
+        if (usart->CR1 & USART_CR1_RE)
+          {
+            receive_char (usart, p, c);
+          }
+        return;
+      }
+
+    if (!held && !p.wire.empty ())
+      {
+        // explicit idle character time
+        p.wire.pop_front ();
+      }
+
+    if (p.rx_since_idle)
+      {
+        usart->ISR |= USART_ISR_IDLE;
+        p.rx_since_idle = false;
+      }
+
+    if ((usart->CR2 & USART_CR2_RTOEN) && p.rto_armed)
+      {
+        p.rto_bits += bits_per_char (usart);
+        if (p.rto_bits >= (usart->RTOR & USART_RTOR_RTO))
+          {
+            usart->ISR |= USART_ISR_RTOF;
+            p.rto_armed = false;
+          }
+      }
+  }
+
+  uint32_t
+  enabled_irqs (USART_TypeDef* usart)
+  {
+    uint32_t cr1 = usart->CR1;
+    uint32_t cr3 = usart->CR3;
+    uint32_t en = 0;
+
+    en |= (cr1 & USART_CR1_IDLEIE) ? USART_ISR_IDLE : 0;
+    en |= (cr1 & USART_CR1_RXNEIE) ? (USART_ISR_RXNE | USART_ISR_ORE) : 0;
+    en |= (cr1 & USART_CR1_TCIE) ? USART_ISR_TC : 0;
+    en |= (cr1 & USART_CR1_TXEIE) ? USART_ISR_TXE : 0;
+    en |= (cr1 & USART_CR1_PEIE) ? USART_ISR_PE : 0;
+    en |= (cr1 & USART_CR1_CMIE) ? USART_ISR_CMF : 0;
+    en |= (cr1 & USART_CR1_RTOIE) ? USART_ISR_RTOF : 0;
+    en |= (cr3 & USART_CR3_EIE) ?
+        (USART_ISR_FE | USART_ISR_NE | USART_ISR_ORE) : 0;
+
+    return en;
+  }
+
+  void
+  default_irq (UART_HandleTypeDef* huart)
+  {
+    if (__HAL_UART_GET_FLAG (huart, UART_FLAG_RTOF))
+      {
+        HAL_UART_RxCpltCallback (huart);
+      }
+    HAL_UART_IRQHandler (huart);
+    if (__HAL_UART_GET_FLAG (huart, UART_FLAG_IDLE))
+      {
+        __HAL_UART_CLEAR_IDLEFLAG (huart);
+        HAL_UART_RxCpltCallback (huart);
+      }
+    else if (__HAL_UART_GET_FLAG (huart, UART_FLAG_CMF)
+        && __HAL_UART_GET_IT_SOURCE (huart, UART_IT_CM))
+      {
+        HAL_UART_RxCpltCallback (huart);
+      }
+  }
+
+  void
+  slot (USART_TypeDef* usart, port& p)
+  {
+    transmit_slot (usart, p);
+    receive_slot (usart, p);
+    if (p.huart != nullptr)
+      {
+        dma_irq_service (p.huart->hdmarx);
+        dma_irq_service (p.huart->hdmatx);
+      }
+
+    // like the NVIC, re-enter the vector as long as an enabled flag is
+    // pending (the HAL services a single event per call); bounded, in case
+    // a handler leaves a flag set
+    for (int i = 0;
+        i < 4 && (usart->ISR & enabled_irqs (usart)) && p.huart != nullptr;
+        i++)
+      {
+        p.stats.irqs++;
+        if (p.irq != nullptr)
+          {
+            p.irq ();
+          }
+        else
+          {
+            default_irq (p.huart);
+          }
+      }
+
+    // a transfer is going on (e.g. it was chained by the handler) but the
+    // shifter got nothing to send in this slot: the line idles
+    if (!p.shifter_busy && p.huart != nullptr
+        && p.huart->gState == HAL_UART_STATE_BUSY_TX)
+      {
+        p.stats.tx_stall_slots++;
+      }
+  }
+
+  void
+  service (uint64_t now)
+  {
+    // do not let a stalled host turn into a burst of thousands of ISRs
+    constexpr uint32_t max_slots = 8192;
+
+    for (int i = 0; i < 8; i++)
+      {
+        USART_TypeDef* usart = &sim_usart_instances[i];
+        port& p = ports[i];
+        uint32_t baud = baud_of (usart);
+
+        if (!(usart->CR1 & USART_CR1_UE) || baud == 0)
+          {
+            p.next_slot_ns = now;
+            continue;
+          }
+
+        uint64_t char_ns = (1000000000ULL * bits_per_char (usart)) / baud;
+        uint32_t n = 0;
+        while (p.next_slot_ns <= now && n++ < max_slots)
+          {
+            slot (usart, p);
+            p.next_slot_ns += char_ns ? char_ns : 1;
+          }
+        if (p.next_slot_ns <= now)
+          {
+            p.stats.lag_slots += (now - p.next_slot_ns) / (char_ns + 1);
+            p.next_slot_ns = now;
+          }
+      }
+  }
+
+  void
+  run (void)
+  {
+    sim::set_handler_mode (true);
+    while (running)
+      {
+          {
+            std::lock_guard<std::recursive_mutex> lock
+              { sim::irq_mutex };
+            uint64_t now = sim::now_ns ();
+            service (now);
+            sim::usb_service (now);
+          }
+        std::this_thread::sleep_for (std::chrono::microseconds (20));
+      }
+  }
+
+  struct engine_guard
+  {
+    ~engine_guard ()
+    {
+      sim_stop ();
+    }
+  } guard;
+
+  void
+  register_port (UART_HandleTypeDef* huart)
+  {
+    port& p = port_of (huart->Instance);
+
+    sim_start ();
+    p.huart = huart;
+  }
+
+  void
+  end_rx_transfer (UART_HandleTypeDef* huart)
+  {
+    huart->Instance->CR1 &= ~(USART_CR1_RXNEIE | USART_CR1_PEIE);
+    huart->Instance->CR3 &= ~USART_CR3_EIE;
+    huart->RxState = HAL_UART_STATE_READY;
+  }
+
+  void
+  end_tx_transfer (UART_HandleTypeDef* huart)
+  {
+    huart->Instance->CR1 &= ~(USART_CR1_TXEIE | USART_CR1_TCIE);
+    huart->gState = HAL_UART_STATE_READY;
+  }
+
+  void
+  dma_transmit_cplt (DMA_HandleTypeDef* hdma)
+  {
+    UART_HandleTypeDef* huart = (UART_HandleTypeDef*) hdma->Parent;
+
+    if (hdma->Init.Mode != DMA_CIRCULAR)
+      {
+        huart->TxXferCount = 0;
+        huart->Instance->CR3 &= ~USART_CR3_DMAT;
+        huart->Instance->CR1 |= USART_CR1_TCIE;
+      }
+    else
+      {
+        HAL_UART_TxCpltCallback (huart);
+      }
+  }
+
+  void
+  dma_tx_half_cplt (DMA_HandleTypeDef* hdma)
+  {
+    HAL_UART_TxHalfCpltCallback ((UART_HandleTypeDef*) hdma->Parent);
+  }
+
+  void
+  dma_receive_cplt (DMA_HandleTypeDef* hdma)
+  {
+    UART_HandleTypeDef* huart = (UART_HandleTypeDef*) hdma->Parent;
+
+    if (hdma->Init.Mode != DMA_CIRCULAR)
+      {
+        huart->RxXferCount = 0;
+        huart->Instance->CR1 &= ~USART_CR1_PEIE;
+        huart->Instance->CR3 &= ~(USART_CR3_EIE | USART_CR3_DMAR);
+        huart->RxState = HAL_UART_STATE_READY;
+      }
+    HAL_UART_RxCpltCallback (huart);
+  }
+
+  void
+  dma_rx_half_cplt (DMA_HandleTypeDef* hdma)
+  {
+    HAL_UART_RxHalfCpltCallback ((UART_HandleTypeDef*) hdma->Parent);
+  }
+
+  /**
+   * @brief Tell if the transfers of a handle move 16 bit words: 9 data
+   *      bits, without parity.
+   */
+  bool
+  words_16 (UART_HandleTypeDef* huart)
+  {
+    return huart->Init.WordLength == UART_WORDLENGTH_9B
+        && huart->Init.Parity == UART_PARITY_NONE;
+  }
+
+  /**
+   * @brief Like the HAL, refuse a buffer of 16 bit words not aligned.
+   */
+  bool
+  misaligned (UART_HandleTypeDef* huart, const uint8_t* pData)
+  {
+    return words_16 (huart) && ((uintptr_t) pData & 1U) != 0;
+  }
+
+  void
+  rx_isr (UART_HandleTypeDef* huart)
+  {
+    uint16_t data = huart->Instance->RDR;
+
+    if (huart->RxState != HAL_UART_STATE_BUSY_RX)
+      {
+        return;
+      }
+
+    if (words_16 (huart))
+      {
+        // like UART_RxISR_16BIT()
+        *(uint16_t*) huart->pRxBuffPtr = data & huart->Mask;
+        huart->pRxBuffPtr += 2;
+      }
+    else
+      {
+        *huart->pRxBuffPtr++ = (uint8_t) (data & huart->Mask);
+      }
+    if (--huart->RxXferCount == 0)
+      {
+        end_rx_transfer (huart);
+        HAL_UART_RxCpltCallback (huart);
+      }
+  }
+
+  void
+  tx_isr (UART_HandleTypeDef* huart)
+  {
+    if (huart->TxXferCount == 0)
+      {
+        huart->Instance->CR1 &= ~USART_CR1_TXEIE;
+        huart->Instance->CR1 |= USART_CR1_TCIE;
+      }
+    else
+      {
+        if (words_16 (huart))
+          {
+            // like UART_TxISR_16BIT()
+            huart->Instance->TDR = *(const uint16_t*) huart->pTxBuffPtr
+                & 0x1FFU;
+            huart->pTxBuffPtr += 2;
+          }
+        else
+          {
+            huart->Instance->TDR = *huart->pTxBuffPtr++;
+          }
+        huart->TxXferCount--;
+      }
+  }
+
+} /* namespace */
+
+// ----------------------------------------------------------------------------
+// Registers with side effects
+
+sim_usart::sim_usart (void) :
+    RQR
+      { this, reg_rqr }, //
+    ICR
+      { this, reg_icr }, //
+    RDR
+      { this, reg_rdr }, //
+    TDR
+      { this, reg_tdr }
+{
+  ;
+}
+
+sim_usart_reg&
+sim_usart_reg::operator= (uint32_t value)
+{
+  std::lock_guard<std::recursive_mutex> lock
+    { sim::irq_mutex };
+  port& p = port_of (owner_);
+
+  switch (offset_)
+    {
+    case reg_rqr:
+      if (value & USART_RQR_SBKRQ)
+        {
+          owner_->ISR |= USART_ISR_SBKF;
+          p.break_pending = true;
+        }
+      if (value & USART_RQR_RXFRQ)
+        {
+          owner_->ISR &= ~USART_ISR_RXNE;
+        }
+      break;
+
+    case reg_icr:
+      owner_->ISR &= ~(value
+          & (USART_ICR_PECF | USART_ICR_FECF | USART_ICR_NCF | USART_ICR_ORECF
+              | USART_ICR_IDLECF | USART_ICR_TCCF | USART_ICR_RTOCF
+              | USART_ICR_CMCF));
+      break;
+
+    case reg_tdr:
+      p.tdr = value & 0x1FF;
+      p.tdr_full = true;
+      owner_->ISR &= ~(USART_ISR_TXE | USART_ISR_TC);
+      break;
+
+    default:
+      break;
+    }
+  return *this;
+}
+
+sim_usart_reg::operator uint32_t () const
+{
+  std::lock_guard<std::recursive_mutex> lock
+    { sim::irq_mutex };
+
+  if (offset_ == reg_rdr)
+    {
+      owner_->ISR &= ~USART_ISR_RXNE;
+      return port_of (owner_).rdr;
+    }
+  return 0;
+}
+
+sim_cyccnt&
+sim_cyccnt::operator= (uint32_t value)
+{
+  return *this;
+}
+
+sim_cyccnt::operator uint32_t () const
+{
+  return (uint32_t) ((sim::now_ns () * (SystemCoreClock / 1000000)) / 1000);
+}
+
+// ----------------------------------------------------------------------------
+// Cache maintenance
+
+namespace
+{
+  // cost model of the by-address maintenance: the CMSIS loop issues one
+  // DCCMVAC/DCIMVAC/DCCIMVAC per 32-byte line, followed by DSB and ISB.
+  // The time is really spent, so DWT->CYCCNT measurements see it.
+  constexpr uint32_t cache_cycles_per_line = 4;
+  constexpr uint32_t cache_cycles_barrier = 12;
+
+  void
+  cache_spend (int32_t dsize)
+  {
+    uint32_t lines = dsize > 0 ? (uint32_t) (dsize + 31) / 32 : 0;
+    uint64_t ns = ((uint64_t) lines * cache_cycles_per_line
+        + cache_cycles_barrier) * 1000 / (SystemCoreClock / 1000000);
+    uint64_t until = sim::now_ns () + ns;
+
+    while (sim::now_ns () < until)
+      ;
+  }
+}
+
+extern "C"
+{
+  void
+  SCB_CleanDCache_by_Addr (uint32_t* addr, int32_t dsize)
+  {
+    std::lock_guard<std::recursive_mutex> lock
+      { sim::irq_mutex };
+
+    cache_stats.clean_calls++;
+    cache_stats.clean_bytes += dsize;
+    cache_spend (dsize);
+  }
+
+  void
+  SCB_InvalidateDCache_by_Addr (uint32_t* addr, int32_t dsize)
+  {
+    std::lock_guard<std::recursive_mutex> lock
+      { sim::irq_mutex };
+
+    cache_stats.invalidate_calls++;
+    cache_stats.invalidate_bytes += dsize;
+    cache_spend (dsize);
+  }
+
+  void
+  SCB_CleanInvalidateDCache_by_Addr (uint32_t* addr, int32_t dsize)
+  {
+    std::lock_guard<std::recursive_mutex> lock
+      { sim::irq_mutex };
+
+    cache_stats.clean_calls++;
+    cache_stats.clean_bytes += dsize;
+    cache_stats.invalidate_calls++;
+    cache_stats.invalidate_bytes += dsize;
+    cache_spend (dsize);
+  }
+
+  uint32_t
+  HAL_RCC_GetPCLK1Freq (void)
+  {
+    return pclk1;
+  }
+
+  uint32_t
+  HAL_RCC_GetPCLK2Freq (void)
+  {
+    return pclk2;
+  }
+
+  uint32_t
+  HAL_RCC_GetSysClockFreq (void)
+  {
+    return SystemCoreClock;
+  }
+
+  UART_ClockSourceTypeDef
+  sim_uart_clock_source (USART_TypeDef* usart)
+  {
+    std::lock_guard<std::recursive_mutex> lock
+      { sim::irq_mutex };
+
+    return clock_sources[index_of (usart)];
+  }
+
+  uint32_t
+  HAL_GetTick (void)
+  {
+    return (uint32_t) (sim::now_ns () / 1000000);
+  }
+
+  // --------------------------------------------------------------------------
+  // UART HAL
+
+  HAL_StatusTypeDef
+  UART_SetConfig (UART_HandleTypeDef* huart)
+  {
+    USART_TypeDef* usart = huart->Instance;
+    uint32_t pclk = pclk_of (usart);
+    uint32_t baud = huart->Init.BaudRate;
+    uint32_t usartdiv;
+
+    MODIFY_REG(
+        usart->CR1,
+        USART_CR1_M | USART_CR1_PCE | USART_CR1_PS | USART_CR1_TE | USART_CR1_RE | USART_CR1_OVER8,
+        huart->Init.WordLength | huart->Init.Parity | huart->Init.Mode | huart->Init.OverSampling);
+    MODIFY_REG(usart->CR2, USART_CR2_STOP, huart->Init.StopBits);
+    MODIFY_REG(usart->CR3, USART_CR3_RTSE | USART_CR3_CTSE,
+               huart->Init.HwFlowCtl);
+
+    if (baud == 0)
+      {
+        return HAL_ERROR;
+      }
+
+    if (huart->Init.OverSampling == UART_OVERSAMPLING_8)
+      {
+        usartdiv = (2 * pclk + baud / 2) / baud;
+        if (usartdiv < 0x10 || usartdiv > 0xFFFF)
+          {
+            return HAL_ERROR;
+          }
+        usart->BRR = (usartdiv & 0xFFF0U) | ((usartdiv & 0x000FU) >> 1);
+      }
+    else
+      {
+        usartdiv = (pclk + baud / 2) / baud;
+        if (usartdiv < 0x10 || usartdiv > 0xFFFF)
+          {
+            return HAL_ERROR;
+          }
+        usart->BRR = usartdiv;
+      }
+
+    return HAL_OK;
+  }
+
+  HAL_StatusTypeDef
+  HAL_UART_Init (UART_HandleTypeDef* huart)
+  {
+    if (huart == nullptr || huart->Instance == nullptr)
+      {
+        return HAL_ERROR;
+      }
+
+    std::lock_guard<std::recursive_mutex> lock
+      { sim::irq_mutex };
+
+    register_port (huart);
+    huart->gState = HAL_UART_STATE_BUSY;
+    __HAL_UART_DISABLE(huart);
+    if (UART_SetConfig (huart) != HAL_OK)
+      {
+        return HAL_ERROR;
+      }
+    huart->Instance->ISR = USART_ISR_TXE | USART_ISR_TC;
+    __HAL_UART_ENABLE(huart);
+
+    huart->ErrorCode = HAL_UART_ERROR_NONE;
+    huart->gState = HAL_UART_STATE_READY;
+    huart->RxState = HAL_UART_STATE_READY;
+    huart->Lock = HAL_UNLOCKED;
+
+    return HAL_OK;
+  }
+
+  HAL_StatusTypeDef
+  HAL_RS485Ex_Init (UART_HandleTypeDef* huart, uint32_t Polarity,
+                    uint32_t AssertionTime, uint32_t DeassertionTime)
+  {
+    HAL_StatusTypeDef result;
+
+    std::lock_guard<std::recursive_mutex> lock
+      { sim::irq_mutex };
+
+    if ((result = HAL_UART_Init (huart)) == HAL_OK)
+      {
+        __HAL_UART_DISABLE(huart);
+        huart->Instance->CR3 |= USART_CR3_DEM;
+        MODIFY_REG(huart->Instance->CR3, USART_CR3_DEP, Polarity);
+        MODIFY_REG(huart->Instance->CR1, (0x3FFU << USART_CR1_DEDT_Pos),
+                   (AssertionTime << USART_CR1_DEAT_Pos) | (DeassertionTime << USART_CR1_DEDT_Pos));
+        __HAL_UART_ENABLE(huart);
+      }
+    return result;
+  }
+
+  HAL_StatusTypeDef
+  HAL_UART_DeInit (UART_HandleTypeDef* huart)
+  {
+    if (huart == nullptr || huart->Instance == nullptr)
+      {
+        return HAL_ERROR;
+      }
+
+    std::lock_guard<std::recursive_mutex> lock
+      { sim::irq_mutex };
+    port& p = port_of (huart->Instance);
+
+    huart->gState = HAL_UART_STATE_BUSY;
+    __HAL_UART_DISABLE(huart);
+    huart->Instance->CR1 = 0;
+    huart->Instance->CR2 = 0;
+    huart->Instance->CR3 = 0;
+    huart->Instance->ISR = 0;
+    p.tdr_full = false;
+    p.shifter_busy = false;
+    p.break_pending = false;
+
+    huart->ErrorCode = HAL_UART_ERROR_NONE;
+    huart->gState = HAL_UART_STATE_RESET;
+    huart->RxState = HAL_UART_STATE_RESET;
+
+    return HAL_OK;
+  }
+
+  HAL_StatusTypeDef
+  HAL_UART_Transmit_IT (UART_HandleTypeDef* huart, uint8_t* pData,
+                        uint16_t Size)
+  {
+    std::lock_guard<std::recursive_mutex> lock
+      { sim::irq_mutex };
+
+    if (huart->gState != HAL_UART_STATE_READY)
+      {
+        return HAL_BUSY;
+      }
+    if (pData == nullptr || Size == 0 || misaligned (huart, pData))
+      {
+        return HAL_ERROR;
+      }
+
+    huart->pTxBuffPtr = pData;
+    huart->TxXferSize = Size;
+    huart->TxXferCount = Size;
+    huart->ErrorCode = HAL_UART_ERROR_NONE;
+    huart->gState = HAL_UART_STATE_BUSY_TX;
+    huart->Instance->CR1 |= USART_CR1_TXEIE;
+
+    return HAL_OK;
+  }
+
+  HAL_StatusTypeDef
+  HAL_UART_Receive_IT (UART_HandleTypeDef* huart, uint8_t* pData,
+                       uint16_t Size)
+  {
+    std::lock_guard<std::recursive_mutex> lock
+      { sim::irq_mutex };
+
+    if (huart->RxState != HAL_UART_STATE_READY)
+      {
+        return HAL_BUSY;
+      }
+    if (pData == nullptr || Size == 0 || misaligned (huart, pData))
+      {
+        return HAL_ERROR;
+      }
+
+    huart->pRxBuffPtr = pData;
+    huart->RxXferSize = Size;
+    huart->RxXferCount = Size;
+    UART_MASK_COMPUTATION(huart);
+    huart->ErrorCode = HAL_UART_ERROR_NONE;
+    huart->RxState = HAL_UART_STATE_BUSY_RX;
+    huart->Instance->CR3 |= USART_CR3_EIE;
+    if (huart->Init.Parity != UART_PARITY_NONE)
+      {
+        huart->Instance->CR1 |= USART_CR1_PEIE;
+      }
+    huart->Instance->CR1 |= USART_CR1_RXNEIE;
+
+    return HAL_OK;
+  }
+
+  HAL_StatusTypeDef
+  HAL_UART_Transmit_DMA (UART_HandleTypeDef* huart, uint8_t* pData,
+                         uint16_t Size)
+  {
+    std::lock_guard<std::recursive_mutex> lock
+      { sim::irq_mutex };
+
+    if (huart->gState != HAL_UART_STATE_READY)
+      {
+        return HAL_BUSY;
+      }
+    if (pData == nullptr || Size == 0 || misaligned (huart, pData))
+      {
+        return HAL_ERROR;
+      }
+
+    huart->pTxBuffPtr = pData;
+    huart->TxXferSize = Size;
+    huart->TxXferCount = Size;
+    huart->ErrorCode = HAL_UART_ERROR_NONE;
+    huart->gState = HAL_UART_STATE_BUSY_TX;
+
+    huart->hdmatx->XferCpltCallback = dma_transmit_cplt;
+    huart->hdmatx->XferHalfCpltCallback = dma_tx_half_cplt;
+    dma_start (huart->hdmatx, pData, Size);
+
+    huart->Instance->ICR = USART_ICR_TCCF;
+    huart->Instance->CR3 |= USART_CR3_DMAT;
+
+    return HAL_OK;
+  }
+
+  HAL_StatusTypeDef
+  HAL_DMA_Init (DMA_HandleTypeDef* hdma)
+  {
+    std::lock_guard<std::recursive_mutex> lock
+      { sim::irq_mutex };
+
+    if (hdma == nullptr)
+      {
+        return HAL_ERROR;
+      }
+
+    // the data sizes and the mode are taken from Init at each start
+    dma_abort (hdma);
+    hdma->ErrorCode = 0;
+    hdma->State = HAL_DMA_STATE_READY;
+
+    return HAL_OK;
+  }
+
+  HAL_StatusTypeDef
+  HAL_DMA_Start_IT (DMA_HandleTypeDef* hdma, uint32_t SrcAddress,
+                    uint32_t DstAddress, uint32_t DataLength)
+  {
+    std::lock_guard<std::recursive_mutex> lock
+      { sim::irq_mutex };
+
+    if (hdma->State != HAL_DMA_STATE_READY)
+      {
+        return HAL_BUSY;
+      }
+
+    // the peripheral end (TDR or RDR) is implied by the stream; addresses
+    // have 32 bits on the target, the host pointer is the one of the handle
+    // (the caller sets pTxBuffPtr/pRxBuffPtr before, as the HAL does)
+    UART_HandleTypeDef* huart = (UART_HandleTypeDef*) hdma->Parent;
+    bool tx = huart != nullptr && huart->hdmatx == hdma;
+    uint8_t* buff = tx ? huart->pTxBuffPtr : huart->pRxBuffPtr;
+    if ((uint32_t) (uintptr_t) buff != (tx ? SrcAddress : DstAddress))
+      {
+        return HAL_ERROR;
+      }
+    dma_start (hdma, buff, DataLength);
+
+    return HAL_OK;
+  }
+
+  HAL_StatusTypeDef
+  HAL_UART_Receive_DMA (UART_HandleTypeDef* huart, uint8_t* pData,
+                        uint16_t Size)
+  {
+    std::lock_guard<std::recursive_mutex> lock
+      { sim::irq_mutex };
+
+    if (huart->RxState != HAL_UART_STATE_READY)
+      {
+        return HAL_BUSY;
+      }
+    if (pData == nullptr || Size == 0 || misaligned (huart, pData))
+      {
+        return HAL_ERROR;
+      }
+
+    huart->pRxBuffPtr = pData;
+    huart->RxXferSize = Size;
+    huart->ErrorCode = HAL_UART_ERROR_NONE;
+    huart->RxState = HAL_UART_STATE_BUSY_RX;
+
+    huart->hdmarx->XferCpltCallback = dma_receive_cplt;
+    huart->hdmarx->XferHalfCpltCallback = dma_rx_half_cplt;
+    dma_start (huart->hdmarx, pData, Size);
+
+    if (huart->Init.Parity != UART_PARITY_NONE)
+      {
+        huart->Instance->CR1 |= USART_CR1_PEIE;
+      }
+    huart->Instance->CR3 |= USART_CR3_EIE | USART_CR3_DMAR;
+
+    return HAL_OK;
+  }
+
+  HAL_StatusTypeDef
+  HAL_UART_DMAStop (UART_HandleTypeDef* huart)
+  {
+    std::lock_guard<std::recursive_mutex> lock
+      { sim::irq_mutex };
+
+    if ((huart->Instance->CR3 & USART_CR3_DMAT)
+        && huart->gState == HAL_UART_STATE_BUSY_TX)
+      {
+        huart->Instance->CR3 &= ~USART_CR3_DMAT;
+        dma_abort (huart->hdmatx);
+        end_tx_transfer (huart);
+      }
+
+    if ((huart->Instance->CR3 & USART_CR3_DMAR)
+        && huart->RxState == HAL_UART_STATE_BUSY_RX)
+      {
+        huart->Instance->CR3 &= ~USART_CR3_DMAR;
+        dma_abort (huart->hdmarx);
+        end_rx_transfer (huart);
+      }
+
+    return HAL_OK;
+  }
+
+  HAL_StatusTypeDef
+  HAL_UART_AbortTransmit (UART_HandleTypeDef* huart)
+  {
+    std::lock_guard<std::recursive_mutex> lock
+      { sim::irq_mutex };
+
+    if (huart->Instance->CR3 & USART_CR3_DMAT)
+      {
+        huart->Instance->CR3 &= ~USART_CR3_DMAT;
+        dma_abort (huart->hdmatx);
+      }
+    end_tx_transfer (huart);
+    huart->TxXferCount = 0;
+
+    return HAL_OK;
+  }
+
+  HAL_StatusTypeDef
+  HAL_UART_AbortReceive (UART_HandleTypeDef* huart)
+  {
+    std::lock_guard<std::recursive_mutex> lock
+      { sim::irq_mutex };
+
+    if (huart->Instance->CR3 & USART_CR3_DMAR)
+      {
+        huart->Instance->CR3 &= ~USART_CR3_DMAR;
+        dma_abort (huart->hdmarx);
+      }
+    end_rx_transfer (huart);
+    huart->RxXferCount = 0;
+    huart->Instance->ICR = UART_CLEAR_OREF | UART_CLEAR_NEF | UART_CLEAR_PEF
+        | UART_CLEAR_FEF;
+    huart->Instance->RQR = UART_RXDATA_FLUSH_REQUEST;
+
+    return HAL_OK;
+  }
+
+  HAL_StatusTypeDef
+  HAL_UART_Abort (UART_HandleTypeDef* huart)
+  {
+    std::lock_guard<std::recursive_mutex> lock
+      { sim::irq_mutex };
+
+    huart->Instance->CR1 &= ~(USART_CR1_RXNEIE | USART_CR1_PEIE
+        | USART_CR1_TXEIE | USART_CR1_TCIE);
+    huart->Instance->CR3 &= ~USART_CR3_EIE;
+
+    if (huart->Instance->CR3 & USART_CR3_DMAT)
+      {
+        huart->Instance->CR3 &= ~USART_CR3_DMAT;
+        dma_abort (huart->hdmatx);
+      }
+    if (huart->Instance->CR3 & USART_CR3_DMAR)
+      {
+        huart->Instance->CR3 &= ~USART_CR3_DMAR;
+        dma_abort (huart->hdmarx);
+      }
+
+    huart->TxXferCount = 0;
+    huart->RxXferCount = 0;
+    huart->Instance->ICR = UART_CLEAR_OREF | UART_CLEAR_NEF | UART_CLEAR_PEF
+        | UART_CLEAR_FEF;
+    huart->Instance->RQR = UART_RXDATA_FLUSH_REQUEST;
+
+    huart->gState = HAL_UART_STATE_READY;
+    huart->RxState = HAL_UART_STATE_READY;
+    huart->ErrorCode = HAL_UART_ERROR_NONE;
+
+    return HAL_OK;
+  }
+
+  void
+  HAL_UART_IRQHandler (UART_HandleTypeDef* huart)
+  {
+    uint32_t isr = huart->Instance->ISR;
+    uint32_t cr1 = huart->Instance->CR1;
+    uint32_t cr3 = huart->Instance->CR3;
+    uint32_t errorflags = isr
+        & (USART_ISR_PE | USART_ISR_FE | USART_ISR_ORE | USART_ISR_NE
+            | USART_ISR_RTOF);
+
+    if (errorflags == 0)
+      {
+        if ((isr & USART_ISR_RXNE) && (cr1 & USART_CR1_RXNEIE))
+          {
+            rx_isr (huart);
+            return;
+          }
+      }
+    else if ((cr3 & USART_CR3_EIE)
+        || (cr1 & (USART_CR1_RXNEIE | USART_CR1_PEIE | USART_CR1_RTOIE)))
+      {
+        if ((isr & USART_ISR_PE) && (cr1 & USART_CR1_PEIE))
+          {
+            huart->Instance->ICR = UART_CLEAR_PEF;
+            huart->ErrorCode |= HAL_UART_ERROR_PE;
+          }
+        if ((isr & USART_ISR_FE) && (cr3 & USART_CR3_EIE))
+          {
+            huart->Instance->ICR = UART_CLEAR_FEF;
+            huart->ErrorCode |= HAL_UART_ERROR_FE;
+          }
+        if ((isr & USART_ISR_NE) && (cr3 & USART_CR3_EIE))
+          {
+            huart->Instance->ICR = UART_CLEAR_NEF;
+            huart->ErrorCode |= HAL_UART_ERROR_NE;
+          }
+        if ((isr & USART_ISR_ORE)
+            && ((cr1 & USART_CR1_RXNEIE) || (cr3 & USART_CR3_EIE)))
+          {
+            huart->Instance->ICR = UART_CLEAR_OREF;
+            huart->ErrorCode |= HAL_UART_ERROR_ORE;
+          }
+        if ((isr & USART_ISR_RTOF) && (cr1 & USART_CR1_RTOIE))
+          {
+            huart->Instance->ICR = UART_CLEAR_RTOF;
+            huart->ErrorCode |= HAL_UART_ERROR_RTO;
+          }
+
+        if (huart->ErrorCode != HAL_UART_ERROR_NONE)
+          {
+            if ((isr & USART_ISR_RXNE) && (cr1 & USART_CR1_RXNEIE))
+              {
+                rx_isr (huart);
+              }
+
+            if ((huart->Instance->CR3 & USART_CR3_DMAR)
+                || (huart->ErrorCode
+                    & (HAL_UART_ERROR_RTO | HAL_UART_ERROR_ORE)))
+              {
+                // blocking error: reception is aborted
+                end_rx_transfer (huart);
+                if (huart->Instance->CR3 & USART_CR3_DMAR)
+                  {
+                    huart->Instance->CR3 &= ~USART_CR3_DMAR;
+                    dma_abort (huart->hdmarx);
+                    huart->RxXferCount = 0;
+                  }
+                HAL_UART_ErrorCallback (huart);
+              }
+            else
+              {
+                HAL_UART_ErrorCallback (huart);
+                huart->ErrorCode = HAL_UART_ERROR_NONE;
+              }
+          }
+        return;
+      }
+
+    if ((isr & USART_ISR_TXE) && (cr1 & USART_CR1_TXEIE))
+      {
+        tx_isr (huart);
+        return;
+      }
+
+    if ((isr & USART_ISR_TC) && (cr1 & USART_CR1_TCIE))
+      {
+        end_tx_transfer (huart);
+        HAL_UART_TxCpltCallback (huart);
+        return;
+      }
+  }
+
+  __attribute__((weak)) void
+  HAL_UART_TxCpltCallback (UART_HandleTypeDef* huart)
+  {
+    ;
+  }
+
+  __attribute__((weak)) void
+  HAL_UART_TxHalfCpltCallback (UART_HandleTypeDef* huart)
+  {
+    ;
+  }
+
+  __attribute__((weak)) void
+  HAL_UART_RxCpltCallback (UART_HandleTypeDef* huart)
+  {
+    ;
+  }
+
+  __attribute__((weak)) void
+  HAL_UART_RxHalfCpltCallback (UART_HandleTypeDef* huart)
+  {
+    ;
+  }
+
+  __attribute__((weak)) void
+  HAL_UART_ErrorCallback (UART_HandleTypeDef* huart)
+  {
+    ;
+  }
+}
+
+// ----------------------------------------------------------------------------
+// Simulation control
+
+void
+sim_start (void)
+{
+  bool expected = false;
+
+  if (running.compare_exchange_strong (expected, true))
+    {
+      sim_scb.CCR |= SCB_CCR_DC_Msk;
+      engine = std::thread (run);
+    }
+}
+
+void
+sim_stop (void)
+{
+  bool expected = true;
+
+  if (running.compare_exchange_strong (expected, false))
+    {
+      if (engine.joinable ())
+        {
+          engine.join ();
+        }
+    }
+}
+
+void
+sim_rcc_set_pclk (uint32_t p1, uint32_t p2)
+{
+  std::lock_guard<std::recursive_mutex> lock
+    { sim::irq_mutex };
+
+  pclk1 = p1;
+  pclk2 = p2;
+}
+
+void
+sim_rcc_set_uart_source (USART_TypeDef* usart, UART_ClockSourceTypeDef source)
+{
+  std::lock_guard<std::recursive_mutex> lock
+    { sim::irq_mutex };
+
+  clock_sources[index_of (usart)] = source;
+}
+
+void
+sim_uart_set_irq_handler (USART_TypeDef* usart, void
+(*handler) (void))
+{
+  std::lock_guard<std::recursive_mutex> lock
+    { sim::irq_mutex };
+
+  port_of (usart).irq = handler;
+}
+
+void
+sim_uart_loopback (USART_TypeDef* usart, bool enable)
+{
+  std::lock_guard<std::recursive_mutex> lock
+    { sim::irq_mutex };
+
+  port_of (usart).loopback = enable;
+}
+
+void
+sim_uart_connect (USART_TypeDef* a, USART_TypeDef* b)
+{
+  std::lock_guard<std::recursive_mutex> lock
+    { sim::irq_mutex };
+
+  port_of (a).peer = &port_of (b);
+  port_of (b).peer = &port_of (a);
+}
+
+void
+sim_uart_inject (USART_TypeDef* usart, const uint8_t* data, size_t len,
+                 uint32_t flags)
+{
+  std::lock_guard<std::recursive_mutex> lock
+    { sim::irq_mutex };
+  port& p = port_of (usart);
+
+  while (len--)
+    {
+      p.wire.push_back (*data++ | ((flags & char_flags) << char_flags_pos));
+    }
+}
+
+void
+sim_dma_set_irq_latency (uint32_t char_times)
+{
+  std::lock_guard<std::recursive_mutex> lock
+    { sim::irq_mutex };
+
+  dma_irq_latency = char_times;
+}
+
+void
+sim_uart_inject_idle (USART_TypeDef* usart, size_t char_times)
+{
+  std::lock_guard<std::recursive_mutex> lock
+    { sim::irq_mutex };
+  port& p = port_of (usart);
+
+  while (char_times--)
+    {
+      p.wire.push_back (char_idle);
+    }
+}
+
+size_t
+sim_uart_pending (USART_TypeDef* usart)
+{
+  std::lock_guard<std::recursive_mutex> lock
+    { sim::irq_mutex };
+
+  return port_of (usart).wire.size ();
+}
+
+void
+sim_uart_set_tx_hook (USART_TypeDef* usart, void
+(*hook) (uint16_t c, void* arg),
+                      void* arg)
+{
+  std::lock_guard<std::recursive_mutex> lock
+    { sim::irq_mutex };
+  port& p = port_of (usart);
+
+  p.tx_hook = hook;
+  p.tx_hook_arg = arg;
+}
+
+uint32_t
+sim_uart_get_baud (USART_TypeDef* usart)
+{
+  return baud_of (usart);
+}
+
+void
+sim_uart_get_stats (USART_TypeDef* usart, sim_uart_stats* stats)
+{
+  std::lock_guard<std::recursive_mutex> lock
+    { sim::irq_mutex };
+
+  *stats = port_of (usart).stats;
+}
+
+void
+sim_cache_get_stats (sim_cache_stats* stats)
+{
+  std::lock_guard<std::recursive_mutex> lock
+    { sim::irq_mutex };
+
+  *stats = cache_stats;
+}
+
+void
+sim_cache_reset_stats (void)
+{
+  std::lock_guard<std::recursive_mutex> lock
+    { sim::irq_mutex };
+
+  cache_stats = sim_cache_stats
+    { };
+}
+
+#pragma GCC diagnostic pop
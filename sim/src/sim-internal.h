@@ -0,0 +1,68 @@
+/*
+ * sim-internal.h
+ *
+ * Copyright (c) 2026 Lix N. Paulian (lix@paulian.net)
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom
+ * the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Created on: 16 Oct 2026 (LNP)
+ *
+ * Declarations shared by the simulation modules only.
+ */
+
+#ifndef SIM_SRC_SIM_INTERNAL_H_
+#define SIM_SRC_SIM_INTERNAL_H_
+
+#include <stdint.h>
+#include <mutex>
+
+namespace sim
+{
+  /**
+   * @brief The "interrupt lock": held by the peripheral thread while it
+   *      runs simulated ISRs, by critical sections and by register accesses
+   *      with side effects.
+   */
+  extern std::recursive_mutex irq_mutex;
+
+  /**
+   * @brief Mark the calling thread as running in handler mode.
+   */
+  void
+  set_handler_mode (bool state);
+
+  /**
+   * @brief Service the USB devices; called by the peripheral thread with
+   *      the interrupt lock held.
+   */
+  void
+  usb_service (uint64_t now_ns);
+
+  /**
+   * @brief Monotonic time in nanoseconds.
+   */
+  uint64_t
+  now_ns (void);
+
+} /* namespace sim */
+
+#endif /* SIM_SRC_SIM_INTERNAL_H_ */
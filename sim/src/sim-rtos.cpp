@@ -0,0 +1,375 @@
+/*
+ * sim-rtos.cpp
+ *
+ * Copyright (c) 2026 Lix N. Paulian (lix@paulian.net)
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom
+ * the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Created on: 16 Oct 2026 (LNP)
+ *
+ * Host implementation of the simulated µOS++ RTOS primitives, trace and
+ * POSIX tty layer.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <thread>
+
+#include <cmsis-plus/rtos/os.h>
+#include <cmsis-plus/diag/trace.h>
+#include <cmsis-plus/posix-io/tty.h>
+
+#include "sim-internal.h"
+
+namespace sim
+{
+  std::recursive_mutex irq_mutex;
+
+  static thread_local bool handler_mode = false;
+
+  void
+  set_handler_mode (bool state)
+  {
+    handler_mode = state;
+  }
+
+  uint64_t
+  now_ns (void)
+  {
+    static const auto start = std::chrono::steady_clock::now ();
+    return std::chrono::duration_cast<std::chrono::nanoseconds> (
+        std::chrono::steady_clock::now () - start).count ();
+  }
+} /* namespace sim */
+
+namespace os
+{
+  namespace rtos
+  {
+    clock_systick sysclock;
+
+    clock::timestamp_t
+    clock::now (void)
+    {
+      return sim::now_ns () / (1000000000ULL / clock_systick::frequency_hz);
+    }
+
+    result_t
+    clock::sleep_for (duration_t duration)
+    {
+      std::this_thread::sleep_for (std::chrono::milliseconds (duration));
+      return result::ok;
+    }
+
+    uint64_t
+    clock::now_ns (void)
+    {
+      return sim::now_ns ();
+    }
+
+    semaphore_binary::semaphore_binary (const char* name,
+                                        count_t initial_value) :
+        name_
+          { name }, //
+        initial_value_
+          { initial_value }, //
+        count_
+          { initial_value }
+    {
+      ;
+    }
+
+    result_t
+    semaphore_binary::post (void)
+    {
+      std::lock_guard<std::mutex> lock
+        { mx_ };
+      if (count_ > 0)
+        {
+          return EAGAIN;
+        }
+      count_ = 1;
+      cv_.notify_one ();
+      return result::ok;
+    }
+
+    result_t
+    semaphore_binary::wait (void)
+    {
+      std::unique_lock<std::mutex> lock
+        { mx_ };
+      cv_.wait (lock, [this]
+        { return count_ > 0;});
+      count_ = 0;
+      return result::ok;
+    }
+
+    result_t
+    semaphore_binary::try_wait (void)
+    {
+      std::lock_guard<std::mutex> lock
+        { mx_ };
+      if (count_ == 0)
+        {
+          return EWOULDBLOCK;
+        }
+      count_ = 0;
+      return result::ok;
+    }
+
+    result_t
+    semaphore_binary::timed_wait (clock::duration_t timeout)
+    {
+      std::unique_lock<std::mutex> lock
+        { mx_ };
+      if (!cv_.wait_for (lock, std::chrono::milliseconds (timeout), [this]
+        { return count_ > 0;}))
+        {
+          return ETIMEDOUT;
+        }
+      count_ = 0;
+      return result::ok;
+    }
+
+    semaphore_binary::count_t
+    semaphore_binary::value (void) const
+    {
+      std::lock_guard<std::mutex> lock
+        { mx_ };
+      return count_;
+    }
+
+    result_t
+    semaphore_binary::reset (void)
+    {
+      std::lock_guard<std::mutex> lock
+        { mx_ };
+      count_ = initial_value_;
+      return result::ok;
+    }
+
+    const char*
+    semaphore_binary::name (void) const
+    {
+      return name_;
+    }
+
+    namespace interrupts
+    {
+      bool
+      in_handler_mode (void)
+      {
+        return sim::handler_mode;
+      }
+
+      critical_section::critical_section ()
+      {
+        sim::irq_mutex.lock ();
+      }
+
+      critical_section::~critical_section ()
+      {
+        sim::irq_mutex.unlock ();
+      }
+    } /* namespace interrupts */
+  } /* namespace rtos */
+
+  namespace trace
+  {
+    int
+    printf (const char* format, ...)
+    {
+      static const bool enabled = getenv ("SIM_TRACE") != nullptr;
+      int result = 0;
+
+      if (enabled)
+        {
+          std::va_list args;
+          va_start(args, format);
+          result = vfprintf (stderr, format, args);
+          va_end(args);
+        }
+      return result;
+    }
+
+    int
+    puts (const char* s)
+    {
+      return printf ("%s\n", s);
+    }
+  } /* namespace trace */
+
+  namespace posix
+  {
+    static tty* first_tty = nullptr;
+
+    io*
+    open (const char* path, int oflag, ...)
+    {
+      static constexpr char prefix[] = "/dev/";
+
+      if (strncmp (path, prefix, sizeof(prefix) - 1) != 0)
+        {
+          errno = ENOENT;
+          return nullptr;
+        }
+
+      tty* dev = tty::find (path + sizeof(prefix) - 1);
+      if (dev == nullptr)
+        {
+          errno = ENOENT;
+          return nullptr;
+        }
+
+      std::va_list args;
+      va_start(args, oflag);
+      int result = dev->vopen (path, oflag, args);
+      va_end(args);
+
+      return result < 0 ? nullptr : dev;
+    }
+
+    tty::tty (tty_impl& impl, const char* name) :
+        impl_ (impl), //
+        name_
+          { name }, //
+        next_
+          { first_tty }
+    {
+      first_tty = this;
+    }
+
+    tty::~tty () noexcept
+    {
+      for (tty** p = &first_tty; *p != nullptr; p = &(*p)->next_)
+        {
+          if (*p == this)
+            {
+              *p = next_;
+              break;
+            }
+        }
+    }
+
+    tty*
+    tty::find (const char* name)
+    {
+      for (tty* p = first_tty; p != nullptr; p = p->next_)
+        {
+          if (strcmp (p->name_, name) == 0)
+            {
+              return p;
+            }
+        }
+      return nullptr;
+    }
+
+    int
+    tty::vopen (const char* path, int oflag, std::va_list args)
+    {
+      return impl_.do_vopen (path, oflag, args);
+    }
+
+    int
+    tty::close (void)
+    {
+      return impl_.do_close ();
+    }
+
+    ssize_t
+    tty::read (void* buf, std::size_t nbyte)
+    {
+      return impl_.do_read (buf, nbyte);
+    }
+
+    ssize_t
+    tty::write (const void* buf, std::size_t nbyte)
+    {
+      return impl_.do_write (buf, nbyte);
+    }
+
+    int
+    tty::ioctl (int request, ...)
+    {
+      std::va_list args;
+      va_start(args, request);
+      int result = vioctl (request, args);
+      va_end(args);
+      return result;
+    }
+
+    int
+    tty::vioctl (int request, std::va_list args)
+    {
+      return impl_.do_vioctl (request, args);
+    }
+
+    bool
+    tty::is_opened (void)
+    {
+      return impl_.do_is_opened ();
+    }
+
+    bool
+    tty::is_connected (void)
+    {
+      return impl_.do_is_connected ();
+    }
+
+    int
+    tty::tcgetattr (struct termios* ptio)
+    {
+      return impl_.do_tcgetattr (ptio);
+    }
+
+    int
+    tty::tcsetattr (int options, const struct termios* ptio)
+    {
+      return impl_.do_tcsetattr (options, ptio);
+    }
+
+    int
+    tty::tcflush (int queue_selector)
+    {
+      return impl_.do_tcflush (queue_selector);
+    }
+
+    int
+    tty::tcsendbreak (int duration)
+    {
+      return impl_.do_tcsendbreak (duration);
+    }
+
+    int
+    tty::tcdrain (void)
+    {
+      return impl_.do_tcdrain ();
+    }
+
+    const char*
+    tty::name (void) const
+    {
+      return name_;
+    }
+  } /* namespace posix */
+} /* namespace os */
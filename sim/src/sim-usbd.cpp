@@ -0,0 +1,309 @@
+/*
+ * sim-usbd.cpp
+ *
+ * Copyright (c) 2026 Lix N. Paulian (lix@paulian.net)
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom
+ * the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Created on: 16 Oct 2026 (LNP)
+ *
+ * Host model of a USB CDC device as seen through the ST USB device library,
+ * with a simple host on the other side of the cable.
+ */
+
+#include <string.h>
+#include <deque>
+#include <vector>
+
+#include <cmsis-plus/rtos/os.h>
+
+#include "usbd_cdc_if.h"
+#include "sim-uart.h"
+#include "sim-internal.h"
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+
+USBD_HandleTypeDef hUsbDeviceFS;
+USBD_HandleTypeDef hUsbDeviceHS;
+
+namespace
+{
+  // delay between USB_DEVICE_Init() and the enumeration completing
+  constexpr uint64_t enumeration_ns = 1000000;
+
+  struct device
+  {
+    USBD_HandleTypeDef* husbd;
+    USBD_CDC_HandleTypeDef cdc;
+    USBD_SpeedTypeDef speed = USBD_SPEED_FULL;
+    bool started;
+    bool configured;
+    bool rx_armed;
+    uint64_t configure_at_ns;
+    uint64_t next_rx_ns;
+    uint64_t tx_done_ns;
+    std::deque<std::vector<uint8_t>> packets;
+    void
+    (*tx_hook) (const uint8_t* data, size_t len, void* arg);
+    void* tx_hook_arg;
+  };
+
+  device devices[2];
+
+  inline device&
+  device_of (USBD_HandleTypeDef* pdev)
+  {
+    return devices[pdev->id == DEVICE_HS ? 1 : 0];
+  }
+
+  uint32_t
+  packet_size (const device& d)
+  {
+    return d.speed == USBD_SPEED_HIGH ?
+        USB_HS_MAX_PACKET_SIZE : USB_FS_MAX_PACKET_SIZE;
+  }
+
+  uint64_t
+  transfer_ns (const device& d, size_t len)
+  {
+    // rough bulk throughput: 1 MB/s on FS, 40 MB/s on HS
+    uint64_t bytes_per_s = d.speed == USBD_SPEED_HIGH ? 40000000 : 1000000;
+    return 1000 + (len * 1000000000ULL) / bytes_per_s;
+  }
+}
+
+namespace sim
+{
+  void
+  usb_service (uint64_t now)
+  {
+    for (auto& d : devices)
+      {
+        if (!d.started)
+          {
+            continue;
+          }
+
+        if (!d.configured)
+          {
+            if (now >= d.configure_at_ns)
+              {
+                d.configured = true;
+                cdc_init (d.husbd);
+              }
+            continue;
+          }
+
+        if (d.rx_armed && !d.packets.empty () && now >= d.next_rx_ns)
+          {
+            std::vector<uint8_t> packet = std::move (d.packets.front ());
+            d.packets.pop_front ();
+
+            uint32_t len = packet.size ();
+            memcpy (d.cdc.RxBuffer, packet.data (), len);
+            d.rx_armed = false;
+            d.next_rx_ns = now + transfer_ns (d, len);
+            cdc_receive (d.husbd, d.cdc.RxBuffer, &len);
+          }
+
+        if (d.cdc.TxState != 0 && now >= d.tx_done_ns)
+          {
+            if (d.tx_hook != nullptr)
+              {
+                d.tx_hook (d.cdc.TxBuffer, d.cdc.TxLength, d.tx_hook_arg);
+              }
+            d.cdc.TxState = 0;
+          }
+      }
+  }
+} /* namespace sim */
+
+USBD_HandleTypeDef*
+USB_DEVICE_Init (uint8_t usb_id)
+{
+  std::lock_guard<std::recursive_mutex> lock
+    { sim::irq_mutex };
+
+  USBD_HandleTypeDef* husbd =
+      usb_id == DEVICE_HS ? &hUsbDeviceHS : &hUsbDeviceFS;
+  device& d = devices[usb_id == DEVICE_HS ? 1 : 0];
+
+  sim_start ();
+
+  husbd->id = usb_id;
+  husbd->dev_speed = d.speed;
+  husbd->pClassData = &d.cdc;
+  d.husbd = husbd;
+  d.cdc = USBD_CDC_HandleTypeDef
+    { };
+  d.started = true;
+  d.configured = false;
+  d.rx_armed = false;
+  d.configure_at_ns = sim::now_ns () + enumeration_ns;
+
+  return husbd;
+}
+
+extern "C"
+{
+  uint8_t
+  USBD_CDC_SetTxBuffer (USBD_HandleTypeDef* pdev, uint8_t* pbuff,
+                        uint32_t length)
+  {
+    std::lock_guard<std::recursive_mutex> lock
+      { sim::irq_mutex };
+    device& d = device_of (pdev);
+
+    d.cdc.TxBuffer = pbuff;
+    d.cdc.TxLength = length;
+    return USBD_OK;
+  }
+
+  uint8_t
+  USBD_CDC_SetRxBuffer (USBD_HandleTypeDef* pdev, uint8_t* pbuff)
+  {
+    std::lock_guard<std::recursive_mutex> lock
+      { sim::irq_mutex };
+
+    device_of (pdev).cdc.RxBuffer = pbuff;
+    return USBD_OK;
+  }
+
+  uint8_t
+  USBD_CDC_ReceivePacket (USBD_HandleTypeDef* pdev)
+  {
+    std::lock_guard<std::recursive_mutex> lock
+      { sim::irq_mutex };
+
+    device_of (pdev).rx_armed = true;
+    return USBD_OK;
+  }
+
+  uint8_t
+  USBD_CDC_TransmitPacket (USBD_HandleTypeDef* pdev)
+  {
+    std::lock_guard<std::recursive_mutex> lock
+      { sim::irq_mutex };
+    device& d = device_of (pdev);
+
+    if (d.cdc.TxState != 0)
+      {
+        return USBD_BUSY;
+      }
+    d.cdc.TxState = 1;
+    d.tx_done_ns = sim::now_ns () + transfer_ns (d, d.cdc.TxLength);
+    return USBD_OK;
+  }
+
+  USBD_StatusTypeDef
+  USBD_DeInit (USBD_HandleTypeDef* pdev)
+  {
+    std::lock_guard<std::recursive_mutex> lock
+      { sim::irq_mutex };
+    device& d = device_of (pdev);
+
+    if (d.configured)
+      {
+        cdc_deinit (pdev);
+      }
+    d.started = false;
+    d.configured = false;
+    d.rx_armed = false;
+    d.cdc.TxState = 0;
+    return USBD_OK;
+  }
+}
+
+void
+sim_usb_set_speed (uint8_t usb_id, USBD_SpeedTypeDef speed)
+{
+  std::lock_guard<std::recursive_mutex> lock
+    { sim::irq_mutex };
+
+  devices[usb_id == DEVICE_HS ? 1 : 0].speed = speed;
+}
+
+void
+sim_usb_host_send (uint8_t usb_id, const uint8_t* data, size_t len)
+{
+  std::lock_guard<std::recursive_mutex> lock
+    { sim::irq_mutex };
+  device& d = devices[usb_id == DEVICE_HS ? 1 : 0];
+  size_t mps = packet_size (d);
+
+  while (len > 0)
+    {
+      size_t n = len < mps ? len : mps;
+      d.packets.emplace_back (data, data + n);
+      data += n;
+      len -= n;
+      if (len == 0 && n == mps)
+        {
+          // a transfer ending on a packet boundary is closed by a ZLP
+          d.packets.emplace_back ();
+        }
+    }
+}
+
+void
+sim_usb_set_tx_hook (uint8_t usb_id, void
+(*hook) (const uint8_t* data, size_t len, void* arg),
+                     void* arg)
+{
+  std::lock_guard<std::recursive_mutex> lock
+    { sim::irq_mutex };
+  device& d = devices[usb_id == DEVICE_HS ? 1 : 0];
+
+  d.tx_hook = hook;
+  d.tx_hook_arg = arg;
+}
+
+// Default (empty) application call-backs, for programs that only use the
+// UART driver.
+
+__attribute__((weak)) int8_t
+cdc_init (USBD_HandleTypeDef* husbd)
+{
+  return USBD_OK;
+}
+
+__attribute__((weak)) int8_t
+cdc_deinit (USBD_HandleTypeDef* husbd)
+{
+  return USBD_OK;
+}
+
+__attribute__((weak)) int8_t
+cdc_control (USBD_HandleTypeDef* husbd, uint8_t cmd, uint8_t* pbuf,
+             uint16_t length)
+{
+  return USBD_OK;
+}
+
+__attribute__((weak)) int8_t
+cdc_receive (USBD_HandleTypeDef* husbd, uint8_t* buf, uint32_t* len)
+{
+  return USBD_OK;
+}
+
+#pragma GCC diagnostic pop
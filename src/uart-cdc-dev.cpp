@@ -42,6 +42,7 @@ namespace os
   {
     namespace stm32f7
     {
+      uart_cdc_dev* volatile uart_cdc_dev::ports_[2];
 
       uart_cdc_dev::uart_cdc_dev (uint8_t usb_id, uint8_t* tx_buff,
                                   uint8_t* rx_buff, size_t tx_buff_size,
@@ -58,12 +59,21 @@ namespace os
             { rx_buff_size }
       {
         trace::printf ("%s() %p\n", __func__, this);
+
+        if (usb_id_ < 2)
+          {
+            ports_[usb_id_] = this;
+          }
       }
 
       uart_cdc_dev::~uart_cdc_dev ()
       {
         trace::printf ("%s() %p\n", __func__, this);
 
+        if (usb_id_ < 2 && ports_[usb_id_] == this)
+          {
+            ports_[usb_id_] = nullptr;
+          }
         is_opened_ = false;
       }
 
@@ -71,7 +81,15 @@ namespace os
       uart_cdc_dev::config (uint8_t usb_id, uint8_t* tx_buff, uint8_t* rx_buff,
                             size_t tx_buff_size, size_t rx_buff_size)
       {
+        if (usb_id_ < 2 && ports_[usb_id_] == this)
+          {
+            ports_[usb_id_] = nullptr;
+          }
         usb_id_ = usb_id;
+        if (usb_id_ < 2)
+          {
+            ports_[usb_id_] = this;
+          }
         tx_buff_ = tx_buff;
         rx_buff_ = rx_buff;
         tx_buff_size_ = tx_buff_size;
@@ -91,10 +109,6 @@ namespace os
                 break;
               }
 
-            // initialize FIFO
-            rx_in_ = 0;
-            rx_out_ = 0;
-
             // reset semaphores
             init_sem_.reset ();
             rx_sem_.reset ();
@@ -153,6 +167,12 @@ namespace os
                 rx_buff_dyn_ = false;
               }
 
+            // initialize FIFO
+            rx_ring_.init (rx_buff_, rx_buff_size_);
+#if UART_USE_STATS == true || UART_USE_LATENCY == true
+            cycle_counter_enable ();
+#endif
+
             // set initial timeout depending on the O_NONBLOCK flag
             if (oflag & O_NONBLOCK)
               {
@@ -241,22 +261,26 @@ namespace os
         rtos::clock::duration_t timeout =
             o_nonblock_ ? 0 : (cc_vmin_ > 0) ? 0xFFFFFFFF : rx_timeout_;
 
-        uint32_t last_count = rx_in_;
+        size_t last_count = rx_ring_.head ();
 
         do
           {
-            while (rx_out_ == rx_in_)
+            while (rx_ring_.empty ())
               {
                 if (rx_sem_.timed_wait (timeout) != rtos::result::ok)
                   {
-                    if (last_count == rx_in_)
+                    if (last_count == rx_ring_.head ())
                       {
                         // no more chars received: that means inter-char timeout
                         // return number of chars collected, if any
                         timeout_exit = true;
                         break;
                       }
-                    last_count = rx_in_;
+                    last_count = rx_ring_.head ();
+                  }
+                else
+                  {
+                    UART_STATS (stats_.rx_wakeups++);
                   }
                 if (is_error_ == true)
                   {
@@ -268,22 +292,15 @@ namespace os
 
             // retrieve accumulated chars, if any
               {
-                rtos::interrupts::critical_section ics; // critical section
+                size_t n = rx_ring_.pop (lbuf, nbyte - count);
 
-                while (rx_out_ != rx_in_ && count < (ssize_t) nbyte)
+                if (n > 0 && count == 0)
                   {
-                    *lbuf++ = rx_buff_[rx_out_];
-                    rx_out_ = rx_out_ + 1;
-                    if (++count == 1)
-                      {
-                        // VMIN > 0, apply timeout (can be infinitum too)
-                        timeout = rx_timeout_;
-                      }
-                    if (rx_out_ >= rx_buff_size_)
-                      {
-                        rx_out_ = 0;
-                      }
+                    // VMIN > 0, apply timeout (can be infinitum too)
+                    timeout = rx_timeout_;
                   }
+                lbuf += n;
+                count += n;
               }
             if (count >= (ssize_t) nbyte || timeout_exit)
               {
@@ -293,10 +310,89 @@ namespace os
         while (last_packet_ == false || count < cc_vmin_);
 
         last_packet_ = false;
+#if UART_USE_LATENCY == true
+        if (count > 0)
+          {
+            rx_probe_.stop (latency_.rx_read);
+          }
+#endif
+
+        return count;
+      }
+
+      /**
+       * @brief  Lend the received data to the caller, without copying it:
+       *    "first" and "second" describe the data before and after the end
+       *    of the receive buffer (second.len is 0 if there is no wrap). The
+       *    data stays in the buffer until released with consume(). The call
+       *    waits for data as read() would wait for its first character.
+       * @return  Total number of bytes in the two spans (0 on timeout), or
+       *    -1 on error (errno set).
+       */
+      ssize_t
+      uart_cdc_dev::peek (rx_span& first, rx_span& second)
+      {
+        rtos::clock::duration_t timeout =
+            o_nonblock_ ? 0 : (cc_vmin_ > 0) ? 0xFFFFFFFF : rx_timeout_;
+
+        size_t last_count = rx_ring_.head ();
+
+        while (rx_ring_.empty ())
+          {
+            if (rx_sem_.timed_wait (timeout) != rtos::result::ok)
+              {
+                if (last_count == rx_ring_.head ())
+                  {
+                    break;      // inter-char timeout
+                  }
+                last_count = rx_ring_.head ();
+              }
+            else
+              {
+                UART_STATS (stats_.rx_wakeups++);
+              }
+            if (is_error_ == true)
+              {
+                is_error_ = false;
+                errno = EIO;
+                return -1;  // an error was reported, exit
+              }
+          }
+
+        first.mask = 0xFF;
+        second.mask = 0xFF;
+
+        size_t count = rx_ring_.peek (first.data, first.len, second.data,
+                                      second.len);
+#if UART_USE_LATENCY == true
+        if (count > 0)
+          {
+            rx_probe_.stop (latency_.rx_read);
+          }
+#endif
 
         return count;
       }
 
+      /**
+       * @brief  Release data lent by peek().
+       * @param  nbyte: number of bytes to release, at most the total length
+       *    of the spans returned by peek().
+       * @return  0 if successful, -1 otherwise (errno set).
+       */
+      int
+      uart_cdc_dev::consume (std::size_t nbyte)
+      {
+        if (nbyte > rx_ring_.available ())
+          {
+            errno = EINVAL;
+            return -1;
+          }
+
+        rx_ring_.consume (nbyte);
+        return 0;
+      }
+
       ssize_t
       uart_cdc_dev::do_write (const void* buf, std::size_t nbyte)
       {
@@ -318,11 +414,13 @@ namespace os
               }
 
             // wait for possible previous ongoing write operation to finish
+            UART_STATS (uint32_t start = cycle_counter ());
             while (pcd->TxState != 0)
               {
                 // busy, wait one tick
                 rtos::sysclock.sleep_for (1);
               }
+            UART_STATS (stats_.tx_block_cycles += cycle_counter () - start);
 
             memcpy (tx_buff_, p + total,
                     count = std::min (tx_buff_size_, nbyte - total));
@@ -348,6 +446,7 @@ namespace os
               }
 
             total += count;
+            UART_STATS (stats_.tx_bytes += count);
           }
         while (total < nbyte);
 
@@ -498,8 +597,7 @@ namespace os
             if (queue_selector & TCIFLUSH)
               {
                 rx_sem_.reset ();
-                rx_in_ = 0;
-                rx_out_ = 0;
+                rx_ring_.reset ();
                 last_packet_ = false;
               }
 
@@ -526,7 +624,60 @@ namespace os
       int
       uart_cdc_dev::do_vioctl (int request, std::va_list args)
       {
-        return -1;
+        switch (request)
+          {
+#if UART_USE_STATS == true
+          case UART_IOCTL_GET_STATS:
+            {
+              uart_stats* stats = va_arg (args, uart_stats*);
+
+              if (stats == nullptr)
+                {
+                  errno = EINVAL;
+                  return -1;
+                }
+
+              rtos::interrupts::critical_section ics; // critical section
+              *stats = stats_;
+              return 0;
+            }
+
+          case UART_IOCTL_RESET_STATS:
+            {
+              rtos::interrupts::critical_section ics; // critical section
+              stats_ = uart_stats ();
+              return 0;
+            }
+#endif
+
+#if UART_USE_LATENCY == true
+          case UART_IOCTL_GET_LATENCY:
+            {
+              uart_latency* latency = va_arg (args, uart_latency*);
+
+              if (latency == nullptr)
+                {
+                  errno = EINVAL;
+                  return -1;
+                }
+
+              rtos::interrupts::critical_section ics; // critical section
+              *latency = latency_;
+              return 0;
+            }
+
+          case UART_IOCTL_RESET_LATENCY:
+            {
+              rtos::interrupts::critical_section ics; // critical section
+              latency_ = uart_latency ();
+              return 0;
+            }
+#endif
+
+          default:
+            errno = ENOTTY;
+            return -1;
+          }
       }
 
       int
@@ -579,28 +730,32 @@ namespace os
       {
         size_t xfered = *len;
 
-        while (xfered--)
-          {
-            rx_buff_[rx_in_] = *pbuf++;
-            rx_in_ = rx_in_ + 1;
-            if (rx_in_ >= rx_buff_size_)
-              {
-                rx_in_ = 0;
-              }
-          }
+        // what doesn't fit in the FIFO is lost
+#if UART_USE_STATS == true
+        size_t pushed = rx_ring_.push (pbuf, xfered);
+
+        stats_.rx_bytes += xfered;
+        stats_.rx_events++;
+        stats_.rx_dropped += xfered - pushed;
+        stats_.rx_overflows += pushed < xfered ? 1 : 0;
+        stats_.rx_high_water = std::max (stats_.rx_high_water,
+                                         (uint32_t) rx_ring_.available ());
+#else
+        rx_ring_.push (pbuf, xfered);
+#endif
 
         // restart receive
         USBD_CDC_SetRxBuffer (husbd_, cdc_buff_);
         USBD_CDC_ReceivePacket (husbd_);
 
         // last packet?
-        xfered = *len;
         if (xfered == 0 || xfered % packet_size_ > 0)
           {
             last_packet_ = true; // yes
           }
 
         // inform background we have something
+        UART_LATENCY (rx_probe_.start ());
         rx_sem_.post ();
 
         return USBD_OK;
@@ -609,5 +764,42 @@ namespace os
   } /* namespace driver */
 } /* namespace os */
 
-#pragma GCC diagnostic pop
+#if UART_USE_DISPATCH == true
+
+// The CDC interface call-backs, for both USB peripherals.
+
+using os::driver::stm32f7::uart_cdc_dev;
 
+int8_t
+cdc_init (USBD_HandleTypeDef* husbd)
+{
+  uart_cdc_dev* port = uart_cdc_dev::find (husbd);
+  return port != nullptr ? port->cb_init_event () : (int8_t) USBD_OK;
+}
+
+int8_t
+cdc_deinit (USBD_HandleTypeDef* husbd)
+{
+  uart_cdc_dev* port = uart_cdc_dev::find (husbd);
+  return port != nullptr ? port->cb_deinit_event () : (int8_t) USBD_OK;
+}
+
+int8_t
+cdc_control (USBD_HandleTypeDef* husbd, uint8_t cmd, uint8_t* pbuf,
+             uint16_t length)
+{
+  uart_cdc_dev* port = uart_cdc_dev::find (husbd);
+  return port != nullptr ?
+      port->cb_control_event (cmd, pbuf, length) : (int8_t) USBD_OK;
+}
+
+int8_t
+cdc_receive (USBD_HandleTypeDef* husbd, uint8_t* buf, uint32_t* len)
+{
+  uart_cdc_dev* port = uart_cdc_dev::find (husbd);
+  return port != nullptr ? port->cb_receive_event (buf, len) : (int8_t) USBD_OK;
+}
+
+#endif
+
+#pragma GCC diagnostic pop
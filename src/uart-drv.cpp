@@ -51,6 +51,8 @@ namespace os
   {
     namespace stm32f7
     {
+      uart_impl* volatile uart_impl::ports_[UART_DISPATCH_SLOTS];
+
       uart_impl::uart_impl (UART_HandleTypeDef* huart, uint8_t* tx_buff,
                             uint8_t* rx_buff, size_t tx_buff_size,
                             size_t rx_buff_size) :
@@ -78,6 +80,12 @@ namespace os
       {
         trace::printf ("%s() %p\n", __func__, this);
 
+        // if the handle is already set up, receive its call-backs from now
+        if (huart->Instance != nullptr)
+          {
+            attach ();
+          }
+
 #if UART_INITED_BY_CUBE_MX == true
         // de-initialize the UART, as we assume it was automatically initialized
         // by the CubeMX generated code in the CubeMX's main () function.
@@ -95,6 +103,10 @@ namespace os
       {
         trace::printf ("%s() %p\n", __func__, this);
 
+        if (huart_->Instance != nullptr)
+          {
+            detach ();
+          }
         huart_ = nullptr;
         is_opened_ = false;
       }
@@ -119,6 +131,21 @@ namespace os
                 break;
               }
 
+            if (dma_expected_ >= 0
+                && ((huart_->hdmarx != nullptr) != (dma_expected_ != 0)
+                    || (huart_->hdmatx != nullptr) != (dma_expected_ != 0)))
+              {
+                errno = EINVAL;   // not the kind of port the class is built for
+                break;
+              }
+
+            if (data_9b (huart_->Init)
+                && (tx_buff_size_ % 2 != 0 || rx_buff_size_ % 4 != 0))
+              {
+                errno = EINVAL;   // the buffer halves can't hold whole words
+                break;
+              }
+
             // initialize the UART
             if (rs485_params_ & RS485_MASK)
               {
@@ -150,7 +177,7 @@ namespace os
             // if no rx/tx static buffers supplied, create them dynamically
             if (tx_buff_ == nullptr)
               {
-                if ((tx_buff_ = new uint8_t[tx_buff_size_]) == nullptr)
+                if ((tx_buff_ = dma_buffer_alloc (tx_buff_size_, &tx_pool_)) == nullptr)
                   {
                     errno = ENOMEM;
                     break;
@@ -167,7 +194,7 @@ namespace os
 
             if (rx_buff_ == nullptr)
               {
-                if ((rx_buff_ = new uint8_t[rx_buff_size_]) == nullptr)
+                if ((rx_buff_ = dma_buffer_alloc (rx_buff_size_, &rx_pool_)) == nullptr)
                   {
                     errno = ENOMEM;
                     break;
@@ -182,6 +209,20 @@ namespace os
                 rx_buff_dyn_ = false;
               }
 
+#if UART_USE_STATS == true || UART_USE_LATENCY == true
+            cycle_counter_enable ();
+#endif
+
+            // no cache maintenance for buffers in DTCM or non-cacheable RAM
+            tx_cached_ = cache_maintenance_
+                && dma_buffer_is_cached (tx_buff_, tx_buff_size_);
+            rx_cached_ = cache_maintenance_
+                && dma_buffer_is_cached (rx_buff_, rx_buff_size_);
+
+            // a receive DMA stream set up in circular mode is never re-armed
+            rx_circular_ = huart_->hdmarx != nullptr
+                && huart_->hdmarx->Init.Mode == DMA_CIRCULAR;
+
             // set initial timeout depending on the O_NONBLOCK flag
             if (oflag & O_NONBLOCK)
               {
@@ -195,61 +236,92 @@ namespace os
               }
 
             // initialize FIFOs and semaphores
-            tx_in_ = 0;
-            tx_out_ = 0;
-            rx_in_ = 0;
-            rx_out_ = 0;
-
-            // reset semaphores
+            tx_ring_.init (tx_buff_, tx_buff_size_);
+            rx_ring_.init (rx_buff_, rx_buff_size_);
+            rx_scanned_ = 0;
+            rx_eol_late_ = false;
+            frames_.reset ();
+            frame_start_ = 0;
+            frame_len_ = 0;
+            frame_errors_ = 0;
+            rx_overrun_ = false;
+            rx_paused_ = false;
+            rx_overflows_ = 0;
+            tx_xfer_size_ = 0;
+            zc_buff_ = nullptr;
+            zc_active_ = false;
+
+            // the counters start from 0
+            UART_STATS (stats_ = uart_stats ());
+
+            // reset semaphores, and the errors not reported before close
             tx_sem_.reset ();
             rx_sem_.reset ();
+            drain_sem_.reset ();
+            tx_draining_ = false;
+            rx_errors_.reset ();
+            rx_ff_split_ = SIZE_MAX;
+
+            // the call-backs of the handle are for this port from now
+            attach ();
+
+            // bytes or 16 bit words, the DMA streams set up for them
+            set_xfer_width ();
 
             // start receiving, basically wait for input characters
-            // check if we have DMA enabled for receive
-            if (huart_->hdmarx == nullptr)
-              {
-                // enable receive through UART interrupt transfers
-                hal_result = HAL_UART_Receive_IT (huart_, rx_buff_,
-                                                  rx_buff_size_ / 2);
-              }
-            else
+            if (huart_->hdmarx != nullptr && rx_cached_)
               {
-                // enable receive through DMA transfers
                 // flush and clean the data cache to mitigate incoherence after
                 // DMA transfers (all but the DTCM RAM is cached if D-Cache is enabled)
-                if ((rx_buff_ + rx_buff_size_) >= (uint8_t*) SRAM1_BASE)
-                  {
-                    invalidate_dcache (rx_buff_, rx_buff_size_);
-                  }
-                hal_result = HAL_UART_Receive_DMA (huart_, rx_buff_,
-                                                   rx_buff_size_);
+                invalidate_dcache (rx_buff_, rx_buff_size_);
+              }
+            hal_result = start_rx (0);
+
+            if (hal_result == HAL_OK)
+              {
+                set_canonical ();
+                set_rx_gap ();
+                result = 0;
               }
           }
         while (false);
 
-        if (hal_result != HAL_OK)
+        if (result < 0)
           {
-            switch (hal_result)
+            if (hal_result != HAL_OK)
               {
-              case HAL_BUSY:
-                errno = EBUSY;
-                break;
+                switch (hal_result)
+                  {
+                  case HAL_BUSY:
+                    errno = EBUSY;
+                    break;
 
-              default:
-                errno = EIO;
-                break;
+                  default:
+                    errno = EIO;
+                    break;
+                  }
+              }
+
+            if (is_opened_)
+              {
+                return result;
+              }
+
+            if (huart_->Instance != nullptr)
+              {
+                detach ();
               }
 
             // clean-up dynamic allocations, if any
             if (tx_buff_dyn_ == true)
               {
-                delete[] tx_buff_;
+                dma_buffer_free (tx_buff_, tx_buff_size_, tx_pool_);
                 tx_buff_ = nullptr;
               }
 
             if (rx_buff_dyn_ == true)
               {
-                delete[] rx_buff_;
+                dma_buffer_free (rx_buff_, rx_buff_size_, rx_pool_);
                 rx_buff_ = nullptr;
               }
           }
@@ -257,7 +329,6 @@ namespace os
           {
             open_hook ();
             is_opened_ = true;
-            result = 0;
           }
 
         return result;
@@ -267,10 +338,7 @@ namespace os
       uart_impl::do_close (void)
       {
         // wait for possible ongoing write operation to finish
-        while (huart_->gState == HAL_UART_STATE_BUSY_TX)
-          {
-            tx_sem_.wait ();
-          }
+        do_tcdrain ();
 
         if (huart_->hdmarx != nullptr || huart_->hdmatx != nullptr)
           {
@@ -285,13 +353,13 @@ namespace os
         // clean-up dynamic allocations, if any
         if (tx_buff_dyn_ == true)
           {
-            delete[] tx_buff_;
+            dma_buffer_free (tx_buff_, tx_buff_size_, tx_pool_);
             tx_buff_ = nullptr;
           }
 
         if (rx_buff_dyn_ == true)
           {
-            delete[] rx_buff_;
+            dma_buffer_free (rx_buff_, rx_buff_size_, rx_pool_);
             rx_buff_ = nullptr;
           }
 
@@ -306,6 +374,17 @@ namespace os
       {
         uint8_t* lbuf = (uint8_t*) buf;
         ssize_t count = 0;
+        bool timeout_exit = false;
+
+        if (canonical_)
+          {
+            return read_line (lbuf, nbyte);     // VMIN/VTIME don't apply
+          }
+
+        if (packet_mode_)
+          {
+            return read_frame (lbuf, nbyte, nullptr);
+          }
 
         rtos::clock::duration_t timeout =
             o_nonblock_ ? 0 : (cc_vmin_ > 0) ? 0xFFFFFFFF : rx_timeout_;
@@ -317,13 +396,20 @@ namespace os
 
         do
           {
-            while (rx_out_ == rx_in_)
+            // wait for data, or for an error to report
+            while (rx_ring_.empty () && rx_errors_.empty ())
               {
-                if (is_error_ == true)
+                if (rto_enabled_ && count > 0 && !o_nonblock_)
                   {
-                    is_error_ = false;
-                    errno = EIO;
-                    return -1;  // an error was reported, exit
+                    // the USART reports the inter-char timeout, no polling
+                    if (rx_gap_)
+                      {
+                        timeout_exit = true;
+                        break;
+                      }
+                    rx_sem_.wait ();
+                    UART_STATS (stats_.rx_wakeups++);
+                    continue;
                   }
 
                 if (rx_sem_.timed_wait (timeout) != rtos::result::ok)
@@ -332,309 +418,1098 @@ namespace os
                       {
                         // no more chars received: that means inter-char timeout,
                         // return number of chars collected, if any
+                        timeout_exit = true;
                         break;
                       }
                     last_count = get_current_count ();
                   }
+                else
+                  {
+                    UART_STATS (stats_.rx_wakeups++);
+                  }
               }
 
             // retrieve accumulated chars, if any
               {
-                while (rx_out_ != rx_in_ && count < (ssize_t) nbyte)
+                // we mask potential parity bit as HAL doesn't do
+                // it on DMA transfers
+                rx_error error;
+                size_t used;
+                rx_resync ();
+                ssize_t n = rx_pop (lbuf, nbyte - count, SIZE_MAX, count == 0,
+                                    used);
+                rx_resume ();
+                if (n < 0)
                   {
-                    rtos::interrupts::critical_section ics;  // critical section
+                    return -1;  // an error at the first character
+                  }
 
-                    // we mask potential parity bit as HAL doesn't do
-                    // it on DMA transfers
-                    *lbuf++ = rx_buff_[rx_out_] & huart_->Mask;
-                    rx_out_ = rx_out_ + 1;
-                    if (++count == 1)
-                      {
-                        // VMIN > 0, apply timeout (can be infinitum too)
-                        timeout = rx_timeout_;
-                      }
-                    if (rx_out_ >= rx_buff_size_)
-                      {
-                        rx_out_ = 0;
-                      }
+                if (n > 0 && count == 0)
+                  {
+                    // VMIN > 0, apply timeout (can be infinitum too)
+                    timeout = rx_timeout_;
+                  }
+                lbuf += n;
+                count += n;
+
+                if (count > 0 && rx_next_error (error) == 0)
+                  {
+                    break;      // the error is reported by the next read()
                   }
               }
-            if (count >= (ssize_t) nbyte)
+            if (count >= (ssize_t) nbyte || timeout_exit)
               {
                 break;
               }
           }
         while (count < cc_vmin_);
 
+#if UART_USE_LATENCY == true
+        if (count > 0)
+          {
+            rx_probe_.stop (latency_.rx_read);
+          }
+#endif
+
         return count;
       }
 
+      /**
+       * @brief  Read in canonical mode: wait for a complete line and return
+       *    it, end of line included. A line longer than nbyte, or than half
+       *    of the receive buffer (the reader is woken then, before the DMA
+       *    catches up with the data), is returned in pieces. The receive
+       *    call-back posts the semaphore only when the USART matched the
+       *    end of line, so the reader wakes once per line.
+       */
       ssize_t
-      uart_impl::do_write (const void* buf, std::size_t nbyte)
+      uart_impl::read_line (uint8_t* buf, std::size_t nbyte)
       {
-        HAL_StatusTypeDef result;
-        ssize_t count = 0;
-
-        tx_sem_.wait ();
-        memcpy (tx_buff_, buf, count = std::min (tx_buff_size_, nbyte));
+        size_t len;
 
-        // enable the rs-485 driver to send
-        do_rs485_de (true);
+        // compute mask for possible parity bit masking
+        UART_MASK_COMPUTATION(huart_);
 
-        // send the buffer, as much as we can
-        if (huart_->hdmatx == nullptr)
-          {
-            // non-DMA transfer
-            result = HAL_UART_Transmit_IT (huart_, tx_buff_, count);
-          }
-        else
+        rx_resync ();
+        while ((len = rx_line_length ()) == 0)
           {
-            // DMA transfer
-            // clean the data cache to mitigate incoherence before DMA transfers
-            // (all RAM except DTCM RAM is cached, if D-Cache is enabled)
-            if ((tx_buff_ + tx_buff_size_) >= (uint8_t*) SRAM1_BASE)
+            rx_error error;
+            if (rx_next_error (error) == 0)
               {
-                clean_dcache (tx_buff_, tx_buff_size_);
+                break;  // an error to report first
               }
-            result = HAL_UART_Transmit_DMA (huart_, tx_buff_, count);
-          }
 
-        if (result != HAL_OK)
-          {
-            count = -1;
-            switch (result)
+            len = rx_ring_.available ();
+            if (len >= nbyte || len >= rx_buff_size_ / 2)
               {
-              case HAL_BUSY:
-                errno = EBUSY;
-                break;
+                break;  // no room for the whole line, return a piece
+              }
 
-              default:
-                errno = EIO;
-                break;
+            if (o_nonblock_)
+              {
+                return 0;
               }
+            rx_sem_.wait ();
+            UART_STATS (stats_.rx_wakeups++);
+            rx_resync ();
           }
-        return count;
-      }
-
-      bool
-      uart_impl::do_is_opened (void)
-      {
-        return is_opened_;
-      }
-
-      bool
-      uart_impl::do_is_connected (void)
-      {
-        return true;      // TODO: check DCD, but where's the DCD line?
-      }
-
-      int
-      uart_impl::do_tcgetattr (struct termios* ptio)
-      {
-        // clear the termios structure
-        memset ((void*) ptio, 0, sizeof(struct termios));
 
-        // termios.h: CSIZE: CS5, CS6, CS7, CS8; ST can CS7 and CS8 only
-        // note: ST uses a normal bit for parity, must be subtracted from total
-        if (huart_->Init.Parity == UART_PARITY_NONE)
+        size_t used;
+        ssize_t count = rx_pop (buf, nbyte, std::max (len, (size_t) 1), true,
+                                used);
+        rx_scanned_ = rx_scanned_ > used ? rx_scanned_ - used : 0;
+        rx_resume ();
+        if (count <= 0)
           {
-            ptio->c_cflag =
-                huart_->Init.WordLength == UART_WORDLENGTH_9B ? 0 :
-                huart_->Init.WordLength == UART_WORDLENGTH_8B ? CS8 : CS7;
+            return count;
           }
-        else
+        len = count;
+
+#if UART_USE_LATENCY == true
+        if (len > 0)
           {
-            ptio->c_cflag =
-                huart_->Init.WordLength == UART_WORDLENGTH_9B ? CS8 :
-                huart_->Init.WordLength == UART_WORDLENGTH_8B ? CS7 : CS6;
+            rx_probe_.stop (latency_.rx_read);
           }
+#endif
 
-        // termios.h: CSTOPB: if true, two stop bits, otherwise only one
-        ptio->c_cflag |= huart_->Init.StopBits == UART_STOPBITS_2 ? CSTOPB : 0;
-
-        // termios.h: flags PARENB = parity enabled, PARODD = parity odd
-        ptio->c_cflag |= huart_->Init.Parity == UART_PARITY_NONE ? 0 : PARENB;
-        ptio->c_cflag |= huart_->Init.Parity == UART_PARITY_ODD ? PARODD : 0;
-
-        // get baud rate
-        ptio->c_ispeed = huart_->Init.BaudRate;
-        ptio->c_ospeed = huart_->Init.BaudRate;
-
-        // termios.h: CRTSCTS: we support only CTS/RTS flow control
-        ptio->c_cflag |=
-            huart_->Init.HwFlowCtl == UART_HWCONTROL_RTS_CTS ? CRTSCTS :
-            huart_->Init.HwFlowCtl == UART_HWCONTROL_RTS ? CRTS_IFLOW :
-            huart_->Init.HwFlowCtl == UART_HWCONTROL_CTS ? CCTS_OFLOW : 0;
-
-        // termios.h: retrieve supported control characters (c_cc[])
-        // we use the "spare 2" character for a fine grained delay (1 ms)
-        ptio->c_cc[VMIN] = cc_vmin_;
-        ptio->c_cc[VTIME] = cc_vtime_;
-        ptio->c_cc[VTIME_MS] = cc_vtime_milli_;
-
-        return 0;
+        return len;
       }
 
-      int
-      uart_impl::do_tcsetattr (int options, const struct termios* ptio)
+      /**
+       * @brief  Look for the end of line in the receive FIFO. Only the
+       *    characters received since the previous call are scanned.
+       * @return  Length of the first line, end of line included, or 0 if
+       *    there is no complete line yet.
+       */
+      size_t
+      uart_impl::rx_line_length (void)
       {
-        bool reinit = false;
-
-        // ST UARTs support only CS7 and CS8
-        if ((ptio->c_cflag & CSIZE) < CS7 || options > TCIOFLUSH)
+        const uint8_t* first;
+        const uint8_t* second;
+        size_t first_len, second_len;
+        const uint8_t* eol;
+        uint8_t c = cc_veol_ ? cc_veol_ : '\n';
+        size_t count = rx_ring_.peek (first, first_len, second, second_len);
+
+        if (rx_scanned_ > count)
           {
-            errno = EINVAL;
-            return -1;
+            rx_scanned_ = 0;    // the FIFO was flushed meanwhile
           }
 
-        // set parity
-        uint32_t temp32 =
-            ptio->c_cflag & PARENB ?
-                (ptio->c_cflag & PARODD ? UART_PARITY_ODD : UART_PARITY_EVEN) :
-                UART_PARITY_NONE;
-        if (temp32 != huart_->Init.Parity)
+        if (rx_scanned_ < first_len)
           {
-            huart_->Init.Parity = temp32;
-            reinit = true;
+            eol = mask_find (first + rx_scanned_, first_len - rx_scanned_, c,
+                             huart_->Mask);
+            if (eol != nullptr)
+              {
+                rx_scanned_ = eol - first;
+                return rx_scanned_ + 1;
+              }
+            rx_scanned_ = first_len;
           }
 
-        // set character size
-        if (huart_->Init.Parity == UART_PARITY_NONE)
-          {
-            // ST UARTs can't do 6 and 5 bit characters, only 7, 8 and 9
-            temp32 = (ptio->c_cflag & CSIZE) == CS8 ? //
-                UART_WORDLENGTH_8B : UART_WORDLENGTH_7B;
-          }
-        else
-          {
-            temp32 = (ptio->c_cflag & CSIZE) == CS8 ? //
-                UART_WORDLENGTH_9B : UART_WORDLENGTH_8B;
-          }
-        if (temp32 != huart_->Init.WordLength)
+        eol = mask_find (second + rx_scanned_ - first_len, count - rx_scanned_,
+                         c, huart_->Mask);
+        if (eol != nullptr)
           {
-            huart_->Init.WordLength = temp32;
-            reinit = true;
+            rx_scanned_ = first_len + (eol - second);
+            return rx_scanned_ + 1;
           }
+        rx_scanned_ = count;
+        return 0;
+      }
 
-        // set number of stop bits
-        temp32 = ptio->c_cflag & CSTOPB ? UART_STOPBITS_2 : UART_STOPBITS_1;
-        if (temp32 != huart_->Init.StopBits)
-          {
-            huart_->Init.StopBits = temp32;
-            reinit = true;
-          }
+      /**
+       * @brief  Look at the first line error queued.
+       * @return  Distance from the oldest character to the error (0 if the
+       *    error is at the oldest character, or, for an overrun alone,
+       *    before it), or SIZE_MAX if no error is queued.
+       */
+      size_t
+      uart_impl::rx_next_error (rx_error& error)
+      {
+        const uint8_t* first;
+        const uint8_t* second;
+        size_t first_len, second_len;
 
-        // set hardware flow control
-        temp32 = (ptio->c_cflag & CRTSCTS) == CRTSCTS ? UART_HWCONTROL_RTS_CTS :
-                 (ptio->c_cflag & CRTSCTS) == CRTS_IFLOW ? UART_HWCONTROL_RTS :
-                 (ptio->c_cflag & CRTSCTS) == CCTS_OFLOW ? UART_HWCONTROL_CTS :
-                 UART_HWCONTROL_NONE;
-        if (temp32 != huart_->Init.HwFlowCtl)
+        if (rx_errors_.peek (first, first_len, second, second_len)
+            < sizeof(error))
           {
-            huart_->Init.HwFlowCtl = temp32;
-            reinit = true;
+            return SIZE_MAX;
           }
 
-        // set baud rate TODO: should we really close the port if baud rate is 0?
-        temp32 = ptio->c_ispeed ? ptio->c_ispeed : ptio->c_ospeed;
-        if (temp32 != huart_->Init.BaudRate)
-          {
-            huart_->Init.BaudRate = temp32;
-            reinit = true;
-          }
+        // the descriptor may wrap around the end of the queue
+        first_len = std::min (first_len, sizeof(error));
+        memcpy (&error, first, first_len);
+        memcpy ((uint8_t*) &error + first_len, second,
+                sizeof(error) - first_len);
 
-        cc_vmin_ = ptio->c_cc[VMIN];
-        cc_vtime_ = ptio->c_cc[VTIME];
-        // we expect in the "spare 2" character the fine grained delay (1 ms)
-        cc_vtime_milli_ =
-            (ptio->c_cc[VTIME_MS] > 99) ? 99 : ptio->c_cc[VTIME_MS];
+        return (error.offset + rx_buff_size_ - rx_ring_.tail ())
+            % rx_buff_size_;
+      }
 
-        // compute rx timeout
-        if (o_nonblock_)
-          {
-            rx_timeout_ = 0;
-          }
-        else
+      /**
+       * @brief  Release the error at the oldest character, with the
+       *    character itself if it was received with the error.
+       * @return  The errors to report, HAL_UART_ERROR_* (without the
+       *    parity error if INPCK is clear: the character is kept then, as
+       *    valid).
+       */
+      uint32_t
+      uart_impl::rx_drop_error (const rx_error& error)
+      {
+        uint32_t errors = error.errors
+            & ((iflag_ & INPCK) ? ~0U : ~HAL_UART_ERROR_PE);
+
+        rx_errors_.consume (sizeof(error));
+        if ((errors & ~HAL_UART_ERROR_ORE) != 0 && !rx_ring_.empty ())
           {
-            if (cc_vtime_ == 0 && cc_vtime_milli_ == 0)
-              {
-                rx_timeout_ = 0xFFFFFFFF;
-              }
-            else
-              {
-                // VTIME is expressed in 0.1 seconds
-                rx_timeout_ = cc_vtime_ * 100 + cc_vtime_milli_;
-              }
+            rx_ring_.consume (1);
           }
+        return errors;
+      }
 
-        // evaluate the options
-        switch (options)
-          {
-          case TCSAFLUSH:
-            // flush input
-            do_tcflush (TCIFLUSH);
-            // no break, falls through
+      /**
+       * @brief  Copy the received data, up to the next line error, and
+       *    handle the error at the oldest character as termios asks: with
+       *    IGNPAR a faulty character is dropped, with PARMRK it is passed
+       *    as \377 \0 c (\377 \0 \0 for an overrun; a valid \377 is
+       *    passed as \377 \377, over two reads if only one byte fits),
+       *    otherwise it is dropped and reported with EIO, alone.
+       * @param  len: the most characters to take from the buffer.
+       * @param  report: if true and nothing was copied, an error at the
+       *    oldest character is reported, otherwise the copy stops there.
+       * @param  used: receives the number of characters taken from the
+       *    buffer.
+       * @return  Number of bytes copied, or -1 for an error (errno EIO).
+       */
+      ssize_t
+      uart_impl::rx_pop (uint8_t* buf, std::size_t nbyte, std::size_t len,
+                         bool report, std::size_t& used)
+      {
+        size_t count = 0;
+        rx_error error;
 
-          case TCSADRAIN:
-            // wait for output to be drained
-            while (huart_->gState == HAL_UART_STATE_BUSY_TX)
+        used = 0;
+        while (count < nbyte && used < len)
+          {
+            size_t n = std::min (
+                { nbyte - count, len - used, rx_next_error (error),
+                    rx_ring_.available () });
+            if (n > 0 && (iflag_ & PARMRK) == 0)
               {
-                tx_sem_.wait ();
+                n = rx_ring_.pop (buf + count, n, huart_->Mask);
+                count += n;
+                used += n;
+                continue;
               }
-          }
-
-        if (reinit)
-          {
-            HAL_StatusTypeDef result;
-
-            if ((result = HAL_UART_Abort (huart_)) == HAL_OK)
+            if (n > 0)
               {
-                // before sending the new configuration, stop the UART
-                __HAL_UART_DISABLE(huart_);
-
-                // send configuration and restart UART
-                result = UART_SetConfig (huart_);
-                if (result == HAL_OK)
+                // a valid \377 is doubled, not to be taken for a mark
+                uint8_t c = rx_buff_[rx_ring_.tail ()] & huart_->Mask;
+                if (c == 0xFF && rx_ff_split_ != rx_ring_.tail ()
+                    && nbyte - count < 2)
                   {
-                    if (huart_->hdmarx == nullptr)
+                    if (count > 0)
                       {
-                        // enable receive through UART interrupt transfers
-                        result = HAL_UART_Receive_IT (huart_, rx_buff_,
-                                                      rx_buff_size_ / 2);
-                      }
-                    else
-                      {
-                        // enable receive through DMA transfers
-                        result = HAL_UART_Receive_DMA (huart_, rx_buff_,
-                                                       rx_buff_size_);
+                        break;  // left for the next read
                       }
+                    // no room for the pair: the character stays in the
+                    // buffer, for the second \377 to be read next
+                    buf[count++] = c;
+                    rx_ff_split_ = rx_ring_.tail ();
+                    break;
+                  }
+                buf[count++] = c;
+                if (c == 0xFF && rx_ff_split_ != rx_ring_.tail ())
+                  {
+                    buf[count++] = c;
                   }
-                __HAL_UART_ENABLE(huart_);
+                rx_ff_split_ = SIZE_MAX;
+                rx_ring_.consume (1);
+                used++;
+                continue;
+              }
+            if (rx_next_error (error) != 0)
+              {
+                break;  // no more data
               }
 
-            if (result != HAL_OK)
+            // an error at the oldest character, which goes with it if
+            // its own error is checked
+            uint32_t errors = error.errors
+                & ((iflag_ & INPCK) ? ~0U : ~HAL_UART_ERROR_PE);
+            bool byte = (errors & ~HAL_UART_ERROR_ORE) != 0;
+            uint8_t c = rx_buff_[rx_ring_.tail ()] & huart_->Mask;
+            bool ignore = errors == 0
+                || ((iflag_ & IGNPAR) && (errors & ~HAL_UART_ERROR_ORE));
+            bool mark = !ignore && (iflag_ & PARMRK) && nbyte - count >= 3;
+
+            if (!ignore && !mark && (!report || count > 0))
               {
-                switch (result)
-                  {
-                  case HAL_BUSY:
-                    errno = EBUSY;
-                    break;
+                break;  // left for the next read
+              }
 
-                  default:
-                    errno = EINVAL;
-                    break;
-                  }
-                return -1;
+            rx_drop_error (error);
+            if (errors == 0)
+              {
+                continue;       // parity not checked, c is valid
+              }
+            used += byte ? 1 : 0;
+            if (ignore)
+              {
+                continue;
+              }
+            if (mark)
+              {
+                buf[count++] = 0xFF;
+                buf[count++] = 0;
+                buf[count++] = byte ? c : 0;
+                continue;
               }
+
+            errno = EIO;
+            return -1;
           }
 
-        return 0;
+        return count;
       }
 
-      int
-      uart_impl::do_tcflush (int queue_selector)
-      {
-        HAL_StatusTypeDef hal_result;
+      /**
+       * @brief  Lend the received data to the caller, without copying it:
+       *    "first" and "second" describe the data before and after the end
+       *    of the receive buffer (second.len is 0 if there is no wrap). The
+       *    data stays in the buffer until released with consume(). The call
+       *    waits for data as read() would wait for its first character.
+       * @return  Total number of bytes in the two spans (0 on timeout), or
+       *    -1 on error (errno set).
+       */
+      ssize_t
+      uart_impl::peek (rx_span& first, rx_span& second)
+      {
+        rtos::clock::duration_t timeout =
+            o_nonblock_ ? 0 : (cc_vmin_ > 0) ? 0xFFFFFFFF : rx_timeout_;
+
+        size_t last_count = get_current_count ();
+
+        // compute mask for possible parity bit masking
+        UART_MASK_COMPUTATION(huart_);
+
+        while (rx_ring_.empty () && rx_errors_.empty ())
+          {
+            if (rx_sem_.timed_wait (timeout) != rtos::result::ok)
+              {
+                if (last_count == get_current_count ())
+                  {
+                    break;      // inter-char timeout
+                  }
+                last_count = get_current_count ();
+              }
+            else
+              {
+                UART_STATS (stats_.rx_wakeups++);
+              }
+          }
+
+        first.mask = huart_->Mask;
+        second.mask = huart_->Mask;
+
+        rx_resync ();
+
+        // the data stops before the next line error; an error at the first
+        // character is reported alone, as read() does by default
+        rx_error error;
+        size_t limit = rx_next_error (error);
+        while (limit == 0)
+          {
+            if (rx_drop_error (error) != 0)
+              {
+                rx_resume ();
+                errno = EIO;
+                return -1;
+              }
+            limit = rx_next_error (error);
+          }
+
+        size_t count = rx_ring_.peek (first.data, first.len, second.data,
+                                      second.len);
+        if (count > limit)
+          {
+            count = limit;
+            second.len = count > first.len ? count - first.len : 0;
+            first.len = std::min (first.len, count);
+          }
+#if UART_USE_LATENCY == true
+        if (count > 0)
+          {
+            rx_probe_.stop (latency_.rx_read);
+          }
+#endif
+
+        return count;
+      }
+
+      /**
+       * @brief  Read one frame in packet mode (see
+       *    UART_IOCTL_SET_PACKET_MODE): wait for the next frame, as delimited
+       *    by the receive events, copy it and release it from the receive
+       *    buffer. A frame ends when the line goes idle (or, if the receiver
+       *    timeout is enabled, when the line is idle for the gap), at the end
+       *    of the buffer, or at a line error stopping the reception. A frame
+       *    longer than nbyte is truncated.
+       * @param  frame: if not nullptr, receives the frame's descriptor (with
+       *    the length received, not the one copied).
+       * @return  Number of bytes copied, 0 on timeout (VTIME, or no frame
+       *    with O_NONBLOCK), or -1 if not in packet mode (errno EINVAL).
+       */
+      ssize_t
+      uart_impl::read_frame (void* buf, std::size_t nbyte, uart_frame* frame)
+      {
+        uart_frame f;
+
+        if (!packet_mode_)
+          {
+            errno = EINVAL;
+            return -1;
+          }
+
+        // compute mask for possible parity bit masking
+        UART_MASK_COMPUTATION(huart_);
+
+        rx_resync ();
+        while (frames_.empty ())
+          {
+            if (rx_sem_.timed_wait (o_nonblock_ ? 0 : rx_timeout_)
+                != rtos::result::ok)
+              {
+                return 0;
+              }
+            UART_STATS (stats_.rx_wakeups++);
+            rx_resync ();
+          }
+
+        frames_.pop ((uint8_t*) &f, sizeof(f));
+        size_t len = std::min ((size_t) f.len, nbyte);
+        mask_copy ((uint8_t*) buf, rx_buff_ + f.offset, len, huart_->Mask);
+
+        // release the frame, with the frames before it whose descriptors
+        // were lost, if any
+        rx_ring_.consume (
+            std::min (rx_ring_.available (),
+                      (f.offset + f.len + rx_buff_size_ - rx_ring_.tail ())
+                          % rx_buff_size_));
+        rx_resume ();
+
+        if (frame != nullptr)
+          {
+            *frame = f;
+          }
+
+#if UART_USE_LATENCY == true
+        rx_probe_.stop (latency_.rx_read);
+#endif
+
+        return len;
+      }
+
+      /**
+       * @brief  Release data lent by peek().
+       * @param  nbyte: number of bytes to release, at most the total length
+       *    of the spans returned by peek().
+       * @return  0 if successful, -1 otherwise (errno set).
+       */
+      int
+      uart_impl::consume (std::size_t nbyte)
+      {
+        if (nbyte > rx_ring_.available ())
+          {
+            errno = EINVAL;
+            return -1;
+          }
+
+        rx_ring_.consume (nbyte);
+        rx_resume ();
+        return 0;
+      }
+
+      /**
+       * @brief  Append data to the transmit FIFO. The call blocks until
+       *    all the data is queued (or, if O_NONBLOCK, until the FIFO is full);
+       *    the transmission itself goes on in the background.
+       */
+      ssize_t
+      uart_impl::do_write (const void* buf, std::size_t nbyte)
+      {
+        if (nbyte & ((1U << xfer_shift_) - 1))
+          {
+            errno = EINVAL;     // 9 data bits: whole 16 bit words only
+            return -1;
+          }
+        return queue_tx ((const uint8_t*) buf, nbyte, !o_nonblock_);
+      }
+
+      /**
+       * @brief  Queue a buffer for transmission without copying it: the
+       *    DMA reads the data straight from the caller's buffer, which may
+       *    also be constant data in flash. The caller must not touch the
+       *    buffer until the driver calls cb(buf, nbyte, arg) (normally in an
+       *    interrupt context). The buffer is sent after the data already
+       *    written to the port and before the data written afterwards.
+       *    If the DMA can't use the buffer directly (e.g. it is cached
+       *    and not cache-line aligned), it is copied to the transmit FIFO and
+       *    the call-back is invoked before returning.
+       * @param  buf: buffer to send.
+       * @param  nbyte: number of bytes to send (at most 65535).
+       * @param  cb: call-back to invoke when done with the buffer, may be
+       *    nullptr.
+       * @param  arg: argument passed to the call-back.
+       * @return  nbyte if successful, -1 otherwise, with errno set (EAGAIN
+       *    if O_NONBLOCK and the previous zero-copy buffer is still pending).
+       */
+      ssize_t
+      uart_impl::submit (const void* buf, std::size_t nbyte, tx_done_t cb,
+                         void* arg)
+      {
+        if (nbyte == 0 || nbyte > 0xFFFF || (nbyte & ((1U << xfer_shift_) - 1)))
+          {
+            errno = EINVAL;
+            return -1;
+          }
+
+        if (!is_zero_copy_capable (buf, nbyte))
+          {
+            // fall back to the copy path; the buffer is free on return
+            ssize_t count = queue_tx ((const uint8_t*) buf, nbyte, true);
+            if (count >= 0 && cb != nullptr)
+              {
+                cb (buf, nbyte, arg);
+              }
+            return count;
+          }
+
+        // only one zero-copy buffer can be queued at a time
+        for (;;)
+          {
+            HAL_StatusTypeDef result = HAL_OK;
+
+              {
+                rtos::interrupts::critical_section ics; // critical section
+
+                if (zc_buff_ == nullptr)
+                  {
+                    zc_size_ = nbyte;
+                    zc_ahead_ = tx_ring_.available ();
+                    zc_cb_ = cb;
+                    zc_arg_ = arg;
+                    zc_buff_ = (const uint8_t*) buf;
+
+                    if (tx_xfer_size_ == 0)
+                      {
+                        // enable the rs-485 driver to send
+                        set_rs485_de (true);
+                        result = start_tx ();
+                      }
+
+                    if (result == HAL_OK)
+                      {
+                        return nbyte;
+                      }
+                  }
+              }
+
+            if (result != HAL_OK)
+              {
+                errno = result == HAL_BUSY ? EBUSY : EIO;
+                return -1;
+              }
+
+            if (o_nonblock_)
+              {
+                errno = EAGAIN;
+                return -1;
+              }
+            UART_STATS (uint32_t start = cycle_counter ());
+            tx_sem_.wait ();
+            UART_STATS (stats_.tx_block_cycles += cycle_counter () - start);
+          }
+      }
+
+      /**
+       * @brief  Copy data to the transmit FIFO and start the transmitter,
+       *    if idle.
+       * @param  block: if true, wait for room in the FIFO until all data is
+       *    queued, otherwise return when the FIFO is full.
+       */
+      ssize_t
+      uart_impl::queue_tx (const uint8_t* buf, std::size_t nbyte, bool block)
+      {
+        HAL_StatusTypeDef result = HAL_OK;
+        ssize_t count = 0;
+
+        while (count < (ssize_t) nbyte)
+          {
+            // find the contiguous free space of the FIFO, in whole words
+            size_t room;
+            uint8_t* ptr = tx_ring_.write_span (room);
+            room &= ~(size_t) ((1U << xfer_shift_) - 1);
+
+            if (room == 0)
+              {
+                if (!block)
+                  {
+                    break;
+                  }
+                // wait for the current transfer to free some space
+                UART_STATS (uint32_t start = cycle_counter ());
+                tx_sem_.wait ();
+                UART_STATS (stats_.tx_block_cycles += cycle_counter () - start);
+                continue;
+              }
+
+            room = std::min (room, nbyte - count);
+            memcpy (ptr, buf, room);
+
+            // clean the data cache to mitigate incoherence before DMA transfers
+            // (all RAM except DTCM RAM is cached, if D-Cache is enabled)
+            if (huart_->hdmatx != nullptr && tx_cached_)
+              {
+                clean_dcache (ptr, room);
+              }
+
+            buf += room;
+            count += room;
+            tx_ring_.produce (room);
+
+              {
+                rtos::interrupts::critical_section ics; // critical section
+
+                // if the transmitter is idle, kick it; otherwise the new data
+                // will be sent when the ongoing transfer completes
+                if (tx_xfer_size_ == 0)
+                  {
+                    // enable the rs-485 driver to send
+                    set_rs485_de (true);
+                    result = start_tx ();
+                  }
+              }
+
+            if (result != HAL_OK)
+              {
+                switch (result)
+                  {
+                  case HAL_BUSY:
+                    errno = EBUSY;
+                    break;
+
+                  default:
+                    errno = EIO;
+                    break;
+                  }
+                return -1;
+              }
+          }
+
+        if (count == 0 && nbyte > 0)
+          {
+            errno = EAGAIN;     // non-blocking and the FIFO is full
+            return -1;
+          }
+        return count;
+      }
+
+      /**
+       * @brief  Start sending the next contiguous segment of the transmit
+       *    FIFO, or the zero-copy buffer when its turn has come. Must be
+       *    called with the interrupts disabled, or from the transmit
+       *    call-back.
+       */
+      template<bool tx_dma>
+        HAL_StatusTypeDef
+        uart_impl::start_tx (void)
+        {
+          HAL_StatusTypeDef result = HAL_OK;
+
+          if (tx_break_)
+            {
+              // the data waits for the end of the break (see
+              // do_tcsendbreak ())
+              tx_xfer_size_ = 0;
+              return result;
+            }
+
+          bool zero_copy = zc_buff_ != nullptr;
+          size_t len;
+          uint8_t* ptr = (uint8_t*) tx_ring_.read_span (len);
+
+          if (zero_copy)
+            {
+              if (zc_ahead_ == 0)
+                {
+                  // the FIFO contents queued before the zero-copy buffer
+                  // are sent
+                  ptr = (uint8_t*) zc_buff_;
+                  len = zc_size_;
+                  zc_active_ = true;
+                }
+              else
+                {
+                  len = std::min (len, zc_ahead_);
+                }
+            }
+
+          tx_xfer_size_ = len;
+          if (len == 0)
+            {
+              return result;      // nothing (more) to send
+            }
+
+          UART_LATENCY (tx_probe_.stop (latency_.tx_restart));
+
+          if (!tx_dma)
+            {
+              // non-DMA transfer
+              result = HAL_UART_Transmit_IT (huart_, ptr,
+                                             tx_xfer_size_ >> xfer_shift_);
+            }
+          else if (huart_->gState == HAL_UART_STATE_BUSY_TX)
+            {
+              // streaming: the previous transfer is still on the line
+              result = stream_tx (ptr, tx_xfer_size_ >> xfer_shift_);
+            }
+          else if (tx_streaming_)
+            {
+              // first transfer of a stream: set up as the HAL does, but be
+              // called back when the DMA is done, not at the TC flag; the
+              // call-back is installed before the DMA starts, a short
+              // transfer could otherwise end in the HAL's one
+              huart_->ErrorCode = HAL_UART_ERROR_NONE;
+              huart_->gState = HAL_UART_STATE_BUSY_TX;
+              huart_->hdmatx->XferCpltCallback = dma_tx_cplt;
+              huart_->hdmatx->XferHalfCpltCallback = nullptr;
+              __HAL_UART_CLEAR_FLAG(huart_, UART_CLEAR_TCF);
+              result = stream_tx (ptr, tx_xfer_size_ >> xfer_shift_);
+              if (result != HAL_OK)
+                {
+                  __HAL_UART_DISABLE_IT(huart_, UART_IT_TC);
+                  huart_->gState = HAL_UART_STATE_READY;
+                }
+            }
+          else
+            {
+              // DMA transfer
+              result = HAL_UART_Transmit_DMA (huart_, ptr,
+                                              tx_xfer_size_ >> xfer_shift_);
+            }
+
+          if (result != HAL_OK)
+            {
+              // drop what was queued, the transmitter is unusable
+              tx_xfer_size_ = 0;
+              tx_ring_.consume (tx_ring_.available ());
+              if (zero_copy)
+                {
+                  const uint8_t* buff = zc_buff_;
+                  zc_active_ = false;
+                  zc_buff_ = nullptr;
+                  if (zc_cb_ != nullptr)
+                    {
+                      zc_cb_ (buff, zc_size_, zc_arg_);
+                    }
+                }
+            }
+          return result;
+        }
+
+      template HAL_StatusTypeDef
+      uart_impl::start_tx<false> (void);
+      template HAL_StatusTypeDef
+      uart_impl::start_tx<true> (void);
+
+      /**
+       * @brief  Chain a DMA transfer to the one just completed, in streaming
+       *    mode. The USART is still sending the last characters of the
+       *    previous transfer, so the DMA only has to feed TDR again: the
+       *    transmitter stays enabled for DMA and the line doesn't go idle
+       *    between the transfers. Also called while waiting for the TC flag
+       *    at the end of a stream, if the writer queued more data meanwhile,
+       *    and for the first transfer of a stream (see start_tx ()). The
+       *    length is in words, as for the HAL.
+       */
+      HAL_StatusTypeDef
+      uart_impl::stream_tx (uint8_t* ptr, size_t len)
+      {
+        // not the end of the stream yet
+        __HAL_UART_DISABLE_IT(huart_, UART_IT_TC);
+
+        huart_->pTxBuffPtr = ptr;
+        huart_->TxXferSize = len;
+        huart_->TxXferCount = len;
+
+        HAL_StatusTypeDef result = HAL_DMA_Start_IT (
+            huart_->hdmatx, (uint32_t) (uintptr_t) ptr,
+            (uint32_t) (uintptr_t) &huart_->Instance->TDR, len);
+        if (result == HAL_OK)
+          {
+            SET_BIT(huart_->Instance->CR3, USART_CR3_DMAT);
+          }
+        else
+          {
+            // stop the stream, the TC flag will end it
+            CLEAR_BIT(huart_->Instance->CR3, USART_CR3_DMAT);
+            __HAL_UART_ENABLE_IT(huart_, UART_IT_TC);
+          }
+        return result;
+      }
+
+      /**
+       * @brief  DMA transfer complete call-back in streaming mode, installed
+       *    instead of the HAL's one (which waits for the TC flag): like the
+       *    HAL does for a circular DMA, it calls HAL_UART_TxCpltCallback()
+       *    at once, with gState still busy.
+       */
+      void
+      uart_impl::dma_tx_cplt (DMA_HandleTypeDef* hdma)
+      {
+        UART_HandleTypeDef* huart = (UART_HandleTypeDef*) hdma->Parent;
+
+        huart->TxXferCount = 0;
+        HAL_UART_TxCpltCallback (huart);
+      }
+
+      /**
+       * @brief  Check if the DMA (if any) can send a buffer in place: the
+       *    buffer must be reachable by the DMA (i.e. not the ITCM RAM nor the
+       *    flash through the ITCM interface) and, if cached, aligned on cache
+       *    lines so that it can be cleaned without touching its neighbours.
+       *    With 9 data bits, the 16 bit words must be aligned too.
+       *    If all is fine, clean the buffer's range of the data cache.
+       */
+      bool
+      uart_impl::is_zero_copy_capable (const void* buf, std::size_t nbyte)
+      {
+        uintptr_t addr = (uintptr_t) buf;
+
+        if (xfer_shift_ != 0 && (addr & 1))
+          {
+            return false;       // the 16 bit words must be aligned
+          }
+
+        if (huart_->hdmatx == nullptr)
+          {
+            return true;        // interrupt transfers can use any buffer
+          }
+
+        if (addr < FLASHAXI_BASE)
+          {
+            return false;       // ITCM RAM or flash on ITCM bus, the DMA
+                                // can't get there
+          }
+
+        if (addr <= FLASH_END)
+          {
+            return true;        // flash on AXI bus, never dirty in the cache
+          }
+
+        if (dma_buffer_is_cached (buf, nbyte))
+          {
+            if ((addr & 0x1F) || (nbyte & 0x1F))
+              {
+                return false;
+              }
+            clean_dcache ((uint8_t*) buf, nbyte);
+          }
+        return true;
+      }
+
+      bool
+      uart_impl::do_is_opened (void)
+      {
+        return is_opened_;
+      }
+
+      bool
+      uart_impl::do_is_connected (void)
+      {
+        return true;      // TODO: check DCD, but where's the DCD line?
+      }
+
+      int
+      uart_impl::do_tcgetattr (struct termios* ptio)
+      {
+        // clear the termios structure
+        memset ((void*) ptio, 0, sizeof(struct termios));
+
+        // termios.h: CSIZE: CS5, CS6, CS7, CS8; ST can CS7 and CS8 only
+        // note: ST uses a normal bit for parity, must be subtracted from total
+        if (huart_->Init.Parity == UART_PARITY_NONE)
+          {
+            ptio->c_cflag =
+                huart_->Init.WordLength == UART_WORDLENGTH_9B ? 0 :
+                huart_->Init.WordLength == UART_WORDLENGTH_8B ? CS8 : CS7;
+          }
+        else
+          {
+            ptio->c_cflag =
+                huart_->Init.WordLength == UART_WORDLENGTH_9B ? CS8 :
+                huart_->Init.WordLength == UART_WORDLENGTH_8B ? CS7 : CS6;
+          }
+
+        // termios.h: CSTOPB: if true, two stop bits, otherwise only one
+        ptio->c_cflag |= huart_->Init.StopBits == UART_STOPBITS_2 ? CSTOPB : 0;
+
+        // termios.h: flags PARENB = parity enabled, PARODD = parity odd
+        ptio->c_cflag |= huart_->Init.Parity == UART_PARITY_NONE ? 0 : PARENB;
+        ptio->c_cflag |= huart_->Init.Parity == UART_PARITY_ODD ? PARODD : 0;
+
+        // get the baud rate the USART runs at, which differs from the one
+        // asked for by the error of the baud rate generator
+        uint32_t baud = uart_baud (
+            kernel_clock (), READ_REG(huart_->Instance->BRR),
+            READ_BIT(huart_->Instance->CR1, USART_CR1_OVER8) != 0);
+        ptio->c_ispeed = baud ? baud : huart_->Init.BaudRate;
+        ptio->c_ospeed = ptio->c_ispeed;
+
+        // termios.h: CRTSCTS: we support only CTS/RTS flow control
+        ptio->c_cflag |=
+            huart_->Init.HwFlowCtl == UART_HWCONTROL_RTS_CTS ? CRTSCTS :
+            huart_->Init.HwFlowCtl == UART_HWCONTROL_RTS ? CRTS_IFLOW :
+            huart_->Init.HwFlowCtl == UART_HWCONTROL_CTS ? CCTS_OFLOW : 0;
+
+        // termios.h: retrieve supported control characters (c_cc[])
+        // we use the "spare 2" character for a fine grained delay (1 ms)
+        ptio->c_cc[VMIN] = cc_vmin_;
+        ptio->c_cc[VTIME] = cc_vtime_;
+        ptio->c_cc[VTIME_MS] = cc_vtime_milli_;
+        ptio->c_cc[VEOL] = cc_veol_;
+
+        // termios.h: ICANON is the only local mode supported
+        ptio->c_lflag = canonical_ ? ICANON : 0;
+
+        // termios.h: how the line errors are reported (see rx_pop ())
+        ptio->c_iflag = iflag_;
+
+        return 0;
+      }
+
+      int
+      uart_impl::do_tcsetattr (int options, const struct termios* ptio)
+      {
+        UART_InitTypeDef previous = huart_->Init;
+
+        // the baud rate, with the best oversampling and BRR for the kernel
+        // clock, and the format and flow control; ST UARTs support only CS7
+        // and CS8 (see uart_make_profile ())
+        // TODO: should we really close the port if baud rate is 0?
+        uart_profile profile = make_profile (
+            ptio->c_ispeed ? ptio->c_ispeed : ptio->c_ospeed, ptio->c_cflag);
+        if (profile.brr == 0 || options > TCIOFLUSH)
+          {
+            errno = EINVAL;
+            return -1;
+          }
+
+        UART_InitTypeDef init = previous;
+        profile_init (profile, init);
+        bool reinit = init.WordLength != previous.WordLength
+            || init.Parity != previous.Parity
+            || init.OverSampling != previous.OverSampling
+            || init.StopBits != previous.StopBits
+            || init.HwFlowCtl != previous.HwFlowCtl
+            || profile.brr != READ_REG(huart_->Instance->BRR);
+
+        cc_vmin_ = ptio->c_cc[VMIN];
+        cc_vtime_ = ptio->c_cc[VTIME];
+        // we expect in the "spare 2" character the fine grained delay (1 ms)
+        cc_vtime_milli_ =
+            (ptio->c_cc[VTIME_MS] > 99) ? 99 : ptio->c_cc[VTIME_MS];
+
+        // canonical mode: read() returns lines ended by VEOL, or by '\n'
+        // if VEOL is not set (only one end of line character, matched by
+        // the USART)
+        canonical_ = (ptio->c_lflag & ICANON) != 0;
+        cc_veol_ = ptio->c_cc[VEOL];
+
+        // line errors: INPCK checks the parity, IGNPAR drops the faulty
+        // characters, PARMRK marks them in the data (see rx_pop ())
+        iflag_ = ptio->c_iflag & (IGNPAR | PARMRK | INPCK);
+
+        // compute rx timeout
+        if (o_nonblock_)
+          {
+            rx_timeout_ = 0;
+          }
+        else
+          {
+            if (cc_vtime_ == 0 && cc_vtime_milli_ == 0)
+              {
+                rx_timeout_ = 0xFFFFFFFF;
+              }
+            else
+              {
+                // VTIME is expressed in 0.1 seconds
+                rx_timeout_ = cc_vtime_ * 100 + cc_vtime_milli_;
+              }
+          }
+
+        // evaluate the options
+        switch (options)
+          {
+          case TCSAFLUSH:
+            // flush input
+            do_tcflush (TCIFLUSH);
+            // no break, falls through
+
+          case TCSADRAIN:
+            // wait for output to be drained
+            do_tcdrain ();
+          }
+
+        if (reinit)
+          {
+            HAL_StatusTypeDef result = HAL_OK;
+
+            if (data_9b (previous) == data_9b (init))
+              {
+                // the transfers keep their data width: switch between two
+                // characters, without stopping them
+                do_tcdrain ();
+                switch_config (profile);
+              }
+            else if (do_tcdrain () == 0)
+              {
+                rtos::interrupts::critical_section ics; // critical section
+
+                // keep what came since the last event (the interrupt
+                // transfer counter is cleared by the abort, the DMA one is
+                // not and stops changing)
+                size_t xfered = 0;
+                if (huart_->hdmarx == nullptr)
+                  {
+                    xfered = rx_produce (false);
+                  }
+                result = HAL_UART_Abort (huart_);
+                if (huart_->hdmarx != nullptr)
+                  {
+                    xfered = rx_produce (false);
+                  }
+                frame_len_ += xfered;
+
+                if (result == HAL_OK)
+                  {
+                    // before sending the new configuration, stop the UART
+                    __HAL_UART_DISABLE(huart_);
+
+                    // send configuration and restart UART
+                    huart_->Init = init;
+                    result = UART_SetConfig (huart_);
+                    if (result == HAL_OK)
+                      {
+                        // the nearest divider: the HAL truncates the odd
+                        // ones when sampling by 8
+                        WRITE_REG(huart_->Instance->BRR, profile.brr);
+
+                        // bytes from now (termios has no 9 data bits
+                        // without parity); receive again where the
+                        // reception was aborted
+                        set_xfer_width ();
+                        result = restart_rx ();
+                      }
+                    __HAL_UART_ENABLE(huart_);
+                  }
+                if (xfered > 0)
+                  {
+                    rx_sem_.post ();
+                  }
+              }
+
+            if (result != HAL_OK)
+              {
+                huart_->Init = previous;
+                switch (result)
+                  {
+                  case HAL_BUSY:
+                    errno = EBUSY;
+                    break;
+
+                  default:
+                    errno = EINVAL;
+                    break;
+                  }
+                return -1;
+              }
+          }
+
+        // the gap depends on VMIN/VTIME and on the character time
+        set_canonical ();
+        set_rx_gap ();
+
+        return 0;
+      }
+
+      int
+      uart_impl::do_tcflush (int queue_selector)
+      {
+        HAL_StatusTypeDef hal_result;
         int result = 0;
 
         if (queue_selector > TCIOFLUSH)
@@ -644,66 +1519,373 @@ namespace os
           }
         else
           {
-            if (huart_->hdmarx != nullptr || huart_->hdmatx != nullptr)
-              {
-                HAL_UART_DMAStop (huart_);
-              }
-
             if (queue_selector & TCIFLUSH)
               {
-                huart_->RxState = HAL_UART_STATE_READY;
+                // stop the reception only, a transmission goes on
+                HAL_UART_AbortReceive (huart_);
                 rx_sem_.reset ();
-                rx_in_ = 0;
-                rx_out_ = 0;
+                rx_ring_.reset ();
+                rx_scanned_ = 0;
+                rx_eol_late_ = false;
+                rx_errors_.reset ();
+                rx_ff_split_ = SIZE_MAX;
+                frames_.reset ();
+                frame_start_ = 0;
+                frame_len_ = 0;
+                frame_errors_ = 0;
+                rx_overrun_ = false;
               }
 
             if (queue_selector & TCOFLUSH)
               {
+                HAL_UART_AbortTransmit (huart_);
                 tx_sem_.reset ();
-                tx_in_ = 0;
-                tx_out_ = 0;
-                do_rs485_de (false);
+                tx_ring_.reset ();
+                tx_xfer_size_ = 0;
+                if (zc_buff_ != nullptr)
+                  {
+                    // give the zero-copy buffer back to its owner
+                    const uint8_t* buff = zc_buff_;
+                    zc_buff_ = nullptr;
+                    zc_active_ = false;
+                    if (zc_cb_ != nullptr)
+                      {
+                        zc_cb_ (buff, zc_size_, zc_arg_);
+                      }
+                  }
+                set_rs485_de (false);
+                drain_sem_.post ();     // let tcdrain () look again
               }
 
-            // restart receive
-            if (huart_->hdmarx == nullptr)
-              {
-                hal_result = HAL_UART_Receive_IT (huart_, rx_buff_,
-                                                  rx_buff_size_ / 2);
-              }
-            else
-              {
-                hal_result = HAL_UART_Receive_DMA (huart_, rx_buff_,
-                                                   rx_buff_size_);
-              }
-            if (hal_result != HAL_OK)
+            if (queue_selector & TCIFLUSH)
               {
-                errno = EIO;
-                result = -1;
+                // restart receive
+                hal_result = restart_rx ();
+                if (hal_result != HAL_OK)
+                  {
+                    errno = EIO;
+                    result = -1;
+                  }
               }
           }
         return result;
       }
 
+      /**
+       * @brief  Send a break, after the data already written.
+       * @param  duration: 0 for the hardware break, one character frame
+       *    long, sent by the USART on its own (the call doesn't wait for
+       *    it); otherwise the time to hold TxD low, in microseconds. If the
+       *    baud rate generator can go that slow (e.g. up to 5.4 ms with 8
+       *    data bits and a 108 MHz kernel clock), the break is a 0
+       *    character sent at the baud rate making its low part last exactly
+       *    that long, and the caller sleeps until the TC flag; a longer
+       *    break inverts the idle level of TxD for the duration, timed by
+       *    the RTOS clock (rounded up to the tick).
+       * @return  0 if successful, -1 otherwise (errno set).
+       */
       int
       uart_impl::do_tcsendbreak (int duration)
       {
-        __HAL_UART_SEND_REQ(huart_, UART_SENDBREAK_REQUEST);
-        while (__HAL_UART_GET_FLAG(huart_, UART_FLAG_SBKF))
-          ;
+        if (duration < 0)
+          {
+            errno = EINVAL;
+            return -1;
+          }
+
+        do_tcdrain ();
+        if (duration == 0)
+          {
+            __HAL_UART_SEND_REQ(huart_, UART_SENDBREAK_REQUEST);
+            return 0;
+          }
+
+        // hold what the writers queue from now until the end of the break
+        // (see start_tx ()), once the transmitter is idle
+        for (;;)
+          {
+              {
+                rtos::interrupts::critical_section ics; // critical section
+
+                tx_break_ = tx_xfer_size_ == 0
+                    && huart_->gState != HAL_UART_STATE_BUSY_TX;
+                if (tx_break_)
+                  {
+                    break;
+                  }
+                // a writer started a transfer meanwhile
+                tx_draining_ = true;
+                drain_sem_.reset ();
+              }
+            drain_sem_.wait ();
+          }
+
+        USART_TypeDef* usart = huart_->Instance;
+        uint32_t cr1 = READ_REG(usart->CR1);
+        uint32_t cr2 = READ_REG(usart->CR2);
+        uint32_t brr = READ_REG(usart->BRR);
+
+        // the low bits of a 0 character: start bit, data bits and an even
+        // parity bit (the odd one is high)
+        uint32_t bits = 1
+            + ((cr1 & USART_CR1_M0) ? 9 : (cr1 & USART_CR1_M1) ? 7 : 8)
+            - ((cr1 & USART_CR1_PS) && (cr1 & USART_CR1_PCE) ? 1 : 0);
+        uint64_t usartdiv = ((uint64_t) kernel_clock () * duration
+            + bits * 500000ULL) / (bits * 1000000ULL);
+
+        set_rs485_de (true);
+        CLEAR_BIT(usart->CR1, USART_CR1_UE);
+        if (usartdiv >= 16 && usartdiv <= 0xFFFF)
+          {
+            static uint16_t zero = 0;
+
+            // timed by the USART, 16 times oversampled (BRR is USARTDIV)
+            CLEAR_BIT(usart->CR1, USART_CR1_OVER8);
+            WRITE_REG(usart->BRR, (uint32_t) usartdiv);
+            SET_BIT(usart->CR1, USART_CR1_UE);
+            if (HAL_UART_Transmit_IT (huart_, (uint8_t*) &zero, 1) == HAL_OK)
+              {
+                // wait for the break character only, the data is held
+                for (;;)
+                  {
+                      {
+                        rtos::interrupts::critical_section ics; // critical section
+
+                        if (huart_->gState != HAL_UART_STATE_BUSY_TX)
+                          {
+                            break;
+                          }
+                        tx_draining_ = true;
+                        drain_sem_.reset ();
+                      }
+                    drain_sem_.wait ();
+                  }
+              }
+          }
+        else
+          {
+            // TxD is low while the idle level is inverted
+            SET_BIT(usart->CR2, USART_CR2_TXINV);
+            SET_BIT(usart->CR1, USART_CR1_UE);
+            rtos::sysclock.sleep_for (
+                (rtos::clock::duration_t) (((uint64_t) duration
+                    * rtos::clock_systick::frequency_hz + 999999) / 1000000)
+                    + 1);
+          }
+        CLEAR_BIT(usart->CR1, USART_CR1_UE);
+        WRITE_REG(usart->CR2, cr2);
+        WRITE_REG(usart->BRR, brr);
+        WRITE_REG(usart->CR1, cr1);
+
+        // send what the writers queued meanwhile
+        rtos::interrupts::critical_section ics; // critical section
+        tx_break_ = false;
+        if (tx_ring_.empty () && zc_buff_ == nullptr)
+          {
+            set_rs485_de (false);
+          }
+        else
+          {
+            start_tx ();
+          }
         return 0;
       }
 
       int
       uart_impl::do_vioctl (int request, std::va_list args)
       {
-        return -1;
+        switch (request)
+          {
+#if UART_USE_STATS == true
+          case UART_IOCTL_GET_STATS:
+            {
+              uart_stats* stats = va_arg (args, uart_stats*);
+
+              if (stats == nullptr)
+                {
+                  errno = EINVAL;
+                  return -1;
+                }
+
+              rtos::interrupts::critical_section ics; // critical section
+              *stats = stats_;
+              return 0;
+            }
+
+          case UART_IOCTL_RESET_STATS:
+            {
+              rtos::interrupts::critical_section ics; // critical section
+              stats_ = uart_stats ();
+              return 0;
+            }
+#endif
+
+          case UART_IOCTL_SET_RX_GAP:
+            {
+              int chars = va_arg (args, int);
+
+              if (chars < 0)
+                {
+                  errno = EINVAL;
+                  return -1;
+                }
+
+              rx_gap_chars_ = chars;
+              set_rx_gap ();
+              return 0;
+            }
+
+          case UART_IOCTL_SET_PACKET_MODE:
+            {
+              bool packet_mode = va_arg (args, int) != 0;
+
+              rtos::interrupts::critical_section ics; // critical section
+              packet_mode_ = packet_mode;
+              rx_errors_.reset ();
+              rx_ff_split_ = SIZE_MAX;
+              frames_.reset ();
+              frame_start_ = rx_ring_.head ();
+              frame_len_ = 0;
+              frame_errors_ = 0;
+              cycle_counter_enable ();  // for the frame time stamps
+              return 0;
+            }
+
+          case UART_IOCTL_SET_TX_STREAMING:
+            {
+              if (huart_->hdmatx == nullptr)
+                {
+                  errno = EINVAL;       // the interrupt path doesn't stream
+                  return -1;
+                }
+
+              // applies from the next transfer started on an idle line
+              tx_streaming_ = va_arg (args, int) != 0;
+              return 0;
+            }
+
+          case UART_IOCTL_SET_RX_OVERFLOW:
+            {
+              int policy = va_arg (args, int);
+
+              // a circular DMA can't stop short of the reader; stopping
+              // the sender needs RTS
+              if (policy < UART_RX_DROP_OLDEST || policy > UART_RX_STOP
+                  || (policy != UART_RX_DROP_OLDEST && rx_circular_)
+                  || (policy == UART_RX_STOP
+                      && !(huart_->Init.HwFlowCtl & UART_HWCONTROL_RTS)))
+                {
+                  errno = EINVAL;
+                  return -1;
+                }
+
+              rtos::interrupts::critical_section ics; // critical section
+              rx_overflow_ = policy;
+              if (!rx_circular_ && huart_->RxState == HAL_UART_STATE_BUSY_RX)
+                {
+                  // re-arm the receiver with the new limit, keeping what
+                  // came since the last event (the interrupt transfer
+                  // counter is cleared by the abort, the DMA one is not and
+                  // stops changing)
+                  size_t xfered = 0;
+                  if (huart_->hdmarx == nullptr)
+                    {
+                      xfered = rx_produce (false);
+                    }
+                  HAL_UART_AbortReceive (huart_);
+                  if (huart_->hdmarx != nullptr)
+                    {
+                      xfered = rx_produce (false);
+                    }
+                  frame_len_ += xfered;
+                  start_rx (rx_ring_.head ());
+                  if (xfered > 0)
+                    {
+                      rx_sem_.post ();
+                    }
+                }
+              return 0;
+            }
+
+          case UART_IOCTL_GET_RX_OVERFLOW:
+            {
+              uint32_t* overflows = va_arg (args, uint32_t*);
+
+              if (overflows == nullptr)
+                {
+                  errno = EINVAL;
+                  return -1;
+                }
+
+              rtos::interrupts::critical_section ics; // critical section
+              *overflows = rx_overflows_;
+              rx_overflows_ = 0;
+              return 0;
+            }
+
+          case UART_IOCTL_SET_PROFILE:
+            return set_profile (va_arg (args, const uart_profile*));
+
+#if UART_USE_LATENCY == true
+          case UART_IOCTL_GET_LATENCY:
+            {
+              uart_latency* latency = va_arg (args, uart_latency*);
+
+              if (latency == nullptr)
+                {
+                  errno = EINVAL;
+                  return -1;
+                }
+
+              rtos::interrupts::critical_section ics; // critical section
+              *latency = latency_;
+              return 0;
+            }
+
+          case UART_IOCTL_RESET_LATENCY:
+            {
+              rtos::interrupts::critical_section ics; // critical section
+              latency_ = uart_latency ();
+              return 0;
+            }
+#endif
+
+          default:
+            errno = ENOTTY;
+            return -1;
+          }
       }
 
+      /**
+       * @brief  Wait until all the data written is on the line, the last
+       *    stop bit included. The transmit call-back posts the semaphore at
+       *    the TC flag ending the transmission (see cb_tx_event ()), so the
+       *    caller wakes up at once, e.g. to turn an RS-485 bus around; the
+       *    driver enable signal is already off then.
+       */
       int
       uart_impl::do_tcdrain (void)
       {
-        return -1;      // TODO: implement
+        for (;;)
+          {
+              {
+                rtos::interrupts::critical_section ics; // critical section
+
+                if (tx_xfer_size_ == 0 && tx_ring_.empty ()
+                    && zc_buff_ == nullptr
+                    && huart_->gState != HAL_UART_STATE_BUSY_TX)
+                  {
+                    tx_draining_ = false;
+                    break;
+                  }
+                tx_draining_ = true;
+                drain_sem_.reset ();
+              }
+            drain_sem_.wait ();
+          }
+
+        UART_LATENCY (drain_probe_.stop (latency_.tx_drain));
+        return 0;
       }
 
       void
@@ -733,96 +1915,863 @@ namespace os
       }
 
       /**
-       * @brief  Transmit event call-back.
+       * @brief  Transmit event call-back. In streaming mode, it is called
+       *    when the DMA is done with a transfer (the USART still busy), and
+       *    once more at the TC flag, when the stream ends.
+       */
+      template<bool tx_dma>
+        void
+        uart_impl::cb_tx_event (void)
+        {
+          const uint8_t* zc_buff = nullptr;
+          bool streaming = huart_->gState == HAL_UART_STATE_BUSY_TX;
+
+          if (zc_active_)
+            {
+              // the zero-copy buffer is sent
+              UART_STATS (stats_.tx_bytes += zc_size_);
+              zc_buff = zc_buff_;
+              zc_active_ = false;
+              zc_buff_ = nullptr;
+            }
+          else
+            {
+              // release the segment just sent
+              UART_STATS (stats_.tx_bytes += tx_xfer_size_);
+              tx_ring_.consume (tx_xfer_size_);
+              if (zc_buff_ != nullptr)
+                {
+                  zc_ahead_ -= tx_xfer_size_;
+                }
+            }
+
+          UART_LATENCY (tx_probe_.start ());
+
+          // chain the next segment, if the writer queued more data meanwhile
+          if (start_tx<tx_dma> () != HAL_OK || tx_xfer_size_ == 0)
+            {
+              if (streaming)
+                {
+                  // let the last characters go, the TC flag ends the stream
+                  CLEAR_BIT(huart_->Instance->CR3, USART_CR3_DMAT);
+                  __HAL_UART_ENABLE_IT(huart_, UART_IT_TC);
+                }
+              else
+                {
+                  // switch off the rs-485 driver enable signal
+                  set_rs485_de (false);
+                  if (tx_draining_)
+                    {
+                      // the last stop bit is out, wake up tcdrain ()
+                      UART_LATENCY (drain_probe_.start ());
+                      drain_sem_.post ();
+                    }
+                }
+            }
+
+          if (zc_buff != nullptr && zc_cb_ != nullptr)
+            {
+              zc_cb_ (zc_buff, zc_size_, zc_arg_);
+            }
+
+          tx_sem_.post ();
+        }
+
+      template void
+      uart_impl::cb_tx_event<false> (void);
+      template void
+      uart_impl::cb_tx_event<true> (void);
+
+      /**
+       * @brief  Receive event call-back. Here are reported receive errors too.
+       *    It is also the entry for the receiver timeout: the interrupt
+       *    handler calls it with the RTOF flag still set, before
+       *    HAL_UART_IRQHandler() sees the flag as an error; and for the
+       *    character match (end of line in canonical mode), with the CMF
+       *    flag set, after HAL_UART_IRQHandler().
+       */
+      template<bool rx_dma>
+        void
+        uart_impl::cb_rx_event (bool half)
+        {
+          size_t in = rx_ring_.head ();
+
+          // the line is idle for the inter-character gap (see set_rx_gap ())
+          bool gap = __HAL_UART_GET_FLAG(huart_, UART_FLAG_RTOF);
+          if (gap)
+            {
+              __HAL_UART_CLEAR_FLAG(huart_, UART_CLEAR_RTOF);
+            }
+
+          // an end of line was received (see set_canonical ())
+          bool eol = __HAL_UART_GET_FLAG(huart_, UART_FLAG_CMF);
+          if (eol)
+            {
+              __HAL_UART_CLEAR_FLAG(huart_, UART_CLEAR_CMF);
+            }
+          // the end of line of the previous event is in memory now
+          bool late = rx_eol_late_;
+          rx_eol_late_ = false;
+          if (eol && rx_dma && __HAL_UART_GET_FLAG(huart_, UART_FLAG_RXNE))
+            {
+              // the flag rises with RXNE, the DMA hasn't moved the
+              // character to memory yet: no waiting for it here, the line
+              // ends at the next event (at the latest, the line going idle)
+              rx_eol_late_ = true;
+              eol = false;
+            }
+          eol |= late;
+
+          size_t xfered = rx_produce<rx_dma> (half);
+          bool full =
+              rx_circular_ ?
+                  in + xfered >= rx_buff_size_ :
+                  get_current_count<rx_dma> () == 0;
+          in = rx_ring_.head ();
+
+          // re-initialize system for receive
+          if (!rx_dma)
+            {
+              // for non-DMA transfer
+              if (huart_->RxXferCount == 0)
+                {
+                  start_rx<rx_dma> (in);
+                }
+            }
+          else
+            {
+              // reload DMA receive (a circular DMA goes on by itself)
+              if (!rx_circular_ && half == false
+                  && in == rx_armed_end_ % rx_buff_size_)
+                {
+                  start_rx<rx_dma> (in);
+                }
+            }
+
+          if (gap)
+            {
+              rx_gap_ = true;
+            }
+
+          if (packet_mode_)
+            {
+              // the frame ends when the line goes idle (if the receiver
+              // timeout is enabled, only when it expires, as some protocols
+              // allow short pauses within a frame) or at the end of the buffer
+              bool queued = false;
+
+              frame_len_ += xfered;
+              if (frame_start_ + frame_len_ >= rx_buff_size_)
+                {
+                  // cut at the end of the buffer, frames are contiguous
+                  size_t rest = frame_start_ + frame_len_ - rx_buff_size_;
+                  frame_len_ -= rest;
+                  queued = rx_frame_end (UART_FRAME_FULL);
+                  frame_len_ = rest;
+                }
+              if (!half && (gap || (!full && !rto_enabled_)))
+                {
+                  queued |= rx_frame_end (
+                      gap ? UART_FRAME_GAP : UART_FRAME_IDLE);
+                }
+              if (rx_paused_)
+                {
+                  // the buffer is full, the reader must release a frame
+                  queued |= rx_frame_end (UART_FRAME_FULL);
+                }
+              if (!queued && !rx_overrun_)
+                {
+                  return; // no complete frame yet, let the reader sleep
+                }
+            }
+          else if (canonical_ && !eol && !rx_overrun_
+              && rx_ring_.available () < rx_buff_size_ / 2)
+            {
+              return;     // no complete line yet, let the reader sleep
+            }
+
+          UART_LATENCY (rx_probe_.start ());
+          rx_sem_.post ();
+        }
+
+      template void
+      uart_impl::cb_rx_event<false> (bool);
+      template void
+      uart_impl::cb_rx_event<true> (bool);
+
+      /**
+       * @brief  Receive error event call-back.
        */
       void
-      uart_impl::cb_tx_event (void)
+      uart_impl::cb_rx_event_error (void)
       {
-        tx_sem_.post ();
+        if (huart_->ErrorCode == HAL_UART_ERROR_RTO)
+          {
+            // a receiver timeout, that the interrupt handler let the HAL
+            // treat as an error; the HAL aborted the reception, restart it
+            // where it stopped
+            huart_->ErrorCode = HAL_UART_ERROR_NONE;
+            rx_produce (false);
+            restart_rx ();
+            rx_gap_ = true;
+            rx_sem_.post ();
+            return;
+          }
+
+#if UART_USE_STATS == true
+        uint32_t error = huart_->ErrorCode;
+
+        stats_.overrun_errors += (error & HAL_UART_ERROR_ORE) ? 1 : 0;
+        stats_.framing_errors += (error & HAL_UART_ERROR_FE) ? 1 : 0;
+        stats_.parity_errors += (error & HAL_UART_ERROR_PE) ? 1 : 0;
+        stats_.noise_errors += (error & HAL_UART_ERROR_NE) ? 1 : 0;
+#endif
+
+        if (packet_mode_)
+          {
+            // keep the data, the errors are reported with the frame
+            frame_errors_ |= huart_->ErrorCode;
+            huart_->ErrorCode = HAL_UART_ERROR_NONE;
+            if (huart_->RxState == HAL_UART_STATE_READY)
+              {
+                // the HAL aborted the reception: end the frame and restart
+                frame_len_ += rx_produce (false);
+                rx_frame_end (UART_FRAME_ERROR);
+                restart_rx ();
+                rx_sem_.post ();
+              }
+            return;
+          }
+
+        // keep the data: the error is queued at the character received
+        // with it, to be reported when the reader gets there (see
+        // rx_pop ()); if the HAL aborted the reception, restart it here
+        uint32_t errors = huart_->ErrorCode;
+        huart_->ErrorCode = HAL_UART_ERROR_NONE;
+        rx_produce (false);
+        if (huart_->RxState == HAL_UART_STATE_READY)
+          {
+            restart_rx ();
+          }
+
+        rx_error entry;
+        if ((errors & ~HAL_UART_ERROR_ORE) == 0 || rx_ring_.empty ())
+          {
+            // an overrun alone, or the character was lost with the buffer
+            // (see restart_rx ()): mark the place of the missing data
+            entry.offset = rx_ring_.head ();
+            entry.errors = HAL_UART_ERROR_ORE;
+          }
+        else
+          {
+            entry.offset = (rx_ring_.head () + rx_buff_size_ - 1)
+                % rx_buff_size_;
+            entry.errors = errors;
+          }
+        if (rx_errors_.room () >= sizeof(entry))
+          {
+            rx_errors_.push ((const uint8_t*) &entry, sizeof(entry));
+          }
 
-        // switch off the rs-485 driver enable signal
-        do_rs485_de (false);
+        rx_sem_.post ();
       }
 
       /**
-       * @brief  Receive event call-back. Here are reported receive errors too.
+       * @brief  Interrupt handler of the USART, to be called from the
+       *    USARTx_IRQHandler() instead of HAL_UART_IRQHandler() (see
+       *    irq_service ()).
        */
       void
-      uart_impl::cb_rx_event (bool half)
+      uart_impl::irq_handler (void)
       {
-        size_t xfered;
-        size_t half_buffer_size = rx_buff_size_ / 2;
-
-        // compute the number of chars received during the last transfer
-        if (huart_->hdmarx == nullptr)
+        if (huart_->hdmarx != nullptr)
+          {
+            // the HAL handles the end of the transmission
+            irq_service<true, true> ();
+          }
+        else if (huart_->hdmatx != nullptr)
           {
-            // non-DMA transfer
-            xfered = rx_in_
-                - (rx_in_ >= half_buffer_size ? half_buffer_size : 0);
-            xfered = half_buffer_size - xfered - huart_->RxXferCount;
+            irq_service<false, true> ();
           }
         else
           {
-            // DMA transfer
-            xfered = rx_buff_size_ - rx_in_ - huart_->hdmarx->Instance->NDTR;
+            irq_service<false, false> ();
+          }
+      }
+
+      /**
+       * @brief  Move the characters received since the last event to the
+       *    receive FIFO.
+       * @return  Number of characters received.
+       */
+      template<bool rx_dma>
+        size_t
+        uart_impl::rx_produce (bool half)
+        {
+          size_t xfered;
+          size_t in = rx_ring_.head ();
+
+          // compute the number of chars received during the last transfer
+          if (rx_paused_)
+            {
+              xfered = 0; // nothing armed (see start_rx ())
+            }
+          else if (!rx_dma)
+            {
+              // non-DMA transfer
+              xfered = rx_armed_end_ - in
+                  - (huart_->RxXferCount << xfer_shift_);
+            }
+          else
+            {
+              // DMA transfer; a circular DMA wraps by itself, its position is
+              // given by NDTR only
+              size_t ndtr = huart_->hdmarx->Instance->NDTR << xfer_shift_;
+              xfered = rx_armed_end_ - in - ndtr;
+              if (rx_circular_)
+                {
+                  xfered = (2 * rx_buff_size_ - in - ndtr) % rx_buff_size_;
+                }
+
+              // invalidate the data cache only for the lines written by the
+              // DMA since the last event (all but the DTCM RAM is cached if
+              // D-Cache is enabled); the range is contiguous, as the DMA is
+              // armed up to the end of the buffer at most, unless circular.
+              if (xfered && rx_cached_)
+                {
+                  size_t first = std::min (xfered, rx_buff_size_ - in);
+                  invalidate_dcache (rx_buff_ + in, first);
+                  if (first < xfered)
+                    {
+                      invalidate_dcache (rx_buff_, xfered - first);
+                    }
+                }
+            }
+
+  #if UART_USE_STATS == true
+          stats_.rx_bytes += xfered;
+          stats_.rx_events++;
+          if (half)
+            {
+              stats_.rx_half++;
+            }
+          else if (rx_circular_ ?
+              in + xfered >= rx_buff_size_ : get_current_count<rx_dma> () == 0)
+            {
+              stats_.rx_full++;
+            }
+          else
+            {
+              stats_.rx_idle++;
+            }
+  #endif
+
+          if (xfered > 0 && (rx_overrun_ || xfered > rx_ring_.room ()))
+            {
+              // the receiver passed the reader (UART_RX_DROP_OLDEST): the
+              // oldest data is overwritten, the reader must skip to the
+              // newest (see rx_resync ())
+              UART_STATS (
+                  stats_.rx_dropped +=
+                      rx_overrun_ ? xfered : xfered - rx_ring_.room ());
+              if (!rx_overrun_)
+                {
+                  rx_overrun_ = true;
+                  rx_overflows_++;
+                  UART_STATS (stats_.rx_overflows++);
+                }
+            }
+
+          if (xfered)
+            {
+              // new characters, the line is not idle
+              rx_gap_ = false;
+            }
+
+          // update the "in" pointer on buffer (back to 0 if the transfer was
+          // complete)
+          rx_ring_.produce (xfered);
+          UART_STATS (
+              stats_.rx_high_water = std::max (
+                  stats_.rx_high_water,
+                  (uint32_t) (rx_overrun_ ?
+                      rx_ring_.capacity () : rx_ring_.available ())));
+
+          return xfered;
+        }
+
+      template size_t
+      uart_impl::rx_produce<false> (bool);
+      template size_t
+      uart_impl::rx_produce<true> (bool);
+
+      /**
+       * @brief  Queue the descriptor of the frame received since the
+       *    previous one, if not empty, and start a new frame.
+       * @return  true if a frame was queued.
+       */
+      bool
+      uart_impl::rx_frame_end (uint16_t end)
+      {
+        uart_frame frame;
+        bool queued = false;
+
+        if (frame_len_ > 0 || frame_errors_ != 0)
+          {
+            frame.offset = frame_start_;
+            frame.len = frame_len_;
+            frame.timestamp = cycle_counter ();
+            frame.errors = frame_errors_;
+            frame.end = end;
+
+            if (frames_.room () >= sizeof(frame))
+              {
+                frames_.push ((const uint8_t*) &frame, sizeof(frame));
+                UART_STATS (stats_.rx_frames++);
+                queued = true;
+              }
+            else
+              {
+                // the data is released with the next frame read
+                UART_STATS (stats_.rx_frames_dropped++);
+              }
+          }
+
+        frame_start_ = (frame_start_ + frame_len_) % rx_buff_size_;
+        frame_len_ = 0;
+        frame_errors_ = 0;
+        return queued;
+      }
+
+      /**
+       * @brief  Start receiving at a position of the buffer (the head of
+       *    the receive FIFO), up to the end of the buffer (DMA) or of its
+       *    current half (interrupts). Unless the overflow policy is
+       *    UART_RX_DROP_OLDEST, not beyond the reader either: with no room
+       *    left, the receiver is paused until the reader makes some (see
+       *    rx_resume ()); the next character waits in RDR (with RTS
+       *    deasserted if flow controlled), the following ones are lost.
+       */
+      template<bool rx_dma>
+        HAL_StatusTypeDef
+        uart_impl::start_rx (size_t from)
+        {
+          HAL_StatusTypeDef result;
+          size_t end = rx_buff_size_;
+
+          if (rx_circular_)
+            {
+              // a circular transfer always covers the whole buffer
+              result = HAL_UART_Receive_DMA (huart_, rx_buff_,
+                                             rx_buff_size_ >> xfer_shift_);
+              rx_armed_end_ = rx_buff_size_;
+              return result;
+            }
+
+          if (!rx_dma && from < rx_buff_size_ / 2)
+            {
+              end = rx_buff_size_ / 2;
+            }
+
+          if (rx_overflow_ != UART_RX_DROP_OLDEST)
+            {
+              size_t len;
+
+              rx_ring_.write_span (len);
+              end = std::min (end,
+                              from + (len & ~(size_t) ((1U << xfer_shift_) - 1)));
+              if (end == from)
+                {
+                  if (!rx_paused_)
+                    {
+                      rx_paused_ = true;
+                      UART_STATS (stats_.rx_stalls++);
+                    }
+                  rx_armed_end_ = from;
+                  CLEAR_BIT(huart_->Instance->CR1,
+                            USART_CR1_RXNEIE | USART_CR1_PEIE);
+                  CLEAR_BIT(huart_->Instance->CR3, USART_CR3_EIE);
+                  return HAL_OK;
+                }
+            }
+
+          if (rx_paused_ && __HAL_UART_GET_FLAG(huart_, UART_FLAG_ORE))
+            {
+              // characters came while paused, after the one kept in RDR
+              __HAL_UART_CLEAR_FLAG(huart_, UART_CLEAR_OREF);
+              rx_overflows_++;
+              UART_STATS (stats_.rx_overflows++);
+              frame_errors_ |= HAL_UART_ERROR_ORE;
+            }
+
+          if (!rx_dma)
+            {
+              result = HAL_UART_Receive_IT (huart_, rx_buff_ + from,
+                                            (end - from) >> xfer_shift_);
+            }
+          else
+            {
+              result = HAL_UART_Receive_DMA (huart_, rx_buff_ + from,
+                                             (end - from) >> xfer_shift_);
+            }
+          if (result == HAL_OK)
+            {
+              rx_armed_end_ = end;
+              rx_paused_ = false;
+            }
+          return result;
+        }
+
+      template HAL_StatusTypeDef
+      uart_impl::start_rx<false> (size_t);
+      template HAL_StatusTypeDef
+      uart_impl::start_rx<true> (size_t);
+
+      /**
+       * @brief  Re-arm the receiver paused on a full buffer, once the reader
+       *    has made room.
+       */
+      void
+      uart_impl::rx_resume (void)
+      {
+        if (rx_paused_)
+          {
+            rtos::interrupts::critical_section ics; // critical section
+            if (rx_paused_)
+              {
+                start_rx (rx_ring_.head ());
+              }
+          }
+      }
+
+      /**
+       * @brief  After the receiver passed the reader (see rx_produce ()),
+       *    skip to the oldest data the receiver is not overwriting: from
+       *    the end of the current transfer (of the current half, for a
+       *    circular DMA) to the newest data. Unread lines and queued frames
+       *    are dropped; the data kept forms a frame flagged with an overrun.
+       */
+      void
+      uart_impl::rx_resync (void)
+      {
+        if (!rx_overrun_)
+          {
+            return;
+          }
+
+        rtos::interrupts::critical_section ics; // critical section
+
+        size_t end = rx_armed_end_;
+        if (rx_circular_)
+          {
+            end = rx_ring_.head () < rx_buff_size_ / 2 ?
+                rx_buff_size_ / 2 : rx_buff_size_;
           }
+        rx_ring_.consume (
+            (end + rx_buff_size_ - rx_ring_.tail ()) % rx_buff_size_);
+        rx_scanned_ = 0;
+        rx_errors_.consume (rx_errors_.available ());
+        frames_.consume (frames_.available ());
+        frame_start_ = rx_ring_.tail ();
+        frame_len_ = rx_ring_.available ();
+        frame_errors_ |= HAL_UART_ERROR_ORE;
+        rx_overrun_ = false;
+      }
 
-        // update the "in" pointer on buffer
-        rx_in_ = rx_in_ + xfered;
-        if (rx_in_ >= rx_buff_size_)
+      /**
+       * @brief  Restart the reception where it stopped, after the HAL
+       *    aborted it (receiver timeout or line error seen as blocking). A
+       *    circular DMA can only restart at the beginning of the buffer:
+       *    the data not read yet, if any, is then lost.
+       */
+      HAL_StatusTypeDef
+      uart_impl::restart_rx (void)
+      {
+        if (rx_circular_ && rx_ring_.head () != 0)
           {
-            // if overflow, reset the "in" pointer, i.e. transfer was complete
-            rx_in_ = 0;
+            rx_ring_.reset ();
+            rx_overrun_ = false;
+            rx_errors_.reset ();
+            rx_ff_split_ = SIZE_MAX;
+            frames_.reset ();
+            frame_start_ = 0;
+            frame_len_ = 0;
           }
+        return start_rx (rx_ring_.head ());
+      }
+
+      /**
+       * @brief  Set the width of the transfers for the line settings of
+       *    the handle: with 9 data bits and no parity, the HAL and the DMA
+       *    move 16 bit words, and count them, not the bytes. The DMA streams
+       *    are set up again if their data size changes; the transfers must
+       *    be stopped. An empty transmit FIFO starts again at the beginning
+       *    of its buffer, so that the words are aligned.
+       */
+      void
+      uart_impl::set_xfer_width (void)
+      {
+        bool words = data_9b (huart_->Init);
+        DMA_HandleTypeDef* streams[] =
+          { huart_->hdmarx, huart_->hdmatx };
 
-        // re-initialize system for receive
-        if (huart_->hdmarx == nullptr)
+        xfer_shift_ = words ? 1 : 0;
+        for (DMA_HandleTypeDef* hdma : streams)
           {
-            // for non-DMA transfer
-            if (huart_->RxXferCount == 0)
+            if (hdma == nullptr)
+              {
+                continue;
+              }
+            uint32_t palign =
+                words ? DMA_PDATAALIGN_HALFWORD : DMA_PDATAALIGN_BYTE;
+            uint32_t malign =
+                words ? DMA_MDATAALIGN_HALFWORD : DMA_MDATAALIGN_BYTE;
+            if (hdma->Init.PeriphDataAlignment != palign
+                || hdma->Init.MemDataAlignment != malign)
               {
-                HAL_UART_Receive_IT (
-                    huart_,
-                    rx_in_ == 0 ? rx_buff_ : rx_buff_ + half_buffer_size,
-                    half_buffer_size);
+                hdma->Init.PeriphDataAlignment = palign;
+                hdma->Init.MemDataAlignment = malign;
+                HAL_DMA_Init (hdma);
               }
           }
-        else
+
+        if (tx_ring_.empty () && zc_buff_ == nullptr)
+          {
+            tx_ring_.reset ();
+          }
+      }
+
+      /**
+       * @brief  Apply the line settings of a profile (baud rate, format,
+       *    flow control) between two characters: the USART is disabled
+       *    only while BRR and CR1 to CR3 are rewritten, in a critical
+       *    section, and the DMA streams, the interrupts and the buffers are
+       *    left as they are. The caller validates the profile and drains
+       *    the transmitter first; a character being received meanwhile is
+       *    lost.
+       */
+      void
+      uart_impl::switch_config (const uart_profile& profile)
+      {
+        USART_TypeDef* usart = huart_->Instance;
+
+        rtos::interrupts::critical_section ics; // critical section
+
+        __HAL_UART_DISABLE(huart_);
+
+        // the images, computed beforehand: no HAL, no division
+        MODIFY_REG(usart->CR1,
+                   USART_CR1_M | USART_CR1_PCE | USART_CR1_PS | USART_CR1_OVER8,
+                   profile.cr1);
+        MODIFY_REG(usart->CR2, USART_CR2_STOP, profile.cr2);
+        MODIFY_REG(usart->CR3, USART_CR3_RTSE | USART_CR3_CTSE, profile.cr3);
+        WRITE_REG(usart->BRR, profile.brr);
+
+        profile_init (profile, huart_->Init);
+        UART_MASK_COMPUTATION(huart_);  // for the HAL's receive interrupt
+        __HAL_UART_ENABLE(huart_);
+      }
+
+      /**
+       * @brief  Switch to a profile (see UART_IOCTL_SET_PROFILE): wait for
+       *    the transmitter to drain, then write the register images. The
+       *    transfers go on, so their data width can't change: a profile
+       *    can't switch to or from 9 data bits without parity.
+       */
+      int
+      uart_impl::set_profile (const uart_profile* profile)
+      {
+        if (profile == nullptr || profile->brr == 0
+            || ((profile->cr1 & USART_CR1_M) == UART_WORDLENGTH_9B
+                && (profile->cr1 & USART_CR1_PCE) == 0)
+                != data_9b (huart_->Init))
           {
-            // reload DMA receive
-            // flush and clean the data cache to mitigate incoherence after
-            // DMA transfers (all but the DTCM RAM is cached if D-Cache is enabled)
-            if ((rx_buff_ + rx_buff_size_) >= (uint8_t*) SRAM1_BASE)
+            errno = EINVAL;
+            return -1;
+          }
+
+        do_tcdrain ();
+        switch_config (*profile);
+
+        // the gap is counted in character times
+        set_rx_gap ();
+        return 0;
+      }
+
+      /**
+       * @brief  Clock of the USART baud rate generator, as selected in the
+       *    RCC (USARTxSEL), found as UART_SetConfig () does.
+       * @return  The clock in Hz, or 0 if the selection is not known.
+       */
+      uint32_t
+      uart_impl::kernel_clock (void)
+      {
+        UART_ClockSourceTypeDef source = UART_CLOCKSOURCE_UNDEFINED;
+
+        UART_GETCLOCKSOURCE(huart_, source);
+        switch (source)
+          {
+          case UART_CLOCKSOURCE_PCLK1:
+            return HAL_RCC_GetPCLK1Freq ();
+          case UART_CLOCKSOURCE_PCLK2:
+            return HAL_RCC_GetPCLK2Freq ();
+          case UART_CLOCKSOURCE_HSI:
+            return HSI_VALUE;
+          case UART_CLOCKSOURCE_SYSCLK:
+            return HAL_RCC_GetSysClockFreq ();
+          case UART_CLOCKSOURCE_LSE:
+            return LSE_VALUE;
+          default:
+            return 0;
+          }
+      }
+
+      /**
+       * @brief  Compile termios settings into a profile for this port's
+       *    USART, e.g. once at startup if its clock is not known at compile
+       *    time (see uart_make_profile ()).
+       */
+      uart_profile
+      uart_impl::make_profile (uint32_t baud, tcflag_t cflag)
+      {
+        return uart_make_profile (kernel_clock (), baud, cflag);
+      }
+
+      /**
+       * @brief  Program the receiver timeout of the USART with the
+       *    inter-character gap: rx_gap_chars_ character times if set,
+       *    otherwise VTIME (+ VTIME_MS). The timeout counts from the last
+       *    stop bit and is re-started by each character, so it is used only
+       *    if VMIN > 0, when VTIME is an inter-character timer (and not in
+       *    canonical mode).
+       */
+      void
+      uart_impl::set_rx_gap (void)
+      {
+        uint32_t bits = 0;
+
+        if (cc_vmin_ > 0 && !canonical_)
+          {
+            if (rx_gap_chars_ > 0)
               {
-                invalidate_dcache (rx_buff_, rx_buff_size_);
+                // start bit + data bits (parity included) + stop bit(s)
+                uint32_t char_bits = 1
+                    + (huart_->Init.WordLength == UART_WORDLENGTH_9B ? 9 :
+                       huart_->Init.WordLength == UART_WORDLENGTH_8B ? 8 : 7)
+                    + (huart_->Init.StopBits == UART_STOPBITS_2 ? 2 : 1);
+                bits = rx_gap_chars_ * char_bits;
               }
-            if (half == false && rx_in_ == 0)
+            else
               {
-                HAL_UART_Receive_DMA (huart_, rx_buff_, rx_buff_size_);
+                bits = (uint32_t) ((uint64_t) (cc_vtime_ * 100
+                    + cc_vtime_milli_) * huart_->Init.BaudRate / 1000);
               }
           }
 
-        rx_sem_.post ();
+        rto_enabled_ = bits > 0;
+        rx_gap_ = false;
+
+        if (rto_enabled_)
+          {
+            MODIFY_REG(huart_->Instance->RTOR, USART_RTOR_RTO,
+                       std::min (bits, (uint32_t) USART_RTOR_RTO));
+            __HAL_UART_CLEAR_FLAG(huart_, UART_CLEAR_RTOF);
+            SET_BIT(huart_->Instance->CR2, USART_CR2_RTOEN);
+            __HAL_UART_ENABLE_IT(huart_, UART_IT_RTO);
+          }
+        else
+          {
+            __HAL_UART_DISABLE_IT(huart_, UART_IT_RTO);
+            CLEAR_BIT(huart_->Instance->CR2, USART_CR2_RTOEN);
+          }
       }
 
       /**
-       * @brief  Receive error event call-back.
+       * @brief  Program the character match of the USART with the end of
+       *    line in canonical mode, or disable it. The match address can
+       *    only be written with the receiver disabled, so it is switched off
+       *    for the few cycles needed, and only if the character changes.
        */
       void
-      uart_impl::cb_rx_event_error (void)
+      uart_impl::set_canonical (void)
       {
-        // handle errors (PE, FE, etc.)
-        is_error_ = true;
+        rx_scanned_ = 0;
 
-        huart_->RxState = HAL_UART_STATE_READY;
-        rx_in_ = 0;
-        rx_out_ = 0;
+        if (canonical_)
+          {
+            uint32_t add = (uint32_t) (cc_veol_ ? cc_veol_ : '\n')
+                << USART_CR2_ADD_Pos;
 
-        rx_sem_.post ();
+            if ((huart_->Instance->CR2 & (USART_CR2_ADD | USART_CR2_ADDM7))
+                != (add | USART_CR2_ADDM7))
+              {
+                uint32_t re = READ_BIT(huart_->Instance->CR1, USART_CR1_RE);
+
+                CLEAR_BIT(huart_->Instance->CR1, USART_CR1_RE);
+                MODIFY_REG(huart_->Instance->CR2,
+                           USART_CR2_ADD | USART_CR2_ADDM7,
+                           add | USART_CR2_ADDM7);
+                SET_BIT(huart_->Instance->CR1, re);
+              }
+            __HAL_UART_CLEAR_FLAG(huart_, UART_CLEAR_CMF);
+            __HAL_UART_ENABLE_IT(huart_, UART_IT_CM);
+          }
+        else
+          {
+            __HAL_UART_DISABLE_IT(huart_, UART_IT_CM);
+          }
       }
 
     } /* namespace stm32f7 */
   } /* namespace driver */
 } /* namespace os */
 
+#if UART_USE_DISPATCH == true
+
+// The HAL call-backs, for all the ports (the HAL's are weak).
+
+using os::driver::stm32f7::uart_impl;
+
+void
+HAL_UART_TxCpltCallback (UART_HandleTypeDef* huart)
+{
+  uart_impl* port = uart_impl::find (huart);
+  if (port != nullptr)
+    {
+      port->cb_tx_event ();
+    }
+}
+
+void
+HAL_UART_RxCpltCallback (UART_HandleTypeDef* huart)
+{
+  uart_impl* port = uart_impl::find (huart);
+  if (port != nullptr)
+    {
+      port->cb_rx_event (false);
+    }
+}
+
+void
+HAL_UART_RxHalfCpltCallback (UART_HandleTypeDef* huart)
+{
+  uart_impl* port = uart_impl::find (huart);
+  if (port != nullptr)
+    {
+      port->cb_rx_event (true);
+    }
+}
+
+void
+HAL_UART_ErrorCallback (UART_HandleTypeDef* huart)
+{
+  uart_impl* port = uart_impl::find (huart);
+  if (port != nullptr)
+    {
+      port->cb_rx_event_error ();
+    }
+}
+
+#endif
+
 #pragma GCC diagnostic pop
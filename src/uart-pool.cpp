@@ -0,0 +1,217 @@
+/*
+ * uart-pool.cpp
+ *
+ * Copyright (c) 2026 Lix N. Paulian (lix@paulian.net)
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom
+ * the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Created on: 16 Oct 2026 (LNP)
+ */
+
+#include <cmsis-plus/rtos/os.h>
+#include <new>
+
+#include "uart-pool.h"
+
+namespace os
+{
+  namespace driver
+  {
+    namespace stm32f7
+    {
+#if UART_DMA_POOL_SIZE > 0
+
+#if defined (UART_DMA_POOL_SECTION)
+      __attribute__((section (UART_DMA_POOL_SECTION)))
+#endif
+      alignas(dma_pool::cache_line) static uint8_t pool_region[UART_DMA_POOL_SIZE];
+
+      static dma_pool builtin_pool
+        { pool_region, sizeof(pool_region), UART_DMA_POOL_UNCACHED };
+
+      dma_pool* dma_pool::default_ = &builtin_pool;
+
+#else
+
+      dma_pool* dma_pool::default_ = nullptr;
+
+#endif
+
+      dma_pool::dma_pool (void* region, std::size_t size, bool uncached) :
+          uncached_
+            { uncached }
+      {
+        uintptr_t start = ((uintptr_t) region + cache_line - 1)
+            & ~(uintptr_t) (cache_line - 1);
+        std::size_t skip = start - (uintptr_t) region;
+
+        base_ = (uint8_t*) start;
+        nblocks_ = size > skip ? (size - skip) / block_size : 0;
+        if (nblocks_ > max_blocks)
+          {
+            nblocks_ = max_blocks;
+          }
+
+        for (uint32_t& word : map_)
+          {
+            word = 0;
+          }
+      }
+
+      /**
+       * @brief  Take the first run of free blocks large enough for "size"
+       *    bytes.
+       * @return  Pointer to the buffer, or nullptr if no run is large enough.
+       */
+      void*
+      dma_pool::allocate (std::size_t size)
+      {
+        std::size_t count = (size + block_size - 1) / block_size;
+        std::size_t run = 0;
+
+        if (count == 0)
+          {
+            return nullptr;
+          }
+
+        rtos::interrupts::critical_section ics; // critical section
+
+        for (std::size_t block = 0; block < nblocks_; block++)
+          {
+            run = test (block) ? 0 : run + 1;
+            if (run == count)
+              {
+                std::size_t first = block + 1 - count;
+                mark (first, count, true);
+                return base_ + first * block_size;
+              }
+          }
+
+        return nullptr;
+      }
+
+      void
+      dma_pool::deallocate (void* ptr, std::size_t size)
+      {
+        std::size_t first = ((uint8_t*) ptr - base_) / block_size;
+        std::size_t count = (size + block_size - 1) / block_size;
+
+        rtos::interrupts::critical_section ics; // critical section
+
+        mark (first, count, false);
+      }
+
+      std::size_t
+      dma_pool::free_blocks (void) const
+      {
+        std::size_t count = 0;
+
+        for (std::size_t block = 0; block < nblocks_; block++)
+          {
+            count += test (block) ? 0 : 1;
+          }
+
+        return count;
+      }
+
+      void
+      dma_pool::mark (std::size_t first, std::size_t count, bool used)
+      {
+        for (std::size_t block = first; block < first + count; block++)
+          {
+            if (used)
+              {
+                map_[block / 32] |= (1UL << (block % 32));
+              }
+            else
+              {
+                map_[block / 32] &= ~(1UL << (block % 32));
+              }
+          }
+      }
+
+      // ----------------------------------------------------------------------
+
+      uint8_t*
+      dma_buffer_alloc (std::size_t size, dma_pool** owner)
+      {
+        dma_pool* pool = dma_pool::get_default ();
+
+        *owner = pool;
+        if (pool != nullptr)
+          {
+            return (uint8_t*) pool->allocate (size);
+          }
+
+        // from the heap: over-allocate to align the buffer on a cache line
+        // and round it up to whole lines; the raw pointer is kept in the
+        // word just before the buffer (buff[-1]), in the padding.
+        std::size_t lines = (size + dma_pool::cache_line - 1)
+            & ~(dma_pool::cache_line - 1);
+        uint8_t* raw = new (std::nothrow) uint8_t[lines + dma_pool::cache_line
+            + sizeof(uint8_t*)];
+        if (raw == nullptr)
+          {
+            return nullptr;
+          }
+
+        uint8_t* buff = (uint8_t*) (((uintptr_t) raw + sizeof(uint8_t*)
+            + dma_pool::cache_line - 1) & ~(uintptr_t) (dma_pool::cache_line - 1));
+        ((uint8_t**) buff)[-1] = raw;
+
+        return buff;
+      }
+
+      void
+      dma_buffer_free (uint8_t* buff, std::size_t size, dma_pool* owner)
+      {
+        if (buff == nullptr)
+          {
+            return;
+          }
+
+        if (owner != nullptr)
+          {
+            owner->deallocate (buff, size);
+          }
+        else
+          {
+            delete[] ((uint8_t**) buff)[-1];
+          }
+      }
+
+      bool
+      dma_buffer_is_cached (const void* buff, std::size_t size)
+      {
+        dma_pool* pool = dma_pool::get_default ();
+
+        if (pool != nullptr && pool->owns (buff) && pool->is_uncached ())
+          {
+            return false;
+          }
+
+        return !dma_pool::is_dtcm (buff, size);
+      }
+
+    } /* namespace stm32f7 */
+  } /* namespace driver */
+} /* namespace os */
@@ -0,0 +1,278 @@
+/*
+ * test-cdc-host.cpp
+ *
+ * Copyright (c) 2026 Lix N. Paulian (lix@paulian.net)
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom
+ * the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Created on: 16 Oct 2026 (LNP)
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <mutex>
+#include <vector>
+
+#include <cmsis-plus/rtos/os.h>
+#include <cmsis-plus/diag/trace.h>
+
+#include "uart-cdc-dev.h"
+#include "usbd_cdc_if.h"
+#include "sim-uart.h"
+
+// Host version of test-cdc-dev.cpp: the simulated USB host sends blocks of
+// random size to the CDC device, which echoes them back (reading alternately
+// with read() and peek()/consume()); the echo is compared with the original. As the driver has no flow control, the host
+// waits for each echo before sending the next block, like a terminal does.
+// The exit code is non-zero on failure.
+
+using namespace os;
+using namespace os::rtos;
+using namespace os::driver::stm32f7;
+
+#define TX_BUFFER_SIZE 400
+#define RX_BUFFER_SIZE 400
+
+#define TEST_ROUNDS 200
+
+// Explicit template instantiation.
+template class posix::tty_implementable<uart_cdc_dev>;
+using my_char = posix::tty_implementable<uart_cdc_dev>;
+
+my_char cdc1
+  { "cdc1", (uint8_t) DEVICE_HS, nullptr, nullptr, (size_t) TX_BUFFER_SIZE, (size_t) RX_BUFFER_SIZE };
+
+static std::mutex echo_mx;
+static std::vector<uint8_t> echo;
+
+// with UART_USE_DISPATCH, the driver defines the call-backs itself
+#if UART_USE_DISPATCH != true
+
+int8_t
+cdc_init (USBD_HandleTypeDef* husbd)
+{
+  if (husbd->id == DEVICE_HS)
+    {
+      return cdc1.impl ().cb_init_event ();
+    }
+  return USBD_OK;
+}
+
+int8_t
+cdc_deinit (USBD_HandleTypeDef* husbd)
+{
+  if (husbd->id == DEVICE_HS)
+    {
+      return cdc1.impl ().cb_deinit_event ();
+    }
+  return USBD_OK;
+}
+
+int8_t
+cdc_control (USBD_HandleTypeDef* husbd, uint8_t cmd, uint8_t* pbuf,
+             uint16_t length)
+{
+  if (husbd->id == DEVICE_HS)
+    {
+      return cdc1.impl ().cb_control_event (cmd, pbuf, length);
+    }
+  return USBD_OK;
+}
+
+int8_t
+cdc_receive (USBD_HandleTypeDef* husbd, uint8_t* buf, uint32_t *len)
+{
+  if (husbd->id == DEVICE_HS)
+    {
+      return cdc1.impl ().cb_receive_event (buf, len);
+    }
+  return USBD_OK;
+}
+
+#endif
+
+static void
+host_receive (const uint8_t* data, size_t len,
+              void* arg __attribute__((unused)))
+{
+  std::lock_guard<std::mutex> lock
+    { echo_mx };
+  echo.insert (echo.end (), data, data + len);
+}
+
+static size_t
+echoed (void)
+{
+  std::lock_guard<std::mutex> lock
+    { echo_mx };
+  return echo.size ();
+}
+
+/**
+ * @brief Read through peek()/consume(), like a parser working in place.
+ */
+static ssize_t
+peek_read (uint8_t* buf, size_t nbyte)
+{
+  uart_cdc_dev& drv = cdc1.impl ();
+  rx_span first, second;
+  size_t count = 0;
+
+  if (drv.peek (first, second) <= 0)
+    {
+      return -1;
+    }
+
+  for (const rx_span& span :
+    { first, second })
+    {
+      size_t n = std::min (span.len, nbyte - count);
+      mask_copy (buf + count, span.data, n, span.mask);
+      count += n;
+    }
+
+  return drv.consume (count) < 0 ? -1 : (ssize_t) count;
+}
+
+int
+main (void)
+{
+  static uint8_t out[RX_BUFFER_SIZE];
+  uint8_t buffer[520];
+  bool result = true;
+  size_t total = 0;
+
+  sim_usb_set_speed (DEVICE_HS, USBD_SPEED_HIGH);
+  sim_usb_set_tx_hook (DEVICE_HS, host_receive, nullptr);
+
+  os::posix::tty* tty =
+      static_cast<os::posix::tty*> (os::posix::open ("/dev/cdc1", 0));
+  if (tty == nullptr)
+    {
+      printf ("error at open\n");
+      return 1;
+    }
+  if (uart_cdc_dev::find (&hUsbDeviceHS) != &cdc1.impl ()
+      || uart_cdc_dev::find (&hUsbDeviceFS) != nullptr)
+    {
+      printf ("wrong device found for the call-backs\n");
+      result = false;
+    }
+
+  struct termios tios;
+  tty->tcgetattr (&tios);
+  tios.c_cc[VMIN] = 1;
+  tios.c_cc[VTIME] = 0;
+  tios.c_cc[VTIME_MS] = 50;
+  tty->tcsetattr (TCSANOW, &tios);
+
+  uint64_t start = rtos::clock::now_ns ();
+
+  for (int i = 0; i < TEST_ROUNDS && result; i++)
+    {
+      size_t len = 1 + rand () % (sizeof(out) - 1);
+      size_t received = 0;
+
+      for (size_t j = 0; j < len; j++)
+        {
+          out[j] = (uint8_t) rand ();
+        }
+
+        {
+          std::lock_guard<std::mutex> lock
+            { echo_mx };
+          echo.clear ();
+        }
+      sim_usb_host_send (DEVICE_HS, out, len);
+
+      // echo the block back
+      while (received < len)
+        {
+          ssize_t count;
+          if (i % 2)
+            {
+              count = peek_read (buffer, sizeof(buffer));
+            }
+          else
+            {
+              count = tty->read (buffer, sizeof(buffer));
+            }
+          if (count <= 0)
+            {
+              printf ("error reading data (%zu of %zu bytes received)\n",
+                      received, len);
+              result = false;
+              break;
+            }
+          received += count;
+          if (tty->write (buffer, count) != count)
+            {
+              printf ("error at write\n");
+              result = false;
+              break;
+            }
+        }
+
+      // wait for the last IN packets
+      for (int k = 0; k < 100 && echoed () < received; k++)
+        {
+          sysclock.sleep_for (1);
+        }
+
+      if (result
+          && (echoed () != len || memcmp (echo.data (), out, len) != 0))
+        {
+          printf ("echo mismatch in round %d (%zu of %zu bytes)\n", i,
+                  echoed (), len);
+          result = false;
+        }
+      total += received;
+    }
+
+  uint64_t elapsed = rtos::clock::now_ns () - start;
+
+  printf ("cdc: %zu bytes echoed in %.1f ms, %.0f bytes/s\n", total,
+          elapsed / 1e6, total / (elapsed / 1e9));
+
+  uart_stats stats;
+  if (tty->ioctl (UART_IOCTL_GET_STATS, &stats) < 0
+      || stats.rx_bytes != total || stats.tx_bytes != total
+      || stats.rx_dropped != 0)
+    {
+      printf ("wrong statistics\n");
+      result = false;
+    }
+  printf ("cdc: %u rx events, %u wake-ups, high water %u bytes\n",
+          (unsigned) stats.rx_events, (unsigned) stats.rx_wakeups,
+          (unsigned) stats.rx_high_water);
+
+  if (tty->close () < 0)
+    {
+      printf ("error at close\n");
+      result = false;
+    }
+
+  printf ("%s\n", result ? "PASSED" : "FAILED");
+  return result ? 0 : 1;
+}
@@ -0,0 +1,333 @@
+/*
+ * test-ring-host.cpp
+ *
+ * Copyright (c) 2026 Lix N. Paulian (lix@paulian.net)
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom
+ * the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Created on: 16 Oct 2026 (LNP)
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <deque>
+#include <thread>
+#include <chrono>
+
+#include "uart-ring.h"
+
+// Unit test and benchmark of the single producer/single consumer ring used
+// by the drivers: random operations are checked against a reference model,
+// for compile-time and run-time sizes, with and without power of two
+// masking; then a producer and a consumer thread stream data through the
+// ring, to check the ordering and measure the throughput. The parity
+// masking copy is checked and compared with a byte loop too.
+
+using namespace os::driver::stm32f7;
+
+static int failures;
+
+#define CHECK(cond) \
+  do \
+    { \
+      if (!(cond)) \
+        { \
+          printf ("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+          failures++; \
+          return; \
+        } \
+    } \
+  while (0)
+
+template<std::size_t N>
+  static void
+  random_ops (const char* title, spsc_ring<N>& ring)
+  {
+    std::deque<uint8_t> model;
+    uint8_t next = 0;
+    uint8_t buff[128];
+
+    CHECK(ring.empty () && ring.available () == 0);
+    CHECK(ring.room () == ring.capacity ());
+
+    for (int i = 0; i < 200000; i++)
+      {
+        size_t len = rand () % (ring.size () + 3);
+        switch (rand () % 5)
+          {
+          case 0:
+            {
+              // push
+              for (size_t j = 0; j < len; j++)
+                {
+                  buff[j] = next + j;
+                }
+              size_t n = ring.push (buff, len);
+              CHECK(n == std::min (len, ring.capacity () - model.size ()));
+              for (size_t j = 0; j < n; j++)
+                {
+                  model.push_back (next++);
+                }
+              break;
+            }
+
+          case 1:
+            {
+              // fill in place
+              size_t room;
+              uint8_t* p = ring.write_span (room);
+              CHECK(room <= ring.room ());
+              CHECK(room > 0 || model.size () == ring.capacity ());
+              len = std::min (len, room);
+              for (size_t j = 0; j < len; j++)
+                {
+                  p[j] = next;
+                  model.push_back (next++);
+                }
+              ring.produce (len);
+              break;
+            }
+
+          case 2:
+            {
+              // pop
+              size_t n = ring.pop (buff, len);
+              CHECK(n == std::min (len, model.size ()));
+              for (size_t j = 0; j < n; j++)
+                {
+                  CHECK(buff[j] == model.front ());
+                  model.pop_front ();
+                }
+              break;
+            }
+
+          case 3:
+            {
+              // peek and consume
+              const uint8_t* p1;
+              const uint8_t* p2;
+              size_t l1, l2;
+              size_t n = ring.peek (p1, l1, p2, l2);
+              CHECK(n == model.size () && l1 + l2 == n);
+              for (size_t j = 0; j < n; j++)
+                {
+                  CHECK((j < l1 ? p1[j] : p2[j - l1]) == model[j]);
+                }
+              n = std::min (len, n);
+              ring.consume (n);
+              model.erase (model.begin (), model.begin () + n);
+              break;
+            }
+
+          default:
+            {
+              // contiguous read
+              size_t avail;
+              const uint8_t* p = ring.read_span (avail);
+              CHECK(avail <= model.size ());
+              CHECK(avail > 0 || model.empty ());
+              for (size_t j = 0; j < avail; j++)
+                {
+                  CHECK(p[j] == model[j]);
+                }
+              len = std::min (len, avail);
+              ring.consume (len);
+              model.erase (model.begin (), model.begin () + len);
+              break;
+            }
+          }
+
+        CHECK(ring.available () == model.size ());
+        CHECK(ring.room () == ring.capacity () - model.size ());
+      }
+
+    printf ("%s: ok\n", title);
+  }
+
+template<std::size_t N>
+  static void
+  stream (const char* title, spsc_ring<N>& ring, size_t chunk)
+  {
+    constexpr size_t total = 64 * 1024 * 1024;
+    bool ok = true;
+
+    auto start = std::chrono::steady_clock::now ();
+
+    std::thread producer
+      { [&ring, chunk]
+        {
+          uint8_t buff[4096];
+          uint8_t next = 0;
+          size_t sent = 0;
+          while (sent < total)
+            {
+              size_t len = std::min (chunk, total - sent);
+              for (size_t j = 0; j < len; j++)
+                {
+                  buff[j] = next + j;
+                }
+              size_t n = ring.push (buff, len);
+              next += n;
+              sent += n;
+              if (n == 0)
+                {
+                  std::this_thread::yield ();
+                }
+            }
+        } };
+
+    uint8_t buff[4096];
+    uint8_t expected = 0;
+    size_t received = 0;
+    while (received < total)
+      {
+        size_t n = ring.pop (buff, chunk);
+        for (size_t j = 0; j < n; j++)
+          {
+            ok &= buff[j] == expected++;
+          }
+        received += n;
+        if (n == 0)
+          {
+            std::this_thread::yield ();
+          }
+      }
+    producer.join ();
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now ()
+        - start;
+
+    if (!ok)
+      {
+        printf ("%s: data corrupted\n", title);
+        failures++;
+      }
+    else
+      {
+        printf ("%s: %zu byte chunks, %.0f MB/s\n", title, chunk,
+                total / elapsed.count () / 1e6);
+      }
+  }
+
+static void
+mask_copy_check (void)
+{
+  uint8_t src[64 + 8];
+  uint8_t dst[64 + 8];
+
+  for (size_t i = 0; i < sizeof(src); i++)
+    {
+      src[i] = (uint8_t) rand ();
+    }
+
+  for (uint8_t mask : { 0x7F, 0xFF })
+    {
+      for (size_t off = 0; off < 4; off++)
+        {
+          for (size_t n = 0; n <= 64; n++)
+            {
+              memset (dst, 0xAA, sizeof(dst));
+              mask_copy (dst + off, src + 3 - off, n, mask);
+              for (size_t i = 0; i < sizeof(dst); i++)
+                {
+                  uint8_t expected =
+                      (i >= off && i < off + n) ?
+                          src[3 - off + i - off] & mask : 0xAA;
+                  CHECK(dst[i] == expected);
+                }
+            }
+        }
+    }
+
+  printf ("mask copy: ok\n");
+}
+
+static void
+mask_copy_bench (void)
+{
+  constexpr size_t size = 4096;
+  constexpr int rounds = 20000;
+  static uint8_t src[size];
+  static uint8_t dst[size];
+  volatile uint8_t mask = 0x7F;
+
+  auto start = std::chrono::steady_clock::now ();
+  for (int r = 0; r < rounds; r++)
+    {
+      // the byte loop of the old read path
+      for (size_t i = 0; i < size; i++)
+        {
+          ((volatile uint8_t*) dst)[i] = src[i] & mask;
+        }
+    }
+  std::chrono::duration<double> bytes = std::chrono::steady_clock::now ()
+      - start;
+
+  start = std::chrono::steady_clock::now ();
+  for (int r = 0; r < rounds; r++)
+    {
+      mask_copy (dst, src, size, mask);
+      __asm__ volatile ("" : : "r" (dst) : "memory");
+    }
+  std::chrono::duration<double> words = std::chrono::steady_clock::now ()
+      - start;
+
+  printf ("mask copy: byte loop %.0f MB/s, mask_copy() %.0f MB/s\n",
+          size * rounds / bytes.count () / 1e6,
+          size * rounds / words.count () / 1e6);
+}
+
+int
+main (void)
+{
+  static spsc_ring<64> ring64;
+  static spsc_ring<13> ring13;
+  static spsc_ring<> ring16;
+  static spsc_ring<> ring10;
+  static uint8_t buff16[16];
+  static uint8_t buff10[10];
+
+  ring16.init (buff16, sizeof(buff16));
+  ring10.init (buff10, sizeof(buff10));
+
+  random_ops ("compile-time, power of two", ring64);
+  random_ops ("compile-time, other size", ring13);
+  random_ops ("run-time, power of two", ring16);
+  random_ops ("run-time, other size", ring10);
+
+  mask_copy_check ();
+  mask_copy_bench ();
+
+  static spsc_ring<4096> big;
+  static spsc_ring<> big_rt;
+  static uint8_t buff_rt[4000];
+  big_rt.init (buff_rt, sizeof(buff_rt));
+
+  stream ("stream, compile-time 4096", big, 64);
+  stream ("stream, compile-time 4096", big, 1024);
+  stream ("stream, run-time 4000", big_rt, 64);
+  stream ("stream, run-time 4000", big_rt, 1024);
+
+  printf ("%s\n", failures ? "FAILED" : "PASSED");
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,2445 @@
+/*
+ * test-uart-host.cpp
+ *
+ * Copyright (c) 2026 Lix N. Paulian (lix@paulian.net)
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom
+ * the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Created on: 16 Oct 2026 (LNP)
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <thread>
+#include <atomic>
+
+#include <cmsis-plus/rtos/os.h>
+#include <cmsis-plus/diag/trace.h>
+
+#include "uart-drv.h"
+#include "uart-static.h"
+#include "sim-uart.h"
+
+// Host version of test-uart.cpp: the UART runs on the simulated USART6
+// with TxD looped back to RxD, first interrupt driven, then through DMA.
+// Data integrity is checked and the throughput reported; the exit code is
+// non-zero on failure, so the program can run in CI.
+
+using namespace os;
+using namespace os::rtos;
+using namespace os::driver::stm32f7;
+
+UART_HandleTypeDef huart6;
+DMA_HandleTypeDef hdma_usart6_rx;
+DMA_HandleTypeDef hdma_usart6_tx;
+
+#define TX_BUFFER_SIZE 200
+#define RX_BUFFER_SIZE 200
+#define BIG_RX_BUFFER_SIZE 4096
+#define HUGE_RX_BUFFER_SIZE 32768
+
+#define TEST_BYTES 20480
+#define BLOCK_SIZE 1024
+
+alignas(32) static uint8_t out[TEST_BYTES];
+static uint8_t in[TEST_BYTES];
+
+static std::atomic<int> buffers_done;
+
+// if false, the interrupt handler leaves the receiver timeout to the HAL,
+// which reports it as an error
+static bool rto_in_handler = true;
+
+uart uart6
+  { "uart6", &huart6, nullptr, nullptr, (size_t) TX_BUFFER_SIZE, (size_t) RX_BUFFER_SIZE };
+
+// same USART, with a large receive buffer, for the ISR cost benchmark
+uart uart6b
+  { "uart6b", &huart6, nullptr, nullptr, (size_t) TX_BUFFER_SIZE, (size_t) BIG_RX_BUFFER_SIZE };
+
+// same USART, with a receive buffer large enough to ride out the host's
+// scheduling hiccups at 12 Mbaud, for the stress test
+uart uart6c
+  { "uart6c", &huart6, nullptr, nullptr, (size_t) TX_BUFFER_SIZE, (size_t) HUGE_RX_BUFFER_SIZE };
+
+// same USART, through the drivers specialized at compile time: interrupt
+// transfers, with a software driven RS-485 DE line and hooks counting the
+// calls...
+class uart6s_impl : public uart_static_impl<uart6s_impl, TX_BUFFER_SIZE,
+    BIG_RX_BUFFER_SIZE, uart_xfer::interrupt, rs485_soft>
+{
+public:
+
+  using uart_static_impl::uart_static_impl;
+
+  void
+  rs485_de (bool state)
+  {
+    de_toggles += de_state != state;
+    de_state = state;
+  }
+
+  void
+  on_open (void)
+  {
+    opens++;
+  }
+
+  void
+  on_close (void)
+  {
+    closes++;
+  }
+
+  bool de_state = false;
+  unsigned de_toggles = 0;
+  unsigned opens = 0;
+  unsigned closes = 0;
+};
+
+posix::tty_implementable<uart6s_impl> uart6s
+  { "uart6s", &huart6 };
+
+// ...and DMA transfers, without hooks
+uart_static<TX_BUFFER_SIZE, RX_BUFFER_SIZE> uart6d
+  { "uart6d", &huart6 };
+
+// receive call-back cost, measured with the DWT cycle counter
+static uint32_t rx_isr_events;
+static uint64_t rx_isr_cycles;
+static uint32_t rx_isr_max;
+
+static void
+rx_event (uart_impl* port, bool half)
+{
+  uint32_t start = DWT->CYCCNT;
+  port->cb_rx_event (half);
+  uint32_t cycles = DWT->CYCCNT - start;
+
+  rx_isr_events++;
+  rx_isr_cycles += cycles;
+  rx_isr_max = std::max (rx_isr_max, cycles);
+}
+
+void
+HAL_UART_TxCpltCallback (UART_HandleTypeDef *huart)
+{
+  // the port last opened on the USART
+  uart_impl* port = uart_impl::find (huart);
+  if (port != nullptr)
+    {
+      port->cb_tx_event ();
+    }
+}
+
+void
+HAL_UART_RxCpltCallback (UART_HandleTypeDef *huart)
+{
+  // the port last opened on the USART
+  uart_impl* port = uart_impl::find (huart);
+  if (port != nullptr)
+    {
+      rx_event (port, false);
+    }
+}
+
+void
+HAL_UART_RxHalfCpltCallback (UART_HandleTypeDef *huart)
+{
+  // the port last opened on the USART
+  uart_impl* port = uart_impl::find (huart);
+  if (port != nullptr)
+    {
+      rx_event (port, true);
+    }
+}
+
+void
+HAL_UART_ErrorCallback (UART_HandleTypeDef *huart)
+{
+  // the port last opened on the USART
+  uart_impl* port = uart_impl::find (huart);
+  if (port != nullptr)
+    {
+      port->cb_rx_event_error ();
+    }
+}
+
+void
+USART6_IRQHandler (void)
+{
+  if (rto_in_handler && __HAL_UART_GET_FLAG (&huart6, UART_FLAG_RTOF))
+    {
+      HAL_UART_RxCpltCallback (&huart6);
+    }
+  HAL_UART_IRQHandler (&huart6);
+  if (__HAL_UART_GET_FLAG (&huart6, UART_FLAG_IDLE))
+    {
+      __HAL_UART_CLEAR_IDLEFLAG (&huart6);
+      HAL_UART_RxCpltCallback (&huart6);
+    }
+  else if (__HAL_UART_GET_FLAG (&huart6, UART_FLAG_CMF)
+      && __HAL_UART_GET_IT_SOURCE (&huart6, UART_IT_CM))
+    {
+      HAL_UART_RxCpltCallback (&huart6);
+    }
+}
+
+// the driver's handler, instead of HAL_UART_IRQHandler()
+void
+USART6_driver_IRQHandler (void)
+{
+  uart_impl::find (&huart6)->irq_handler ();
+}
+
+// the interrupt handlers of the specialized drivers
+void
+USART6_static_IRQHandler (void)
+{
+  uart6s.impl ().irq_handler ();
+}
+
+void
+USART6_static_dma_IRQHandler (void)
+{
+  uart6d.impl ().irq_handler ();
+}
+
+static void
+init_handle (bool use_dma, uint32_t baud_rate)
+{
+  huart6.Instance = USART6;
+  huart6.Init.BaudRate = baud_rate;
+  huart6.Init.WordLength = UART_WORDLENGTH_8B;
+  huart6.Init.StopBits = UART_STOPBITS_1;
+  huart6.Init.Parity = UART_PARITY_NONE;
+  huart6.Init.Mode = UART_MODE_TX_RX;
+  huart6.Init.HwFlowCtl = UART_HWCONTROL_NONE;
+  huart6.Init.OverSampling = UART_OVERSAMPLING_16;
+  huart6.Init.OneBitSampling = UART_ONE_BIT_SAMPLE_DISABLE;
+  huart6.AdvancedInit.AdvFeatureInit = UART_ADVFEATURE_NO_INIT;
+
+  if (use_dma)
+    {
+      hdma_usart6_rx.Instance = DMA2_Stream1;
+      hdma_usart6_rx.Init.Mode = DMA_NORMAL;
+      hdma_usart6_rx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+      hdma_usart6_rx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+      __HAL_LINKDMA(&huart6, hdmarx, hdma_usart6_rx);
+      hdma_usart6_tx.Instance = DMA2_Stream6;
+      hdma_usart6_tx.Init.Mode = DMA_NORMAL;
+      hdma_usart6_tx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+      hdma_usart6_tx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+      __HAL_LINKDMA(&huart6, hdmatx, hdma_usart6_tx);
+    }
+  else
+    {
+      huart6.hdmarx = nullptr;
+      huart6.hdmatx = nullptr;
+    }
+}
+
+static void
+tx_done (const void* buf __attribute__((unused)),
+         std::size_t nbyte __attribute__((unused)),
+         void* arg __attribute__((unused)))
+{
+  buffers_done++;
+}
+
+/**
+ * @brief Send the test data in blocks, cycling through write(), a zero-copy
+ *      submit() and a submit() of an unaligned block (copy fall-back).
+ */
+static bool
+submit_all (os::posix::tty* tty)
+{
+  uart_impl& drv = *uart_impl::find (&huart6);
+  rtos::semaphore_binary done
+    { "done", 0 };
+  int submitted = 0;
+
+  buffers_done = 0;
+  for (size_t off = 0; off < sizeof(out); off += BLOCK_SIZE)
+    {
+      size_t k = off / BLOCK_SIZE;
+      ssize_t count;
+
+      if (off + BLOCK_SIZE >= sizeof(out))
+        {
+          // last block: wait for it on a semaphore
+          count = drv.submit (out + off, BLOCK_SIZE, done);
+          if (count != BLOCK_SIZE || done.timed_wait (1000) != result::ok)
+            {
+              return false;
+            }
+        }
+      else if (k % 3 == 0)
+        {
+          count = tty->write (out + off, BLOCK_SIZE);
+        }
+      else if (k % 3 == 1)
+        {
+          count = drv.submit (out + off, BLOCK_SIZE, tx_done, nullptr);
+          submitted++;
+        }
+      else
+        {
+          count = drv.submit (out + off, BLOCK_SIZE - 3, tx_done, nullptr);
+          submitted++;
+          if (count == BLOCK_SIZE - 3)
+            {
+              count += tty->write (out + off + BLOCK_SIZE - 3, 3);
+            }
+        }
+      if (count != BLOCK_SIZE)
+        {
+          return false;
+        }
+    }
+  return buffers_done == submitted;
+}
+
+/**
+ * @brief Read through peek()/consume(), like a parser working in place.
+ */
+static ssize_t
+peek_read (uint8_t* buf, size_t nbyte)
+{
+  uart_impl& drv = *uart_impl::find (&huart6);
+  rx_span first, second;
+  size_t count = 0;
+
+  if (drv.peek (first, second) <= 0)
+    {
+      return -1;
+    }
+
+  for (const rx_span& span :
+    { first, second })
+    {
+      size_t n = std::min (span.len, nbyte - count);
+      mask_copy (buf + count, span.data, n, span.mask);
+      count += n;
+    }
+
+  return drv.consume (count) < 0 ? -1 : (ssize_t) count;
+}
+
+#if UART_USE_LATENCY == true
+
+/**
+ * @brief Print a latency histogram, one "2^i:count" pair per non-empty
+ *      bucket, with the durations in CPU cycles.
+ */
+static void
+print_histogram (const char* title, const char* name, const uart_histogram& h)
+{
+  printf ("%s: %s latency, %u samples, avg %.1f us, max %.1f us\n  ", title,
+          name, (unsigned) h.count,
+          h.count ? h.sum / (SystemCoreClock / 1e6) / h.count : 0,
+          h.max / (SystemCoreClock / 1e6));
+  for (int i = 0; i < 32; i++)
+    {
+      if (h.bucket[i])
+        {
+          printf (" 2^%d:%u", i, (unsigned) h.bucket[i]);
+        }
+    }
+  printf ("\n");
+}
+
+#endif
+
+/**
+ * @brief Print the latency histograms, if the drivers are built with
+ *      UART_USE_LATENCY, otherwise check the request is rejected.
+ */
+static bool
+check_latency (const char* title, os::posix::tty* tty)
+{
+  uart_latency latency;
+
+#if UART_USE_LATENCY == true
+  if (tty->ioctl (UART_IOCTL_GET_LATENCY, &latency) < 0)
+    {
+      return false;
+    }
+  print_histogram (title, "rx", latency.rx_read);
+  print_histogram (title, "tx restart", latency.tx_restart);
+  return latency.rx_read.count > 0 && latency.tx_restart.count > 0;
+#else
+  if (tty->ioctl (UART_IOCTL_GET_LATENCY, &latency) < 0 && errno == ENOTTY)
+    {
+      return true;
+    }
+  printf ("%s: latency request not refused without UART_USE_LATENCY\n",
+          title);
+  return false;
+#endif
+}
+
+/**
+ * @brief Send a block of pseudo-random data through the loop-back, in
+ *      writes of at most "chunk" bytes, and check it comes back unaltered.
+ *      If chunk is 0, the zero-copy calls are used: submit_all() to send and
+ *      peek_read() to receive.
+ * @return true if successful.
+ */
+static bool
+loopback_round (const char* title, bool use_dma, uint32_t baud_rate,
+                size_t chunk, const char* path = "/dev/uart6")
+{
+  bool result = true;
+  ssize_t total = 0;
+
+  init_handle (use_dma, baud_rate);
+  sim_uart_loopback (USART6, true);
+
+  for (size_t i = 0; i < sizeof(out); i++)
+    {
+      out[i] = (uint8_t) rand ();
+    }
+
+  os::posix::tty* tty =
+      static_cast<os::posix::tty*> (os::posix::open (path, 0));
+  if (tty == nullptr)
+    {
+      printf ("%s: error at open\n", title);
+      return false;
+    }
+
+  struct termios tios;
+  tty->tcgetattr (&tios);
+  tios.c_cc[VMIN] = 1;
+  tios.c_cc[VTIME] = 0;
+  tios.c_cc[VTIME_MS] = 50;
+  tty->tcsetattr (TCSANOW, &tios);
+  tty->ioctl (UART_IOCTL_RESET_STATS);
+  tty->ioctl (UART_IOCTL_RESET_LATENCY);
+
+  sim_uart_stats before;
+  sim_uart_get_stats (USART6, &before);
+  uint64_t start = rtos::clock::now_ns ();
+
+  std::thread writer
+    { [tty, chunk, &result]
+      {
+        size_t sent = 0;
+        if (chunk == 0)
+          {
+            result = submit_all (tty);
+            return;
+          }
+        while (sent < sizeof(out))
+          {
+            ssize_t count = tty->write (out + sent,
+                                        std::min (chunk, sizeof(out) - sent));
+            if (count < 0)
+              {
+                break;
+              }
+            sent += count;
+          }
+      } };
+
+  while (total < (ssize_t) sizeof(in))
+    {
+      ssize_t count;
+      if (chunk == 0)
+        {
+          count = peek_read (in + total, sizeof(in) - total);
+        }
+      else
+        {
+          count = tty->read (in + total, sizeof(in) - total);
+        }
+      if (count <= 0)
+        {
+          break;
+        }
+      total += count;
+    }
+
+  writer.join ();
+
+  uint64_t elapsed = rtos::clock::now_ns () - start;
+
+  if (total != (ssize_t) sizeof(in) || memcmp (in, out, sizeof(in)) != 0)
+    {
+      printf ("%s: data mismatch (%zd of %zu bytes received)\n", title, total,
+              sizeof(in));
+      result = false;
+    }
+
+  sim_uart_stats stats;
+  sim_uart_get_stats (USART6, &stats);
+  printf ("%s: %u baud, %zd bytes in %.1f ms, %.0f bytes/s, "
+          "%llu overruns, %llu irqs\n",
+          title, (unsigned) sim_uart_get_baud (USART6), total, elapsed / 1e6,
+          total / (elapsed / 1e9),
+          (unsigned long long) (stats.rx_overruns - before.rx_overruns),
+          (unsigned long long) (stats.irqs - before.irqs));
+
+  uart_stats drv_stats;
+  if (tty->ioctl (UART_IOCTL_GET_STATS, &drv_stats) < 0
+      || drv_stats.rx_bytes != (uint64_t) total
+      || drv_stats.tx_bytes != sizeof(out)
+      || drv_stats.rx_events
+          != drv_stats.rx_idle + drv_stats.rx_half + drv_stats.rx_full)
+    {
+      printf ("%s: wrong statistics\n", title);
+      result = false;
+    }
+  printf ("%s: %u rx events (%u idle, %u half, %u full), %u wake-ups, "
+          "high water %u bytes, write() blocked %.1f ms\n",
+          title, (unsigned) drv_stats.rx_events, (unsigned) drv_stats.rx_idle,
+          (unsigned) drv_stats.rx_half, (unsigned) drv_stats.rx_full,
+          (unsigned) drv_stats.rx_wakeups, (unsigned) drv_stats.rx_high_water,
+          drv_stats.tx_block_cycles / (SystemCoreClock / 1e3));
+  result &= check_latency (title, tty);
+
+  if (tty->close () < 0)
+    {
+      printf ("%s: error at close\n", title);
+      result = false;
+    }
+
+  return result;
+}
+
+/**
+ * @brief Send the test data through DMA in writes of "chunk" bytes, with
+ *      the transfers chained from the transmit complete call-back (at the TC
+ *      flag) or, in streaming mode, from the DMA interrupt, and report the
+ *      character times TxD idled between the transfers.
+ */
+static bool
+tx_stream_round (const char* title, bool streaming, size_t chunk)
+{
+  bool result = true;
+  ssize_t total = 0;
+
+  init_handle (true, 921600);
+  sim_uart_loopback (USART6, true);
+
+  for (size_t i = 0; i < sizeof(out); i++)
+    {
+      out[i] = (uint8_t) rand ();
+    }
+
+  os::posix::tty* tty =
+      static_cast<os::posix::tty*> (os::posix::open ("/dev/uart6", 0));
+  if (tty == nullptr)
+    {
+      printf ("%s: error at open\n", title);
+      return false;
+    }
+  result &= tty->ioctl (UART_IOCTL_SET_TX_STREAMING, streaming) == 0;
+
+  sim_uart_stats before;
+  sim_uart_get_stats (USART6, &before);
+
+  std::thread writer
+    { [tty, chunk]
+      {
+        for (size_t sent = 0; sent < sizeof(out);)
+          {
+            ssize_t count = tty->write (out + sent,
+                                        std::min (chunk, sizeof(out) - sent));
+            if (count < 0)
+              {
+                break;
+              }
+            sent += count;
+          }
+      } };
+
+  while (total < (ssize_t) sizeof(in))
+    {
+      ssize_t count = tty->read (in + total, sizeof(in) - total);
+      if (count <= 0)
+        {
+          break;
+        }
+      total += count;
+    }
+  writer.join ();
+
+  sim_uart_stats stats;
+  sim_uart_get_stats (USART6, &stats);
+  uint64_t stalls = stats.tx_stall_slots - before.tx_stall_slots;
+  double char_us = 10 * 1e6 / sim_uart_get_baud (USART6);
+
+  if (total != (ssize_t) sizeof(in) || memcmp (in, out, sizeof(in)) != 0)
+    {
+      printf ("%s: data mismatch (%zd of %zu bytes received)\n", title, total,
+              sizeof(in));
+      result = false;
+    }
+
+  // chained from the DMA interrupt, the line must never idle
+  result &= !streaming || stalls == 0;
+  printf ("%s: %zd bytes, %llu idle character times between transfers "
+          "(%.1f us), %s\n",
+          title, total, (unsigned long long) stalls, stalls * char_us,
+          result ? "ok" : "failed");
+
+  tty->ioctl (UART_IOCTL_SET_TX_STREAMING, 0);
+  tty->close ();
+  return result;
+}
+
+// time the last character left TxD, from the transmit hook
+static std::atomic<uint32_t> tx_last_cycles;
+static std::atomic<uint32_t> tx_chars;
+
+static void
+drain_hook (uint16_t c __attribute__((unused)),
+            void* arg __attribute__((unused)))
+{
+  tx_last_cycles = DWT->CYCCNT;
+  tx_chars++;
+}
+
+/**
+ * @brief Send short messages, each followed by tcdrain(), as an RS-485
+ *      master does before turning the bus around: tcdrain() must return
+ *      only when the last character is on the line, and then without
+ *      delay. The turnaround is the time from the end of the last stop bit
+ *      to tcdrain() returning.
+ */
+static bool
+drain_round (const char* title, bool use_dma, bool streaming)
+{
+  static const size_t rounds = 20;
+  uint8_t msg[24];
+  double sum = 0, max = 0;
+  bool result = true;
+
+  init_handle (use_dma, 115200);
+  sim_uart_loopback (USART6, false);
+  sim_uart_set_tx_hook (USART6, drain_hook, nullptr);
+
+  os::posix::tty* tty =
+      static_cast<os::posix::tty*> (os::posix::open ("/dev/uart6", 0));
+  if (tty == nullptr)
+    {
+      printf ("%s: error at open\n", title);
+      return false;
+    }
+  result &= !use_dma || tty->ioctl (UART_IOCTL_SET_TX_STREAMING, streaming) == 0;
+  tty->ioctl (UART_IOCTL_RESET_LATENCY);
+
+  // nothing to wait for on an idle port
+  result &= tty->tcdrain () == 0;
+
+  for (size_t i = 0; i < rounds; i++)
+    {
+      for (size_t j = 0; j < sizeof(msg); j++)
+        {
+          msg[j] = (uint8_t) (i + j);
+        }
+      tx_chars = 0;
+      result &= tty->write (msg, sizeof(msg)) == (ssize_t) sizeof(msg);
+      result &= tty->tcdrain () == 0;
+      uint32_t now = DWT->CYCCNT;
+
+      result &= tx_chars == sizeof(msg)
+          && __HAL_UART_GET_FLAG(&huart6, UART_FLAG_TC);
+      double us = (uint32_t) (now - tx_last_cycles) / (SystemCoreClock / 1e6);
+      sum += us;
+      max = us > max ? us : max;
+    }
+
+#if UART_USE_LATENCY == true
+  uart_latency latency;
+  tty->ioctl (UART_IOCTL_GET_LATENCY, &latency);
+  print_histogram (title, "tx drain", latency.tx_drain);
+  result &= latency.tx_drain.count == rounds;
+#endif
+
+  printf ("%s: %zu messages, turnaround avg %.1f us, max %.1f us "
+          "(a character is %.1f us), %s\n",
+          title, rounds, sum / rounds, max, 10 * 1e6 / 115200,
+          result ? "ok" : "failed");
+
+  sim_uart_set_tx_hook (USART6, nullptr, nullptr);
+  tty->ioctl (UART_IOCTL_SET_TX_STREAMING, 0);
+  tty->close ();
+  return result;
+}
+
+/**
+ * @brief Flush a queue while a long message is being sent at 9600 baud on
+ *      the loop-back: TCIFLUSH must leave the transmission alone (the whole
+ *      message is sent, tcdrain() returns and the rest of it is received),
+ *      TCOFLUSH must drop what is not sent yet, tcdrain() must return at
+ *      once and the next write() must be sent.
+ */
+static bool
+flush_round (const char* title, bool use_dma)
+{
+  uint8_t msg[150];
+  uint8_t buf[sizeof(msg)];
+  size_t received = 0;
+  bool result = true;
+
+  init_handle (use_dma, 9600);
+  sim_uart_loopback (USART6, true);
+  sim_uart_set_tx_hook (USART6, drain_hook, nullptr);
+
+  os::posix::tty* tty =
+      static_cast<os::posix::tty*> (os::posix::open ("/dev/uart6", 0));
+  if (tty == nullptr)
+    {
+      printf ("%s: error at open\n", title);
+      return false;
+    }
+
+  // return what is there, or 0 after 100 ms without data
+  struct termios tios;
+  tty->tcgetattr (&tios);
+  tios.c_cc[VMIN] = 0;
+  tios.c_cc[VTIME] = 1;
+  tty->tcsetattr (TCSANOW, &tios);
+
+  for (size_t j = 0; j < sizeof(msg); j++)
+    {
+      msg[j] = (uint8_t) (j * 7);
+    }
+
+  tx_chars = 0;
+  result &= tty->write (msg, sizeof(msg)) == (ssize_t) sizeof(msg);
+  sysclock.sleep_for (20);
+  result &= tty->tcflush (TCIFLUSH) == 0;
+  result &= tty->tcdrain () == 0;
+  uint32_t sent = tx_chars;
+  result &= sent == sizeof(msg);
+
+  ssize_t count;
+  while (received < sizeof(buf)
+      && (count = tty->read (buf + received, sizeof(buf) - received)) > 0)
+    {
+      received += count;
+    }
+  result &= received > sizeof(msg) / 2 && received < sizeof(msg)
+      && memcmp (buf, msg + sizeof(msg) - received, received) == 0;
+
+  tx_chars = 0;
+  result &= tty->write (msg, sizeof(msg)) == (ssize_t) sizeof(msg);
+  sysclock.sleep_for (20);
+  result &= tty->tcflush (TCOFLUSH) == 0;
+  result &= tty->tcdrain () == 0;
+  sysclock.sleep_for (5);        // the characters in the USART go out
+  uint32_t dropped = sizeof(msg) - tx_chars;
+  result &= dropped > sizeof(msg) / 2;
+
+  tx_chars = 0;
+  result &= tty->write (msg, 10) == 10;
+  result &= tty->tcdrain () == 0;
+  result &= tx_chars == 10;
+
+  printf ("%s: TCIFLUSH %u of %zu sent, %zu received after it; TCOFLUSH %u "
+          "dropped, %s\n",
+          title, (unsigned) sent, sizeof(msg), received, (unsigned) dropped,
+          result ? "ok" : "failed");
+
+  sim_uart_set_tx_hook (USART6, nullptr, nullptr);
+  tty->tcflush (TCIOFLUSH);
+  tty->close ();
+  return result;
+}
+
+// characters and breaks leaving TxD, with the baud rate of the last 0; the
+// hook's argument counts the data characters sent while TxD is inverted
+static std::atomic<uint32_t> brk_slots;
+static std::atomic<uint32_t> brk_zero_baud;
+static std::atomic<uint32_t> brk_chars;
+static std::atomic<uint32_t> brk_inverted;
+
+static void
+break_hook (uint16_t c, void* arg)
+{
+  if (c == 0x100)
+    {
+      brk_slots++;
+      return;
+    }
+  if (c == 0)
+    {
+      brk_zero_baud = sim_uart_get_baud (USART6);
+    }
+  else if (USART6->CR2 & USART_CR2_TXINV)
+    {
+      (*static_cast<std::atomic<uint32_t>*> (arg))++;
+    }
+  brk_chars++;
+}
+
+/**
+ * @brief Send breaks: the one character hardware break, a short break timed
+ *      by the USART (its low part must last the duration, to the baud rate
+ *      generator's resolution) and a long one timed by the RTOS clock; the
+ *      port must then send at its baud rate again. A write() during the long
+ *      break must wait for its end.
+ */
+static bool
+break_round (const char* title, bool use_dma)
+{
+  static const uint8_t msg[] = "ab";
+  static const int short_us = 500;
+  static const int long_us = 20000;
+  bool result = true;
+
+  init_handle (use_dma, 115200);
+  sim_uart_loopback (USART6, false);
+  sim_uart_set_tx_hook (USART6, break_hook, &brk_inverted);
+  brk_slots = 0;
+  brk_chars = 0;
+  brk_zero_baud = 0;
+  brk_inverted = 0;
+
+  os::posix::tty* tty =
+      static_cast<os::posix::tty*> (os::posix::open ("/dev/uart6", 0));
+  if (tty == nullptr)
+    {
+      printf ("%s: error at open\n", title);
+      return false;
+    }
+
+  uint32_t baud = sim_uart_get_baud (USART6);
+  result &= tty->tcsendbreak (-1) < 0 && errno == EINVAL;
+  result &= tty->tcsendbreak (0) == 0;
+  sysclock.sleep_for (5);
+  result &= brk_slots == 1;
+
+  // after the data, 9 bits low (start + 8 data bits) at the break's baud
+  tty->write (msg, sizeof(msg) - 1);
+  uint32_t start = DWT->CYCCNT;
+  result &= tty->tcsendbreak (short_us) == 0;
+  double short_call = (uint32_t) (DWT->CYCCNT - start)
+      / (SystemCoreClock / 1e6);
+  double low_us = brk_zero_baud ? 9 * 1e6 / brk_zero_baud : 0;
+  result &= brk_chars == 3 && low_us > short_us * 0.995
+      && low_us < short_us * 1.005 && short_call >= short_us;
+  result &= sim_uart_get_baud (USART6) == baud;
+
+  brk_slots = 0;
+  start = DWT->CYCCNT;
+  std::thread writer
+    { [tty]
+      {
+        // in the middle of the break
+        std::this_thread::sleep_for (
+            std::chrono::microseconds (long_us / 2));
+        tty->write (msg, sizeof(msg) - 1);
+      } };
+  result &= tty->tcsendbreak (long_us) == 0;
+  double long_call = (uint32_t) (DWT->CYCCNT - start)
+      / (SystemCoreClock / 1e6);
+  writer.join ();
+  uint32_t slots = brk_slots;
+  result &= long_call >= long_us && long_call < long_us + 10000
+      && slots > 0;
+
+  // TxD is back to normal, the data written during the break went out
+  // after it
+  tty->write (msg, sizeof(msg) - 1);
+  tty->tcdrain ();
+  sysclock.sleep_for (2);
+  result &= brk_chars == 7 && brk_inverted == 0
+      && sim_uart_get_baud (USART6) == baud;
+
+  printf ("%s: %d us break low for %.1f us (call %.1f us), %d us break "
+          "call %.1f us, %u break slots, %u characters sent in it, %s\n",
+          title, short_us, low_us, short_call, long_us, long_call,
+          (unsigned) slots, (unsigned) brk_inverted,
+          result ? "ok" : "failed");
+
+  sim_uart_set_tx_hook (USART6, nullptr, nullptr);
+  tty->close ();
+  return result;
+}
+
+/**
+ * @brief Loop back 9 bit characters, written and read as 16 bit words, and
+ *      change the data width (9 data bits to 8) while a write is going on:
+ *      the transfers are stopped for that, but only after the data went
+ *      out, and tcdrain() must then return. The words received before the
+ *      switch and the bytes after it must be read back as sent.
+ */
+static bool
+width_round (const char* title, bool use_dma)
+{
+  uint16_t words[20];
+  uint16_t back[20];
+  uint8_t msg[10];
+  uint8_t buf[sizeof(msg)];
+  bool result = true;
+
+  init_handle (use_dma, 115200);
+  huart6.Init.WordLength = UART_WORDLENGTH_9B;
+  sim_uart_loopback (USART6, true);
+  sim_uart_set_tx_hook (USART6, drain_hook, nullptr);
+
+  os::posix::tty* tty =
+      static_cast<os::posix::tty*> (os::posix::open ("/dev/uart6", 0));
+  if (tty == nullptr)
+    {
+      printf ("%s: error at open\n", title);
+      return false;
+    }
+
+  for (size_t j = 0; j < sizeof(words) / sizeof(words[0]); j++)
+    {
+      words[j] = (uint16_t) ((j * 37 + (j & 1) * 0x100) & 0x1FF);
+    }
+  for (size_t j = 0; j < sizeof(msg); j++)
+    {
+      msg[j] = (uint8_t) (j * 3);
+    }
+
+  // whole words only
+  errno = 0;
+  result &= tty->write (words, 3) == -1 && errno == EINVAL;
+
+  tx_chars = 0;
+  result &= tty->write (words, sizeof(words)) == (ssize_t) sizeof(words);
+
+  // return what is there, or 0 after 100 ms without data
+  struct termios tios;
+  tty->tcgetattr (&tios);
+  tios.c_cflag = CS8;
+  tios.c_cc[VMIN] = 0;
+  tios.c_cc[VTIME] = 1;
+  result &= tty->tcsetattr (TCSANOW, &tios) == 0;
+  uint32_t sent = tx_chars;
+  result &= sent == sizeof(words) / sizeof(words[0]);
+  result &= tty->tcdrain () == 0;
+  result &= huart6.Init.WordLength == UART_WORDLENGTH_8B;
+
+  size_t received = 0;
+  ssize_t count;
+  while (received < sizeof(back)
+      && (count = tty->read ((uint8_t*) back + received,
+                             sizeof(back) - received)) > 0)
+    {
+      received += count;
+    }
+  bool words_ok = received == sizeof(back)
+      && memcmp (back, words, sizeof(back)) == 0;
+
+  result &= tty->write (msg, sizeof(msg)) == (ssize_t) sizeof(msg);
+  result &= tty->tcdrain () == 0;
+  sysclock.sleep_for (2);
+  result &= tx_chars == sent + sizeof(msg);
+
+  received = 0;
+  while (received < sizeof(buf)
+      && (count = tty->read (buf + received, sizeof(buf) - received)) > 0)
+    {
+      received += count;
+    }
+  bool bytes_ok = received == sizeof(buf)
+      && memcmp (buf, msg, sizeof(buf)) == 0;
+  result &= words_ok && bytes_ok;
+
+  printf ("%s: %u of %zu words sent before the switch, %u characters in "
+          "all, 9 bit words %s, bytes %s, %s\n",
+          title, (unsigned) sent, sizeof(words) / sizeof(words[0]),
+          (unsigned) tx_chars, words_ok ? "back" : "wrong",
+          bytes_ok ? "back" : "wrong", result ? "ok" : "failed");
+
+  sim_uart_set_tx_hook (USART6, nullptr, nullptr);
+  tty->close ();
+  return result;
+}
+
+/**
+ * @brief Switch the baud rate and the format of the loop-back a few times,
+ *      leaving the data received before each switch in the buffer: it must
+ *      all be read afterwards (the reception goes on, even with a circular
+ *      DMA that can't be restarted without losing the buffer), and the
+ *      USART must run at the new rate. Report the time tcsetattr() takes.
+ */
+static bool
+switch_round (const char* title, bool use_dma, bool circular)
+{
+  static const struct
+  {
+    uint32_t baud;
+    tcflag_t cflag;
+  } configs[] =
+    {
+      { 230400, CS8 },
+      { 921600, CS8 | PARENB },
+      { 460800, CS8 | CSTOPB },
+      { 115200, CS7 | PARENB | PARODD },
+      { 1000000, CS8 },
+      { 57600, CS8 } };
+  static const size_t n = sizeof(configs) / sizeof(configs[0]);
+  uint8_t msg[16];
+  uint8_t buf[n * sizeof(msg)];
+  uint8_t expected[n * sizeof(msg)];
+  size_t received = 0;
+  double sum = 0, max = 0;
+  bool result = true;
+
+  init_handle (use_dma, 115200);
+  if (use_dma)
+    {
+      hdma_usart6_rx.Init.Mode = circular ? DMA_CIRCULAR : DMA_NORMAL;
+    }
+  sim_uart_loopback (USART6, true);
+
+  os::posix::tty* tty =
+      static_cast<os::posix::tty*> (os::posix::open ("/dev/uart6", 0));
+  if (tty == nullptr)
+    {
+      printf ("%s: error at open\n", title);
+      return false;
+    }
+
+  // return what is there, or 0 after 100 ms without data
+  struct termios tios;
+  tty->tcgetattr (&tios);
+  tios.c_cc[VMIN] = 0;
+  tios.c_cc[VTIME] = 1;
+  tty->tcsetattr (TCSANOW, &tios);
+
+  for (size_t i = 0; i < n; i++)
+    {
+      for (size_t j = 0; j < sizeof(msg); j++)
+        {
+          msg[j] = (uint8_t) ((i * 37 + j * 11) & 0x7F);
+        }
+      memcpy (expected + i * sizeof(msg), msg, sizeof(msg));
+      result &= tty->write (msg, sizeof(msg)) == (ssize_t) sizeof(msg);
+
+      // switch after the data looped back, leaving it unread
+      tty->tcdrain ();
+      sysclock.sleep_for (2);
+      tios.c_cflag = configs[i].cflag;
+      tios.c_ispeed = tios.c_ospeed = configs[i].baud;
+      uint32_t start = DWT->CYCCNT;
+      result &= tty->tcsetattr (TCSADRAIN, &tios) == 0;
+      double us = (uint32_t) (DWT->CYCCNT - start) / (SystemCoreClock / 1e6);
+      sum += us;
+      max = us > max ? us : max;
+
+      uint32_t baud = sim_uart_get_baud (USART6);
+      result &= baud > configs[i].baud * 0.98 && baud < configs[i].baud * 1.02;
+    }
+
+  ssize_t count;
+  while (received < sizeof(buf)
+      && (count = tty->read (buf + received, sizeof(buf) - received)) > 0)
+    {
+      received += count;
+    }
+  result &= received == sizeof(buf) && memcmp (buf, expected, received) == 0;
+
+  printf ("%s: %zu switches, %zu of %zu bytes kept, tcsetattr() avg %.1f us, "
+          "max %.1f us, %s\n",
+          title, n, received, sizeof(buf), sum / n, max,
+          result ? "ok" : "failed");
+
+  tty->close ();
+  return result;
+}
+
+// profiles of USART6, compiled for the 108 MHz APB2 clock of the simulator
+static constexpr uint32_t profile_clock = 108000000;
+static constexpr uart_profile profiles[] =
+  {
+    uart_make_profile (profile_clock, 230400, CS8),
+    uart_make_profile (profile_clock, 921600, CS8 | PARENB),
+    uart_make_profile (profile_clock, 12000000, CS8),
+    uart_make_profile (profile_clock, 460800, CS8 | CSTOPB),
+    uart_make_profile (profile_clock, 115200, CS7 | PARENB | PARODD),
+    uart_make_profile (profile_clock, 57600, CS8) };
+
+static_assert (profiles[0].brr == 469 && profiles[0].cr1 == 0,
+    "230400 8N1: 16 times oversampling");
+static_assert (profiles[1].cr1 == (UART_WORDLENGTH_9B | UART_PARITY_EVEN),
+    "8E1: 9 bits with the parity");
+static_assert (profiles[2].brr == 0x11
+    && profiles[2].cr1 == UART_OVERSAMPLING_8,
+    "12 Mbaud: 8 times oversampling");
+static_assert (profiles[3].cr2 == UART_STOPBITS_2, "2 stop bits");
+static_assert (uart_make_profile (profile_clock, 1000, CS8).brr == 0,
+    "1000 baud: out of the generator's range");
+static_assert (uart_make_profile (profile_clock, 9600, CS6).brr == 0,
+    "no 6 bit characters");
+
+/**
+ * @brief Switch between profiles compiled at build time, like switch_round
+ *      does with tcsetattr(): the data received before each switch must be
+ *      kept, the USART must run at the profile's rate, and tcgetattr() must
+ *      report the profile's settings. Profiles the port can't take must be
+ *      refused. Report the time the ioctl() takes.
+ */
+static bool
+profile_round (const char* title, bool use_dma)
+{
+  static const size_t n = sizeof(profiles) / sizeof(profiles[0]);
+  static const uart_profile bad = { UART_WORDLENGTH_9B, 0, 0, 469, 230400 };
+  uint8_t msg[16];
+  uint8_t buf[n * sizeof(msg)];
+  uint8_t expected[n * sizeof(msg)];
+  size_t received = 0;
+  double sum = 0, max = 0;
+  bool result = true;
+
+  init_handle (use_dma, 115200);
+  sim_uart_loopback (USART6, true);
+
+  os::posix::tty* tty =
+      static_cast<os::posix::tty*> (os::posix::open ("/dev/uart6", 0));
+  if (tty == nullptr)
+    {
+      printf ("%s: error at open\n", title);
+      return false;
+    }
+
+  // return what is there, or 0 after 100 ms without data
+  struct termios tios;
+  tty->tcgetattr (&tios);
+  tios.c_cc[VMIN] = 0;
+  tios.c_cc[VTIME] = 1;
+  tty->tcsetattr (TCSANOW, &tios);
+
+  uint32_t baud = sim_uart_get_baud (USART6);
+  result &= tty->ioctl (UART_IOCTL_SET_PROFILE, nullptr) < 0
+      && errno == EINVAL;
+  result &= tty->ioctl (UART_IOCTL_SET_PROFILE, &bad) < 0 && errno == EINVAL;
+  uart_profile slow = uart_make_profile (profile_clock, 1000, CS8);
+  result &= tty->ioctl (UART_IOCTL_SET_PROFILE, &slow) < 0 && errno == EINVAL;
+  result &= sim_uart_get_baud (USART6) == baud;
+
+  for (size_t i = 0; i < n; i++)
+    {
+      for (size_t j = 0; j < sizeof(msg); j++)
+        {
+          msg[j] = (uint8_t) ((i * 41 + j * 13) & 0x7F);
+        }
+      memcpy (expected + i * sizeof(msg), msg, sizeof(msg));
+      result &= tty->write (msg, sizeof(msg)) == (ssize_t) sizeof(msg);
+
+      // switch after the data looped back, leaving it unread
+      tty->tcdrain ();
+      sysclock.sleep_for (2);
+      uint32_t start = DWT->CYCCNT;
+      result &= tty->ioctl (UART_IOCTL_SET_PROFILE, &profiles[i]) == 0;
+      double us = (uint32_t) (DWT->CYCCNT - start) / (SystemCoreClock / 1e6);
+      sum += us;
+      max = us > max ? us : max;
+
+      baud = sim_uart_get_baud (USART6);
+      result &= baud > profiles[i].baud * 0.98
+          && baud < profiles[i].baud * 1.02;
+
+      // the settings reported compile back to the same images
+      tty->tcgetattr (&tios);
+      uart_profile current = uart_make_profile (profile_clock, tios.c_ospeed,
+                                                tios.c_cflag);
+      result &= current.cr1 == profiles[i].cr1
+          && current.cr2 == profiles[i].cr2 && current.cr3 == profiles[i].cr3
+          && current.brr == profiles[i].brr;
+    }
+
+  ssize_t count;
+  while (received < sizeof(buf)
+      && (count = tty->read (buf + received, sizeof(buf) - received)) > 0)
+    {
+      received += count;
+    }
+  result &= received == sizeof(buf) && memcmp (buf, expected, received) == 0;
+
+  printf ("%s: %zu profiles, %zu of %zu bytes kept, ioctl() avg %.1f us, "
+          "max %.1f us, %s\n",
+          title, n, received, sizeof(buf), sum / n, max,
+          result ? "ok" : "failed");
+
+  tty->close ();
+  return result;
+}
+
+/**
+ * @brief Check the oversampling and BRR chosen for a table of kernel clocks
+ *      and baud rates, by uart_make_profile() and by tcsetattr() on USART6
+ *      (clocked from APB2, or from HSI at 16 MHz): the rates the USART
+ *      can't reach within UART_BAUD_TOLERANCE must be refused, the others
+ *      must run at the baud rate tcgetattr() reports.
+ */
+static bool
+baud_table_round (const char* title)
+{
+  static const struct
+  {
+    uint32_t clock;
+    uint32_t baud;
+    bool over8;
+    uint32_t brr;       // 0: not possible
+    uint32_t actual;
+  } table[] =
+    {
+      { 108000000, 115200, false, 938, 115139 },
+      { 108000000, 921600, false, 117, 923077 },
+      { 108000000, 5000000, false, 22, 4909091 },   // -1.8%
+      { 108000000, 12000000, true, 0x11, 12000000 },
+      { 108000000, 13500000, true, 0x10, 13500000 },
+      { 108000000, 14000000, true, 0, 0 },          // 13.5 M, -3.6%
+      { 108000000, 1000, false, 0, 0 },             // divider > 65535
+      { 108000000, 2400, false, 45000, 2400 },
+      { 54000000, 3000000, false, 18, 3000000 },
+      { 54000000, 6000000, true, 0x11, 6000000 },
+      { 54000000, 10000000, true, 0, 0 },           // divider < 8
+      { 16000000, 921600, false, 0, 0 },            // +2.1%
+      { 16000000, 1500000, true, 0, 0 },            // -3.0%
+      { 16000000, 1600000, true, 0x12, 1600000 },
+      { 16000000, 1780000, true, 0x11, 1777778 },
+      { 16000000, 2000000, true, 0x10, 2000000 } };
+  size_t passed = 0;
+  bool result = true;
+
+  init_handle (true, 115200);
+
+  os::posix::tty* tty =
+      static_cast<os::posix::tty*> (os::posix::open ("/dev/uart6", 0));
+  if (tty == nullptr)
+    {
+      printf ("%s: error at open\n", title);
+      return false;
+    }
+
+  struct termios tios;
+  tty->tcgetattr (&tios);
+
+  for (auto& entry : table)
+    {
+      bool ok = true;
+      uart_profile profile = uart_make_profile (entry.clock, entry.baud, CS8);
+      ok &= profile.brr == entry.brr;
+      if (entry.brr != 0)
+        {
+          ok &= (profile.cr1 == UART_OVERSAMPLING_8) == entry.over8;
+          ok &= uart_baud (entry.clock, profile.brr, entry.over8)
+              == entry.actual;
+        }
+
+      // the 16 MHz rates run from HSI, with APB2 left at 108 MHz
+      if (entry.clock == HSI_VALUE)
+        {
+          sim_rcc_set_uart_source (USART6, UART_CLOCKSOURCE_HSI);
+        }
+      else
+        {
+          sim_rcc_set_uart_source (USART6, UART_CLOCKSOURCE_PCLK2);
+          sim_rcc_set_pclk (54000000, entry.clock);
+        }
+      uint32_t before = sim_uart_get_baud (USART6);
+      tios.c_cflag = CS8;
+      tios.c_ispeed = tios.c_ospeed = entry.baud;
+      int res = tty->tcsetattr (TCSANOW, &tios);
+      if (entry.brr == 0)
+        {
+          ok &= res < 0 && errno == EINVAL
+              && sim_uart_get_baud (USART6) == before;
+        }
+      else
+        {
+          // the simulator truncates the baud rate
+          struct termios got;
+          tty->tcgetattr (&got);
+          uint32_t baud = sim_uart_get_baud (USART6);
+          ok &= res == 0 && got.c_ospeed == entry.actual
+              && got.c_ispeed == entry.actual && baud <= entry.actual
+              && baud + 1 >= entry.actual;
+        }
+
+      if (!ok)
+        {
+          printf ("%s: %u baud at %u Hz: brr 0x%X, wrong\n", title,
+                  (unsigned) entry.baud, (unsigned) entry.clock,
+                  (unsigned) profile.brr);
+        }
+      passed += ok;
+      result &= ok;
+    }
+
+  printf ("%s: %zu of %zu rates, %s\n", title, passed,
+          sizeof(table) / sizeof(table[0]), result ? "ok" : "failed");
+
+  sim_rcc_set_uart_source (USART6, UART_CLOCKSOURCE_PCLK2);
+  sim_rcc_set_pclk (54000000, 108000000);
+  tty->close ();
+  return result;
+}
+
+/**
+ * @brief Receive frames separated by idle gaps, with VMIN larger than the
+ *      frames: each read() must return exactly one frame, completed by the
+ *      USART receiver timeout, with no polling wake-ups.
+ * @param gap_chars: gap programmed through UART_IOCTL_SET_RX_GAP, or 0 to
+ *      use VTIME_MS.
+ */
+static bool
+frame_gap_round (const char* title, bool use_dma, int gap_chars)
+{
+  static const size_t frames[] =
+    { 17, 120, 1, 64, 99, 3 };
+  uint8_t frame[128];
+  uint8_t buf[256];
+  uart_stats stats;
+  bool result = true;
+
+  init_handle (use_dma, 115200);
+  sim_uart_loopback (USART6, false);
+
+  os::posix::tty* tty =
+      static_cast<os::posix::tty*> (os::posix::open ("/dev/uart6", 0));
+  if (tty == nullptr)
+    {
+      printf ("%s: error at open\n", title);
+      return false;
+    }
+
+  struct termios tios;
+  tty->tcgetattr (&tios);
+  tios.c_cc[VMIN] = 255;
+  tios.c_cc[VTIME] = 0;
+  tios.c_cc[VTIME_MS] = gap_chars ? 0 : 1;  // 1 ms, 11.5 characters
+  tty->tcsetattr (TCSANOW, &tios);
+  tty->ioctl (UART_IOCTL_SET_RX_GAP, gap_chars);
+  tty->ioctl (UART_IOCTL_RESET_STATS);
+
+  for (size_t len : frames)
+    {
+      for (size_t i = 0; i < len; i++)
+        {
+          frame[i] = (uint8_t) rand ();
+        }
+      sim_uart_inject (USART6, frame, len, 0);
+      sim_uart_inject_idle (USART6, 30);
+
+      ssize_t count = tty->read (buf, sizeof(buf));
+      if (count != (ssize_t) len || memcmp (buf, frame, len) != 0)
+        {
+          printf ("%s: frame of %zu bytes, read returned %zd\n", title, len,
+                  count);
+          result = false;
+          break;
+        }
+    }
+
+  tty->ioctl (UART_IOCTL_GET_STATS, &stats);
+  printf ("%s: %zu frames, %u wake-ups, %u rx events\n", title,
+          sizeof(frames) / sizeof(frames[0]), (unsigned) stats.rx_wakeups,
+          (unsigned) stats.rx_events);
+
+  tty->close ();
+  return result;
+}
+
+/**
+ * @brief Read without blocking with VMIN > 1 and a long VTIME: read() must
+ *      return the characters received so far at once, without waiting for
+ *      the receiver timeout to end the gap.
+ */
+static bool
+nonblock_gap_round (const char* title, bool use_dma)
+{
+  static const uint8_t frame[] =
+    { 'a', 'b', 'c', 'd', 'e' };
+  uint8_t buf[64];
+  bool result = true;
+
+  init_handle (use_dma, 115200);
+  sim_uart_loopback (USART6, false);
+
+  os::posix::tty* tty =
+      static_cast<os::posix::tty*> (os::posix::open ("/dev/uart6",
+                                                     O_NONBLOCK));
+  if (tty == nullptr)
+    {
+      printf ("%s: error at open\n", title);
+      return false;
+    }
+
+  struct termios tios;
+  tty->tcgetattr (&tios);
+  tios.c_cc[VMIN] = 255;
+  tios.c_cc[VTIME] = 10;        // 1 s
+  tty->tcsetattr (TCSANOW, &tios);
+
+  sim_uart_inject (USART6, frame, sizeof(frame), 0);
+  sim_uart_inject_idle (USART6, 2);
+  sysclock.sleep_for (5);
+
+  rtos::clock::timestamp_t start = sysclock.now ();
+  ssize_t count = tty->read (buf, sizeof(buf));
+  rtos::clock::timestamp_t elapsed = sysclock.now () - start;
+  if (count != (ssize_t) sizeof(frame)
+      || memcmp (buf, frame, sizeof(frame)) != 0 || elapsed > 100)
+    {
+      printf ("%s: read returned %zd after %u ms\n", title, count,
+              (unsigned) elapsed);
+      result = false;
+    }
+  else
+    {
+      printf ("%s: %zd bytes in %u ms\n", title, count, (unsigned) elapsed);
+    }
+
+  tty->close ();
+  return result;
+}
+
+/**
+ * @brief Receive NMEA-like lines, either in canonical mode (one read()
+ *      per line) or with VMIN = 1 (raw reads, the application looks for the
+ *      end of line), and report the reader's wake-ups per kilobyte.
+ */
+static bool
+line_round (const char* title, bool use_dma, bool canonical, int gap_chars)
+{
+  static char lines[64][96];
+  uint8_t buf[256];
+  uart_stats stats;
+  size_t total = 0;
+  size_t reads = 0;
+  size_t n_lines = sizeof(lines) / sizeof(lines[0]);
+  bool result = true;
+
+  init_handle (use_dma, 115200);
+  sim_uart_loopback (USART6, false);
+
+  os::posix::tty* tty =
+      static_cast<os::posix::tty*> (os::posix::open ("/dev/uart6", 0));
+  if (tty == nullptr)
+    {
+      printf ("%s: error at open\n", title);
+      return false;
+    }
+
+  struct termios tios;
+  tty->tcgetattr (&tios);
+  tios.c_lflag = canonical ? ICANON : 0;
+  tios.c_cc[VMIN] = 1;
+  tios.c_cc[VTIME] = 0;
+  tios.c_cc[VTIME_MS] = 0;
+  tty->tcsetattr (TCSANOW, &tios);
+  tty->tcgetattr (&tios);
+  result &= (tios.c_lflag & ICANON) == (canonical ? ICANON : 0u);
+  tty->ioctl (UART_IOCTL_RESET_STATS);
+
+  for (size_t i = 0; i < n_lines; i++)
+    {
+      int len = snprintf (lines[i], sizeof(lines[i]),
+                          "$GPGGA,%06u.00,%u.%05u,N,%u,E,1,08,0.9,%u.%u,M*%02X",
+                          (unsigned) rand () % 240000,
+                          (unsigned) rand () % 9000, (unsigned) rand () % 100000,
+                          (unsigned) rand () % 18000, (unsigned) rand () % 500,
+                          (unsigned) rand () % 10, (unsigned) rand () & 0xFF);
+      len += rand () % 20;
+      memset (lines[i] + strlen (lines[i]), ',', len - strlen (lines[i]));
+      strcpy (lines[i] + len, "\r\n");
+      sim_uart_inject (USART6, (const uint8_t*) lines[i], len + 2, 0);
+      sim_uart_inject_idle (USART6, gap_chars);
+      total += len + 2;
+    }
+
+  if (canonical)
+    {
+      for (size_t i = 0; i < n_lines && result; i++, reads++)
+        {
+          ssize_t count = tty->read (buf, sizeof(buf));
+          if (count != (ssize_t) strlen (lines[i])
+              || memcmp (buf, lines[i], count) != 0)
+            {
+              printf ("%s: line %zu, read returned %zd\n", title, i, count);
+              result = false;
+            }
+        }
+    }
+  else
+    {
+      size_t received = 0;
+      for (; received < total && result; reads++)
+        {
+          ssize_t count = tty->read (buf, sizeof(buf));
+          result &= count > 0;
+          received += count;
+        }
+    }
+
+  tty->ioctl (UART_IOCTL_GET_STATS, &stats);
+  printf ("%s: %zu lines, %zu bytes, %zu reads, %u wake-ups, "
+          "%.1f wake-ups/KB\n",
+          title, n_lines, total, reads, (unsigned) stats.rx_wakeups,
+          stats.rx_wakeups * 1024.0 / total);
+
+  // woken at most once per line
+  result &= !canonical || stats.rx_wakeups <= n_lines;
+
+  // the settings outlive the file, leave the port raw
+  tios.c_lflag = 0;
+  tty->tcsetattr (TCSANOW, &tios);
+  tty->close ();
+  return result;
+}
+
+/**
+ * @brief Receive frames in packet mode: each read_frame() must return
+ *      exactly one frame, with its descriptor. Frames have a short pause
+ *      in the middle, which ends them only if there is no receiver timeout
+ *      (gap_chars 0); a frame with a framing error and an overflow of the
+ *      descriptor queue are checked too.
+ */
+static bool
+packet_round (const char* title, bool use_dma, int gap_chars)
+{
+  static const size_t frames[] =
+    { 8, 60, 1, 33, 90, 5 };
+  uint8_t frame[100];
+  uint8_t buf[128];
+  uart_frame desc;
+  uart_stats stats;
+  uint32_t last_timestamp = 0;
+  bool result = true;
+
+  init_handle (use_dma, 115200);
+  sim_uart_loopback (USART6, false);
+
+  os::posix::tty* tty =
+      static_cast<os::posix::tty*> (os::posix::open ("/dev/uart6", 0));
+  if (tty == nullptr)
+    {
+      printf ("%s: error at open\n", title);
+      return false;
+    }
+  uart_impl& drv = uart6.impl ();
+
+  result &= drv.read_frame (buf, sizeof(buf), &desc) < 0 && errno == EINVAL;
+  result &= tty->ioctl (UART_IOCTL_SET_PACKET_MODE, 1) == 0;
+  tty->ioctl (UART_IOCTL_SET_RX_GAP, gap_chars);
+  tty->ioctl (UART_IOCTL_RESET_STATS);
+
+  for (size_t len : frames)
+    {
+      for (size_t i = 0; i < len; i++)
+        {
+          frame[i] = (uint8_t) rand ();
+        }
+      // a pause of 2 character times after the first half
+      sim_uart_inject (USART6, frame, len / 2, 0);
+      sim_uart_inject_idle (USART6, 2);
+      sim_uart_inject (USART6, frame + len / 2, len - len / 2, 0);
+      sim_uart_inject_idle (USART6, 10);
+
+      size_t expected = (gap_chars || len < 2) ? len : len / 2;
+      ssize_t count = drv.read_frame (buf, sizeof(buf), &desc);
+      if (count != (ssize_t) expected || memcmp (buf, frame, count) != 0
+          || desc.errors != 0 || desc.timestamp == last_timestamp
+          || desc.end != (gap_chars ? UART_FRAME_GAP : UART_FRAME_IDLE))
+        {
+          printf ("%s: frame of %zu bytes, read returned %zd\n", title, len,
+                  count);
+          result = false;
+          break;
+        }
+      last_timestamp = desc.timestamp;
+      if (expected != len)
+        {
+          // the second part, as a frame of its own, through read()
+          count = tty->read (buf, sizeof(buf));
+          result &= count == (ssize_t) (len - expected)
+              && memcmp (buf, frame + expected, count) == 0;
+        }
+    }
+
+  // a framing error stops the DMA reception, not the interrupt one; the
+  // frame may also be cut by the end of the buffer
+  sim_uart_inject (USART6, frame, 10, 0);
+  sim_uart_inject (USART6, frame + 10, 1, SIM_CHAR_FE);
+  sim_uart_inject (USART6, frame + 11, 10, 0);
+  sim_uart_inject_idle (USART6, 10);
+  ssize_t count;
+  do
+    {
+      count = drv.read_frame (buf, sizeof(buf), &desc);
+    }
+  while (count > 0 && desc.end == UART_FRAME_FULL);
+  result &= count > 0 && (desc.errors & HAL_UART_ERROR_FE)
+      && desc.end
+          == (use_dma ? UART_FRAME_ERROR :
+              gap_chars ? UART_FRAME_GAP : UART_FRAME_IDLE);
+  if (use_dma)
+    {
+      // the rest of the frame, after the reception restarted
+      result &= drv.read_frame (buf, sizeof(buf), &desc) > 0
+          && desc.errors == 0;
+    }
+
+  // more frames than descriptors: the last ones are lost, but not the
+  // following frames
+  for (int i = 0; i < UART_FRAME_QUEUE_SIZE + 3; i++)
+    {
+      sim_uart_inject (USART6, frame, 4, 0);
+      sim_uart_inject_idle (USART6, 10);
+    }
+  for (int k = 0; k < 100 && sim_uart_pending (USART6) > 0; k++)
+    {
+      sysclock.sleep_for (1);
+    }
+  sysclock.sleep_for (2);
+  for (int i = 0; i < UART_FRAME_QUEUE_SIZE; i++)
+    {
+      result &= drv.read_frame (buf, sizeof(buf), &desc) == 4;
+    }
+  sim_uart_inject (USART6, frame + 50, 7, 0);
+  sim_uart_inject_idle (USART6, 10);
+  result &= drv.read_frame (buf, sizeof(buf), &desc) == 7
+      && memcmp (buf, frame + 50, 7) == 0 && desc.errors == 0;
+
+  tty->ioctl (UART_IOCTL_GET_STATS, &stats);
+  result &= stats.rx_frames_dropped == 3;
+  printf ("%s: %u frames, %u dropped, %u wake-ups, %u rx events, %s\n",
+          title, (unsigned) stats.rx_frames,
+          (unsigned) stats.rx_frames_dropped, (unsigned) stats.rx_wakeups,
+          (unsigned) stats.rx_events, result ? "ok" : "failed");
+
+  tty->ioctl (UART_IOCTL_SET_PACKET_MODE, 0);
+  tty->ioctl (UART_IOCTL_SET_RX_GAP, 0);
+  tty->close ();
+  return result;
+}
+
+/**
+ * @brief Receive characters with line errors and check they are counted.
+ */
+static bool
+error_stats_round (const char* title)
+{
+  static const uint8_t bad[] =
+    { 0x55 };
+  uart_stats stats;
+  uint8_t buf[8];
+  bool result = true;
+
+  init_handle (false, 115200);
+  sim_uart_loopback (USART6, false);
+
+  os::posix::tty* tty =
+      static_cast<os::posix::tty*> (os::posix::open ("/dev/uart6", 0));
+  if (tty == nullptr)
+    {
+      printf ("%s: error at open\n", title);
+      return false;
+    }
+  tty->ioctl (UART_IOCTL_RESET_STATS);
+
+  sim_uart_inject (USART6, bad, sizeof(bad), SIM_CHAR_FE);
+  result &= tty->read (buf, sizeof(buf)) < 0 && errno == EIO;
+  sim_uart_inject (USART6, bad, sizeof(bad), SIM_CHAR_NE);
+  result &= tty->read (buf, sizeof(buf)) < 0 && errno == EIO;
+
+  result &= tty->ioctl (UART_IOCTL_GET_STATS, &stats) == 0;
+  result &= stats.framing_errors == 1 && stats.noise_errors == 1;
+  result &= tty->ioctl (UART_IOCTL_RESET_STATS) == 0
+      && tty->ioctl (UART_IOCTL_GET_STATS, &stats) == 0
+      && stats.framing_errors == 0 && stats.rx_wakeups == 0;
+  result &= tty->ioctl (0x1234) < 0 && errno == ENOTTY;
+
+  tty->close ();
+  printf ("%s: %s\n", title, result ? "ok" : "failed");
+  return result;
+}
+
+/**
+ * @brief Receive a framing error in the middle of the data, with the given
+ *      c_iflag: the data around the error must be kept and, after the
+ *      error, received without a gap (the reception restarts from the
+ *      interrupt). By default read() returns the data before the error,
+ *      then fails with EIO, then returns the rest; IGNPAR drops the faulty
+ *      character and PARMRK marks it in the data, with a valid \377
+ *      doubled.
+ */
+static bool
+line_error_round (const char* title, bool use_dma, bool circular,
+                  tcflag_t iflag)
+{
+  static const uint8_t before[] = "abc";
+  static const uint8_t bad[] =
+    { 'X' };
+  static const uint8_t after[] =
+    { 'd', 'e', 'f', 0xFF };
+  uint8_t buf[32];
+  size_t received = 0;
+  int errors = 0;
+  bool result = true;
+
+  init_handle (use_dma, 115200);
+  if (use_dma)
+    {
+      hdma_usart6_rx.Init.Mode = circular ? DMA_CIRCULAR : DMA_NORMAL;
+    }
+  sim_uart_loopback (USART6, false);
+
+  os::posix::tty* tty =
+      static_cast<os::posix::tty*> (os::posix::open ("/dev/uart6", 0));
+  if (tty == nullptr)
+    {
+      printf ("%s: error at open\n", title);
+      return false;
+    }
+
+  // return what is there, or 0 after 100 ms without data
+  struct termios tios;
+  tty->tcgetattr (&tios);
+  result &= tios.c_iflag == INPCK;
+  tios.c_iflag = iflag;
+  tios.c_cc[VMIN] = 0;
+  tios.c_cc[VTIME] = 1;
+  tty->tcsetattr (TCSANOW, &tios);
+
+  sim_uart_inject (USART6, before, sizeof(before) - 1, 0);
+  sim_uart_inject (USART6, bad, sizeof(bad), SIM_CHAR_FE);
+  sim_uart_inject (USART6, after, sizeof(after), 0);
+  sysclock.sleep_for (10);
+
+  ssize_t count;
+  while (received < sizeof(buf))
+    {
+      count = tty->read (buf + received, sizeof(buf) - received);
+      if (count < 0 && errno == EIO)
+        {
+          result &= received == sizeof(before) - 1;
+          errors++;
+          continue;
+        }
+      if (count <= 0)
+        {
+          break;
+        }
+      received += count;
+    }
+
+  static const uint8_t kept[] = "abcdef\xFF";
+  static const uint8_t marked[] = "abc\xFF\0Xdef\xFF\xFF";
+  if ((iflag & PARMRK) != 0)
+    {
+      result &= errors == 0 && received == sizeof(marked) - 1
+          && memcmp (buf, marked, received) == 0;
+    }
+  else
+    {
+      result &= errors == ((iflag & IGNPAR) ? 0 : 1)
+          && received == sizeof(kept) - 1
+          && memcmp (buf, kept, received) == 0;
+    }
+
+  tios.c_iflag = INPCK;
+  tty->tcsetattr (TCSANOW, &tios);
+  tty->close ();
+  printf ("%s: %zu bytes, %d errors, %s\n", title, received, errors,
+          result ? "ok" : "failed");
+  return result;
+}
+
+/**
+ * @brief Read line errors with one byte buffers, or without INPCK: with
+ *      PARMRK, a valid \377 must still come doubled, split over two reads;
+ *      without INPCK, a character received with a parity error and an
+ *      overrun is valid, only the overrun is reported (through the driver's
+ *      handler, which reports both flags of the character at once).
+ */
+static bool
+error_split_round (const char* title, bool use_dma)
+{
+  static const uint8_t valid[] =
+    { 'a', 0xFF, 'b' };
+  static const uint8_t doubled[] =
+    { 'a', 0xFF, 0xFF, 'b' };
+  static const uint8_t before[] = "ab";
+  static const uint8_t bad[] =
+    { 'P' };
+  static const uint8_t after[] = "cd";
+  static const uint8_t kept[] = "abPcd";
+  uint8_t buf[16];
+  size_t received = 0;
+  int errors = 0;
+  bool result = true;
+
+  init_handle (use_dma, 115200);
+  sim_uart_loopback (USART6, false);
+
+  os::posix::tty* tty =
+      static_cast<os::posix::tty*> (os::posix::open ("/dev/uart6", 0));
+  if (tty == nullptr)
+    {
+      printf ("%s: error at open\n", title);
+      return false;
+    }
+
+  // return what is there, or 0 after 100 ms without data
+  struct termios tios;
+  tty->tcgetattr (&tios);
+  tios.c_iflag = PARMRK;
+  tios.c_cc[VMIN] = 0;
+  tios.c_cc[VTIME] = 1;
+  tty->tcsetattr (TCSANOW, &tios);
+
+  sim_uart_inject (USART6, valid, sizeof(valid), 0);
+  sysclock.sleep_for (5);
+  while (received < sizeof(buf) && tty->read (buf + received, 1) == 1)
+    {
+      received++;
+    }
+  result &= received == sizeof(doubled)
+      && memcmp (buf, doubled, received) == 0;
+  size_t split = received;
+
+  tios.c_iflag = 0;
+  tty->tcsetattr (TCSANOW, &tios);
+  sim_uart_inject (USART6, before, sizeof(before) - 1, 0);
+  sim_uart_inject (USART6, bad, sizeof(bad), SIM_CHAR_PE | SIM_CHAR_ORE);
+  sim_uart_inject (USART6, after, sizeof(after) - 1, 0);
+  sysclock.sleep_for (5);
+
+  received = 0;
+  ssize_t count;
+  while (received < sizeof(buf))
+    {
+      count = tty->read (buf + received, sizeof(buf) - received);
+      if (count < 0 && errno == EIO)
+        {
+          result &= received == sizeof(before) - 1;
+          errors++;
+          continue;
+        }
+      if (count <= 0)
+        {
+          break;
+        }
+      received += count;
+    }
+  result &= errors == 1 && received == sizeof(kept) - 1
+      && memcmp (buf, kept, received) == 0;
+
+  tios.c_iflag = INPCK;
+  tty->tcsetattr (TCSANOW, &tios);
+  tty->close ();
+  printf ("%s: %zu bytes read one at a time, %zu bytes and %d errors "
+          "without INPCK, %s\n",
+          title, split, received, errors, result ? "ok" : "failed");
+  return result;
+}
+
+/**
+ * @brief Receive through DMA and report the average/maximum cycles spent
+ *      in the receive call-back and the D-cache bytes it invalidates per
+ *      event.
+ */
+static bool
+rx_isr_bench (const char* title, const char* path)
+{
+  sim_cache_stats cache;
+  bool result;
+
+  rx_isr_events = 0;
+  rx_isr_cycles = 0;
+  rx_isr_max = 0;
+  sim_cache_reset_stats ();
+
+  result = loopback_round (title, true, 921600, TEST_BYTES, path);
+
+  sim_cache_get_stats (&cache);
+  printf ("%s: %u rx events, %.0f cycles/event (max %u), "
+          "%.0f bytes invalidated/event\n",
+          title, (unsigned) rx_isr_events,
+          (double) rx_isr_cycles / rx_isr_events, (unsigned) rx_isr_max,
+          (double) cache.invalidate_bytes / rx_isr_events);
+
+  return result;
+}
+
+// interrupt vector cost, measured with the DWT cycle counter
+static void
+(*bench_handler) (void);
+static uint64_t irq_cycles;
+
+static void
+timed_IRQHandler (void)
+{
+  uint32_t start = DWT->CYCCNT;
+  bench_handler ();
+  irq_cycles += DWT->CYCCNT - start;
+}
+
+/**
+ * @brief Receive a stream of characters through interrupts and report the
+ *      cycles spent in the interrupt vector per byte, with the given
+ *      handler (HAL_UART_IRQHandler() or the driver's one), and the
+ *      reader's wake-ups; the port must have a large receive buffer.
+ */
+static bool
+rx_irq_bench (const char* title, void
+(*handler) (void), const char* path = "/dev/uart6b")
+{
+  static uint8_t data[TEST_BYTES];
+  uint8_t buf[BIG_RX_BUFFER_SIZE];
+  size_t received = 0;
+  sim_uart_stats before, after;
+  uart_stats stats;
+  bool result = true;
+
+  init_handle (false, 921600);
+  sim_uart_loopback (USART6, false);
+  bench_handler = handler;
+  irq_cycles = 0;
+  sim_uart_set_irq_handler (USART6, timed_IRQHandler);
+
+  os::posix::tty* tty =
+      static_cast<os::posix::tty*> (os::posix::open (path, 0));
+  if (tty == nullptr)
+    {
+      printf ("%s: error at open\n", title);
+      return false;
+    }
+  tty->ioctl (UART_IOCTL_RESET_STATS);
+  sim_uart_get_stats (USART6, &before);
+
+  for (size_t i = 0; i < sizeof(data); i++)
+    {
+      data[i] = (uint8_t) rand ();
+    }
+  sim_uart_inject (USART6, data, sizeof(data), 0);
+
+  while (received < sizeof(data))
+    {
+      ssize_t count = tty->read (buf, sizeof(buf));
+      if (count <= 0 || memcmp (buf, data + received, count) != 0)
+        {
+          result = false;
+          break;
+        }
+      received += count;
+    }
+
+  sim_uart_get_stats (USART6, &after);
+  tty->ioctl (UART_IOCTL_GET_STATS, &stats);
+  printf ("%s: %zu bytes, %.0f cycles/byte in the vector, %.2f irqs/byte, "
+          "%u wake-ups, %s\n",
+          title, received, (double) irq_cycles / received,
+          (double) (after.irqs - before.irqs) / received,
+          (unsigned) stats.rx_wakeups, result ? "ok" : "failed");
+
+  tty->close ();
+  sim_uart_set_irq_handler (USART6, USART6_IRQHandler);
+  return result;
+}
+
+static inline uint8_t
+stress_byte (size_t i)
+{
+  return (uint8_t) (i ^ (i >> 8) ^ (i >> 16));
+}
+
+/**
+ * @brief Receive a long stream at 12 Mbaud through DMA, with the DMA
+ *      interrupts delayed by 16 character times (about 13 us). In normal
+ *      mode the DMA stops at the end of the buffer until the call-back
+ *      re-arms it, and the USART overruns meanwhile; in circular mode
+ *      nothing may be lost.
+ */
+static bool
+stress_round (const char* title, bool circular, size_t total)
+{
+  static uint8_t chunk[65536];
+  uint8_t buf[4096];
+  size_t received = 0;
+  sim_uart_stats before, after;
+  uart_stats stats;
+  bool result = true;
+
+  init_handle (true, 12000000);
+  huart6.Init.OverSampling = UART_OVERSAMPLING_8;
+  hdma_usart6_rx.Init.Mode = circular ? DMA_CIRCULAR : DMA_NORMAL;
+  sim_uart_loopback (USART6, false);
+  sim_dma_set_irq_latency (16);
+
+  os::posix::tty* tty =
+      static_cast<os::posix::tty*> (os::posix::open ("/dev/uart6c", 0));
+  if (tty == nullptr)
+    {
+      printf ("%s: error at open\n", title);
+      return false;
+    }
+
+  // return what is there, or 0 after 200 ms without data
+  struct termios tios;
+  tty->tcgetattr (&tios);
+  tios.c_cc[VMIN] = 0;
+  tios.c_cc[VTIME] = 2;
+  tty->tcsetattr (TCSANOW, &tios);
+  tty->ioctl (UART_IOCTL_RESET_STATS);
+  sim_uart_get_stats (USART6, &before);
+  uint64_t start = cycle_counter ();
+
+  // feed the wire from another thread, a chunk ahead of the receiver
+  std::thread feeder ([total]
+    {
+      for (size_t off = 0; off < total; off += sizeof(chunk))
+        {
+          size_t len = std::min (sizeof(chunk), total - off);
+          for (size_t i = 0; i < len; i++)
+            {
+              chunk[i] = stress_byte (off + i);
+            }
+          while (sim_uart_pending (USART6) > sizeof(chunk))
+            {
+              std::this_thread::sleep_for (std::chrono::microseconds (500));
+            }
+          sim_uart_inject (USART6, chunk, len, 0);
+        }
+    });
+
+  while (received < total)
+    {
+      ssize_t count = tty->read (buf, sizeof(buf));
+      if (count <= 0)
+        {
+          break;        // an overrun (EIO), or data lost (timeout)
+        }
+      for (ssize_t i = 0; i < count; i++)
+        {
+          if (buf[i] != stress_byte (received + i))
+            {
+              count = -1;
+              break;
+            }
+        }
+      if (count < 0)
+        {
+          break;        // data lost
+        }
+      received += count;
+    }
+  double ms = (uint32_t) (cycle_counter () - start) / 216000.0;
+  feeder.join ();
+
+  // let the rest go by, the port stops when closed
+  for (int k = 0; k < 5000 && sim_uart_pending (USART6) > 0; k++)
+    {
+      sysclock.sleep_for (1);
+    }
+  sim_uart_get_stats (USART6, &after);
+  tty->ioctl (UART_IOCTL_GET_STATS, &stats);
+
+  printf ("%s: %zu of %zu bytes in order, %.1f ms, %llu overruns, "
+          "%u dropped, %u rx events\n",
+          title, received, total, ms,
+          (unsigned long long) (after.rx_overruns - before.rx_overruns),
+          (unsigned) stats.rx_dropped, (unsigned) stats.rx_events);
+  if (circular)
+    {
+      result = received == total && after.rx_overruns == before.rx_overruns
+          && stats.rx_dropped == 0;
+    }
+
+  tios.c_cc[VMIN] = 1;
+  tios.c_cc[VTIME] = 0;
+  tty->tcsetattr (TCSANOW, &tios);
+  tty->close ();
+  sim_dma_set_irq_latency (0);
+  return result;
+}
+
+/**
+ * @brief Receive 2.75 times the buffer before reading, with an overflow
+ *      policy: drop-oldest must return the newest data, drop-newest the
+ *      oldest (a buffer full, plus the character held in RDR), and the RTS
+ *      flow control all of it; the overflows must be reported when data
+ *      was lost, and only then.
+ */
+static bool
+overflow_round (const char* title, bool use_dma, int policy)
+{
+  static const size_t total = RX_BUFFER_SIZE * 11 / 4;
+  static uint8_t data[total];
+  uint8_t buf[total];
+  size_t received = 0;
+  uint32_t overflows = 0;
+  sim_uart_stats before, after;
+  uart_stats stats;
+  bool result = true;
+
+  init_handle (use_dma, 115200);
+  if (policy == UART_RX_STOP)
+    {
+      huart6.Init.HwFlowCtl = UART_HWCONTROL_RTS;
+    }
+  sim_uart_loopback (USART6, false);
+
+  os::posix::tty* tty =
+      static_cast<os::posix::tty*> (os::posix::open ("/dev/uart6", 0));
+  if (tty == nullptr)
+    {
+      printf ("%s: error at open\n", title);
+      return false;
+    }
+
+  if (policy == UART_RX_DROP_NEWEST)
+    {
+      // stopping the sender needs RTS
+      result &= tty->ioctl (UART_IOCTL_SET_RX_OVERFLOW, UART_RX_STOP) < 0
+          && errno == EINVAL;
+      result &= tty->ioctl (UART_IOCTL_SET_RX_OVERFLOW, 3) < 0
+          && errno == EINVAL;
+    }
+  result &= tty->ioctl (UART_IOCTL_SET_RX_OVERFLOW, policy) == 0;
+
+  // return what is there, or 0 after 200 ms without data
+  struct termios tios;
+  tty->tcgetattr (&tios);
+  tios.c_cc[VMIN] = 0;
+  tios.c_cc[VTIME] = 2;
+  tty->tcsetattr (TCSANOW, &tios);
+  tty->ioctl (UART_IOCTL_RESET_STATS);
+  sim_uart_get_stats (USART6, &before);
+
+  for (size_t i = 0; i < total; i++)
+    {
+      data[i] = stress_byte (i);
+    }
+  sim_uart_inject (USART6, data, total, 0);
+
+  // the characters take 48 ms, leave the reader out twice as long
+  sysclock.sleep_for (100);
+  if (policy == UART_RX_STOP)
+    {
+      result &= sim_uart_pending (USART6) > 0;  // the sender waits
+    }
+
+  ssize_t count;
+  while (received < total
+      && (count = tty->read (buf + received, total - received)) > 0)
+    {
+      received += count;
+    }
+
+  result &= tty->ioctl (UART_IOCTL_GET_RX_OVERFLOW, &overflows) == 0;
+  tty->ioctl (UART_IOCTL_GET_STATS, &stats);
+  sim_uart_get_stats (USART6, &after);
+  uint64_t overruns = after.rx_overruns - before.rx_overruns;
+
+  switch (policy)
+    {
+    case UART_RX_DROP_OLDEST:
+      result &= received > 0 && received < total
+          && memcmp (buf, data + total - received, received) == 0;
+      result &= overflows > 0 && stats.rx_overflows == overflows
+          && stats.rx_dropped > 0 && overruns == 0;
+      break;
+
+    case UART_RX_DROP_NEWEST:
+      result &= received == RX_BUFFER_SIZE
+          && memcmp (buf, data, received) == 0;
+      result &= overflows == 1 && stats.rx_overflows == 1
+          && stats.rx_stalls > 0 && overruns > 0;
+      break;
+
+    default:
+      result &= received == total && memcmp (buf, data, total) == 0;
+      result &= overflows == 0 && stats.rx_stalls > 0 && overruns == 0;
+      break;
+    }
+  result &= tty->ioctl (UART_IOCTL_GET_RX_OVERFLOW, &overflows) == 0
+      && overflows == 0;
+
+  printf ("%s: %zu of %zu bytes, %u overflows, %u stalls, %u dropped, "
+          "%llu overruns, %s\n",
+          title, received, total, (unsigned) stats.rx_overflows,
+          (unsigned) stats.rx_stalls, (unsigned) stats.rx_dropped,
+          (unsigned long long) overruns, result ? "ok" : "failed");
+
+  tty->ioctl (UART_IOCTL_SET_RX_OVERFLOW, UART_RX_DROP_OLDEST);
+  tios.c_cc[VMIN] = 1;
+  tios.c_cc[VTIME] = 0;
+  tty->tcsetattr (TCSANOW, &tios);
+  tty->close ();
+  return result;
+}
+
+/**
+ * @brief Run the loop-back through the drivers specialized at compile time,
+ *      check that they refuse a handle of the wrong kind and that the hooks
+ *      were called.
+ */
+static bool
+static_round (void)
+{
+  uart6s_impl& drv = uart6s.impl ();
+  bool result = true;
+
+  init_handle (true, 921600);
+  result &= os::posix::open ("/dev/uart6s", 0) == nullptr && errno == EINVAL;
+  init_handle (false, 115200);
+  result &= os::posix::open ("/dev/uart6d", 0) == nullptr && errno == EINVAL;
+  if (!result)
+    {
+      printf ("static port: handle of the wrong kind accepted\n");
+    }
+  if (uart_impl::find (&huart6) == &uart6s.impl ()
+      || uart_impl::find (&huart6) == &uart6d.impl ())
+    {
+      printf ("static port: call-backs routed to a port not opened\n");
+      result = false;
+    }
+
+  sim_uart_set_irq_handler (USART6, USART6_static_IRQHandler);
+  result &= loopback_round ("interrupt, static port", false, 115200,
+                            TEST_BYTES, "/dev/uart6s");
+  if (drv.opens != 1 || drv.closes != 1 || drv.de_toggles == 0
+      || drv.de_state)
+    {
+      printf ("interrupt, static port: hooks not called as expected\n");
+      result = false;
+    }
+
+  sim_uart_set_irq_handler (USART6, USART6_static_dma_IRQHandler);
+  result &= loopback_round ("dma, static port", true, 921600, TEST_BYTES,
+                            "/dev/uart6d");
+
+  sim_uart_set_irq_handler (USART6, USART6_IRQHandler);
+  return result;
+}
+
+/**
+ * @brief Open and close the port with its buffers in a non-cacheable DMA
+ *      pool: the buffers must be aligned, come back to the same blocks at
+ *      each open and need no cache maintenance; a pool too small must make
+ *      the open fail with ENOMEM and leave no block allocated.
+ */
+static bool
+pool_round (const char* title)
+{
+  alignas(32) static uint8_t region[2048 + 16];
+  alignas(32) static uint8_t small_region[256];
+  dma_pool pool
+    { region + 16, sizeof(region) - 16, true };
+  dma_pool small
+    { small_region, sizeof(small_region) };
+  sim_cache_stats cache;
+  bool result = true;
+  uint8_t* first = nullptr;
+
+  dma_pool::set_default (&pool);
+  for (int i = 0; i < 100 && result; i++)
+    {
+      os::posix::tty* tty =
+          static_cast<os::posix::tty*> (os::posix::open ("/dev/uart6",
+                                                         O_NONBLOCK));
+      rx_span dummy, span;
+
+      // the second span always starts at the beginning of the receive buffer
+      if (tty == nullptr || uart6.impl ().peek (dummy, span) < 0)
+        {
+          result = false;
+        }
+      if (i == 0)
+        {
+          first = (uint8_t*) span.data;
+        }
+      if (!pool.owns (span.data) || span.data != first
+          || ((uintptr_t) span.data % dma_pool::cache_line) != 0)
+        {
+          result = false;
+        }
+      if (tty != nullptr)
+        {
+          tty->close ();
+        }
+    }
+  result &= pool.free_blocks () == pool.blocks ();
+
+  sim_cache_reset_stats ();
+  result &= loopback_round (title, true, 921600, TEST_BYTES);
+  sim_cache_get_stats (&cache);
+  result &= cache.clean_calls == 0 && cache.invalidate_calls == 0;
+  result &= pool.free_blocks () == pool.blocks ();
+
+  dma_pool::set_default (&small);
+  errno = 0;
+  result &= os::posix::open ("/dev/uart6", 0) == nullptr && errno == ENOMEM;
+  result &= small.free_blocks () == small.blocks ();
+
+  // the buffers go back to the pool they came from, whatever the default
+  // pool is at close
+  dma_pool::set_default (&pool);
+  os::posix::tty* tty =
+      static_cast<os::posix::tty*> (os::posix::open ("/dev/uart6", 0));
+  result &= tty != nullptr && pool.free_blocks () < pool.blocks ();
+  dma_pool::set_default (nullptr);
+  if (tty != nullptr)
+    {
+      tty->close ();
+    }
+  result &= pool.free_blocks () == pool.blocks ();
+
+  tty = static_cast<os::posix::tty*> (os::posix::open ("/dev/uart6", 0));
+  dma_pool::set_default (&small);
+  if (tty != nullptr)
+    {
+      tty->close ();
+    }
+  result &= tty != nullptr && small.free_blocks () == small.blocks ();
+
+  dma_pool::set_default (nullptr);
+  printf ("%s: %zu blocks of %zu bytes, %s\n", title, pool.blocks (),
+          dma_pool::block_size, result ? "ok" : "failed");
+  return result;
+}
+
+int
+main (void)
+{
+  bool result = true;
+
+  sim_uart_set_irq_handler (USART6, USART6_IRQHandler);
+
+  result &= loopback_round ("interrupt", false, 115200, TEST_BYTES);
+  result &= loopback_round ("dma", true, 921600, TEST_BYTES);
+  result &= loopback_round ("interrupt, small writes", false, 115200, 10);
+  result &= loopback_round ("dma, small writes", true, 921600, 10);
+  result &= loopback_round ("interrupt, zero-copy", false, 115200, 0);
+  result &= loopback_round ("dma, zero-copy", true, 921600, 0);
+  result &= tx_stream_round ("dma, tx chained at TC", false, 64);
+  result &= tx_stream_round ("dma, tx streaming", true, 64);
+  result &= drain_round ("interrupt, tcdrain", false, false);
+  result &= drain_round ("dma, tcdrain", true, false);
+  result &= drain_round ("dma, tx streaming, tcdrain", true, true);
+  result &= flush_round ("interrupt, tcflush", false);
+  result &= flush_round ("dma, tcflush", true);
+  result &= width_round ("interrupt, 9 to 8 data bits", false);
+  result &= width_round ("dma, 9 to 8 data bits", true);
+  result &= break_round ("interrupt, break", false);
+  result &= break_round ("dma, break", true);
+  result &= switch_round ("interrupt, hot switch", false, false);
+  result &= switch_round ("dma, hot switch", true, false);
+  result &= switch_round ("dma, circular, hot switch", true, true);
+  result &= profile_round ("interrupt, profiles", false);
+  result &= profile_round ("dma, profiles", true);
+  result &= baud_table_round ("baud rate table");
+  result &= frame_gap_round ("interrupt, frame gap (3 chars)", false, 3);
+  result &= frame_gap_round ("dma, frame gap (3 chars)", true, 3);
+  result &= frame_gap_round ("dma, frame gap (VTIME_MS)", true, 0);
+  rto_in_handler = false;
+  result &= frame_gap_round ("interrupt, frame gap, rto by the HAL", false, 3);
+  result &= frame_gap_round ("dma, frame gap, rto by the HAL", true, 3);
+  rto_in_handler = true;
+  result &= nonblock_gap_round ("interrupt, non-blocking gap", false);
+  result &= nonblock_gap_round ("dma, non-blocking gap", true);
+  result &= line_round ("interrupt, lines, VMIN 1", false, false, 2);
+  result &= line_round ("interrupt, lines, ICANON", false, true, 2);
+  result &= line_round ("dma, lines, VMIN 1", true, false, 2);
+  result &= line_round ("dma, lines, ICANON", true, true, 2);
+  result &= line_round ("dma, back-to-back lines, VMIN 1", true, false, 0);
+  result &= line_round ("dma, back-to-back lines, ICANON", true, true, 0);
+  result &= packet_round ("interrupt, packet mode", false, 0);
+  result &= packet_round ("dma, packet mode", true, 0);
+  result &= packet_round ("interrupt, packet mode, frame gap", false, 4);
+  result &= packet_round ("dma, packet mode, frame gap", true, 4);
+  result &= error_stats_round ("line error statistics");
+  result &= line_error_round ("interrupt, line error, EIO", false, false,
+                              INPCK);
+  result &= line_error_round ("interrupt, line error, IGNPAR", false, false,
+                              IGNPAR);
+  result &= line_error_round ("interrupt, line error, PARMRK", false, false,
+                              PARMRK);
+  result &= line_error_round ("dma, line error, EIO", true, false, INPCK);
+  result &= line_error_round ("dma, line error, IGNPAR", true, false, IGNPAR);
+  result &= line_error_round ("dma, line error, PARMRK", true, false, PARMRK);
+  result &= overflow_round ("interrupt, rx overflow, drop oldest", false,
+                            UART_RX_DROP_OLDEST);
+  result &= overflow_round ("interrupt, rx overflow, drop newest", false,
+                            UART_RX_DROP_NEWEST);
+  result &= overflow_round ("interrupt, rx overflow, rts", false,
+                            UART_RX_STOP);
+  result &= overflow_round ("dma, rx overflow, drop oldest", true,
+                            UART_RX_DROP_OLDEST);
+  result &= overflow_round ("dma, rx overflow, drop newest", true,
+                            UART_RX_DROP_NEWEST);
+  result &= overflow_round ("dma, rx overflow, rts", true, UART_RX_STOP);
+
+  // the same, through the driver's interrupt handler
+  sim_uart_set_irq_handler (USART6, USART6_driver_IRQHandler);
+  result &= loopback_round ("interrupt, driver irq", false, 115200,
+                            TEST_BYTES);
+  result &= loopback_round ("dma, driver irq", true, 921600, TEST_BYTES);
+  result &= frame_gap_round ("interrupt, driver irq, frame gap", false, 3);
+  result &= line_round ("interrupt, driver irq, lines, ICANON", false, true,
+                        2);
+  result &= packet_round ("interrupt, driver irq, packet mode", false, 0);
+  result &= packet_round ("interrupt, driver irq, packet mode, frame gap",
+                          false, 4);
+  result &= drain_round ("interrupt, driver irq, tcdrain", false, false);
+  result &= break_round ("interrupt, driver irq, break", false);
+  result &= width_round ("interrupt, driver irq, 9 to 8 data bits", false);
+  result &= width_round ("dma, driver irq, 9 to 8 data bits", true);
+  result &= error_stats_round ("driver irq, line error statistics");
+  result &= line_error_round ("interrupt, driver irq, line error, PARMRK",
+                              false, false, PARMRK);
+  result &= line_error_round ("dma, driver irq, line error, EIO", true, false,
+                              INPCK);
+  result &= line_error_round ("dma, circular, driver irq, line error, EIO",
+                              true, true, INPCK);
+  result &= line_error_round ("dma, circular, driver irq, line error, PARMRK",
+                              true, true, PARMRK);
+  result &= error_split_round ("interrupt, driver irq, line error, split",
+                               false);
+  result &= error_split_round ("dma, driver irq, line error, split", true);
+  result &= overflow_round ("interrupt, driver irq, rx overflow, drop newest",
+                            false, UART_RX_DROP_NEWEST);
+  result &= overflow_round ("interrupt, driver irq, rx overflow, rts", false,
+                            UART_RX_STOP);
+  sim_uart_set_irq_handler (USART6, USART6_IRQHandler);
+
+  result &= rx_irq_bench ("rx irq, HAL handler", USART6_IRQHandler);
+  result &= rx_irq_bench ("rx irq, driver handler", USART6_driver_IRQHandler);
+  result &= static_round ();
+  result &= rx_irq_bench ("rx irq, static port", USART6_static_IRQHandler,
+                          "/dev/uart6s");
+  result &= pool_round ("dma, buffers in pool");
+  result &= rx_isr_bench ("rx isr, 200 bytes buffer", "/dev/uart6");
+  result &= rx_isr_bench ("rx isr, 4096 bytes buffer", "/dev/uart6b");
+  result &= stress_round ("dma, 12 Mbaud, normal", false, 512 * 1024);
+  result &= stress_round ("dma, 12 Mbaud, circular", true, 8 * 1024 * 1024);
+
+  printf ("%s\n", result ? "PASSED" : "FAILED");
+  return result ? 0 : 1;
+}
@@ -68,6 +68,8 @@ my_char cdc0
 my_char cdc1
   { "cdc1", (uint8_t) DEVICE_HS, nullptr, nullptr, (size_t) TX_BUFFER_SIZE, (size_t) RX_BUFFER_SIZE };
 
+// with UART_USE_DISPATCH, the driver defines the call-backs itself
+#if UART_USE_DISPATCH != true
 
 int8_t
 cdc_init (USBD_HandleTypeDef* husbd)
@@ -126,6 +128,8 @@ cdc_receive (USBD_HandleTypeDef* husbd, uint8_t* buf, uint32_t *len)
   return USBD_OK;
 }
 
+#endif
+
 /**
  * @brief  This is a test function that exercises the UART driver.
  */
@@ -69,6 +69,9 @@ targeted_read (os::posix::tty* filedes, char *buffer, size_t expected_size);
 uart uart6
   { "uart6", &huart6, nullptr, nullptr, (size_t) TX_BUFFER_SIZE, (size_t) RX_BUFFER_SIZE };
 
+// with UART_USE_DISPATCH, the driver defines the call-backs itself
+#if UART_USE_DISPATCH != true
+
 void
 HAL_UART_TxCpltCallback (UART_HandleTypeDef *huart)
 {
@@ -105,6 +108,8 @@ HAL_UART_ErrorCallback (UART_HandleTypeDef *huart)
     }
 }
 
+#endif
+
 /**
  * @brief  This is a test function that exercises the UART driver.
  */